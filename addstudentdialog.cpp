@@ -1,23 +1,32 @@
 #include "addstudentdialog.h"
 #include "ui_addstudentdialog.h"
 #include <QMessageBox>
+#include <QLabel>
 #include <QDebug>
 
-AddStudentDialog::AddStudentDialog(QWidget *parent, Database *db)
+AddStudentDialog::AddStudentDialog(QWidget *parent, AsyncDatabase *asyncDb)
     : QDialog(parent)
     , ui(new Ui::AddStudentDialog)
-    , database(db)
+    , asyncDatabase(asyncDb)
 {
     ui->setupUi(this);
     setWindowTitle("添加学生");
 
-    // 设置默认值
-    ui->chineseEdit->setText("0");
-    ui->mathEdit->setText("0");
-    ui->englishEdit->setText("0");
+    // 每个科目一行成绩输入框，默认值为 0
+    ui->scoreGroup->setTitle(QString("成绩信息 (0-%1分)").arg(FullScore));
+    for (int s = 0; s < SubjectCount; s++) {
+        QLineEdit *edit = new QLineEdit("0", ui->scoreGroup);
+        ui->gridLayout_2->addWidget(new QLabel(subjectName(Subject(s)) + ":", ui->scoreGroup), s, 0);
+        ui->gridLayout_2->addWidget(edit, s, 1);
+        scoreEdits.append(edit);
+    }
 
     // 注意：由于使用了 buttonBox 的 accepted()/rejected() 信号
     // 不需要手动连接，Qt会自动连接标准按钮的信号
+    // “确定”不直接关闭对话框，写入成功后由 submitStudent 调用 accept()
+
+    // 学号输入完成后在后台查重，不阻塞输入
+    connect(ui->stuIdEdit, &QLineEdit::editingFinished, this, &AddStudentDialog::checkStudentIdAsync);
 }
 
 AddStudentDialog::~AddStudentDialog()
@@ -34,7 +43,8 @@ bool AddStudentDialog::validateInput()
         return false;
     }
 
-    if (database->isStudentExist(stuId)) {
+    // 后台查重已经确认存在时直接提示；没有查过的在提交时查
+    if (stuId == checkedStuId && checkedStuIdExists) {
         QMessageBox::warning(this, "警告", "学号已存在！");
         return false;
     }
@@ -54,50 +64,98 @@ bool AddStudentDialog::validateInput()
     }
 
     // 检查成绩
-    bool ok;
-    double chinese = ui->chineseEdit->text().toDouble(&ok);
-    if (!ok || chinese < 0 || chinese > 100) {
-        QMessageBox::warning(this, "警告", "语文成绩必须是0-100的数字！");
-        return false;
+    for (int s = 0; s < SubjectCount; s++) {
+        bool ok;
+        double score = scoreEdits.at(s)->text().toDouble(&ok);
+        if (!ok || score < 0 || score > FullScore) {
+            QMessageBox::warning(this, "警告", QString("%1成绩必须是0-%2的数字！").arg(subjectName(Subject(s))).arg(FullScore));
+            return false;
+        }
     }
 
-    double math = ui->mathEdit->text().toDouble(&ok);
-    if (!ok || math < 0 || math > 100) {
-        QMessageBox::warning(this, "警告", "数学成绩必须是0-100的数字！");
-        return false;
-    }
+    return true;
+}
 
-    double english = ui->englishEdit->text().toDouble(&ok);
-    if (!ok || english < 0 || english > 100) {
-        QMessageBox::warning(this, "警告", "英语成绩必须是0-100的数字！");
-        return false;
-    }
+void AddStudentDialog::checkStudentIdAsync()
+{
+    if (!asyncDatabase) return;
 
-    return true;
+    QString stuId = ui->stuIdEdit->text().trimmed();
+    if (stuId.isEmpty() || stuId == checkedStuId) return;
+
+    asyncDatabase->isStudentExist(stuId).then(this, [this, stuId](bool exists) {
+        checkedStuId = stuId;
+        checkedStuIdExists = exists;
+
+        // 只有结果仍对应当前输入时才提示
+        if (ui->stuIdEdit->text().trimmed() == stuId) {
+            ui->stuIdEdit->setStyleSheet(exists ? "border: 1px solid red;" : QString());
+            ui->stuIdEdit->setToolTip(exists ? "学号已存在" : QString());
+        }
+    });
 }
 
 void AddStudentDialog::on_buttonBox_accepted()  // 修改：从 on_addButton_clicked 改为 on_buttonBox_accepted
 {
-    if (!validateInput()) {
+    if (busy || !asyncDatabase || !validateInput()) {
         // 阻止对话框关闭
         return;
     }
 
+    // 提交时的输入，查重和写入期间再修改输入框不影响这次提交
     QString stuId = ui->stuIdEdit->text().trimmed();
     QString name = ui->nameEdit->text().trimmed();
     QString className = ui->classEdit->text().trimmed();
-    double chinese = ui->chineseEdit->text().toDouble();
-    double math = ui->mathEdit->text().toDouble();
-    double english = ui->englishEdit->text().toDouble();
+    QVector<double> scores;
+    for (QLineEdit *edit : scoreEdits)
+        scores.append(edit->text().toDouble());
 
-    if (database->addStudent(stuId, name, className, chinese, math, english)) {
-        QMessageBox::information(this, "成功", "学生添加成功！");
-        // accept() 会自动调用，因为这是 buttonBox 的 accepted 信号
-    } else {
-        QMessageBox::critical(this, "错误", "添加失败！");
-        // 阻止对话框关闭
+    if (stuId == checkedStuId) {
+        submitStudent(stuId, name, className, scores);
         return;
     }
+
+    // 学号还没有查过：先在读线程上查重，不存在再写入
+    setBusy(true);
+    asyncDatabase->isStudentExist(stuId).then(this, [=](bool exists) {
+        checkedStuId = stuId;
+        checkedStuIdExists = exists;
+        if (exists) {
+            setBusy(false);
+            QMessageBox::warning(this, "警告", "学号已存在！");
+            return;
+        }
+        submitStudent(stuId, name, className, scores);
+    });
+}
+
+// 写入排在写线程上，与表格修改的写回、删除等按提交顺序执行；成功后才关闭对话框
+void AddStudentDialog::submitStudent(const QString &stuId, const QString &name, const QString &className,
+                                     const QVector<double> &scores)
+{
+    setBusy(true);
+    asyncDatabase->addStudent(stuId, name, className, scores).then(this, [this](const StudentTable &row) {
+        setBusy(false);
+        if (row.isEmpty()) {
+            QMessageBox::critical(this, "错误", "添加失败！");
+            return;
+        }
+        inserted = row;
+        QMessageBox::information(this, "成功", "学生添加成功！");
+        accept();
+    });
+}
+
+void AddStudentDialog::setBusy(bool value)
+{
+    busy = value;
+    ui->buttonBox->setEnabled(!value);
+}
+
+void AddStudentDialog::reject()
+{
+    if (busy) return;
+    QDialog::reject();
 }
 
 void AddStudentDialog::on_buttonBox_rejected()  // 修改：从 on_cancelButton_clicked 改为 on_buttonBox_rejected
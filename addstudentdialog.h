@@ -2,7 +2,8 @@
 #define ADDSTUDENTDIALOG_H
 
 #include <QDialog>
-#include "database.h"
+#include <QLineEdit>
+#include "asyncdatabase.h"
 
 namespace Ui {
 class AddStudentDialog;
@@ -13,18 +14,36 @@ class AddStudentDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit AddStudentDialog(QWidget *parent = nullptr, Database *db = nullptr);
+    explicit AddStudentDialog(QWidget *parent = nullptr, AsyncDatabase *asyncDb = nullptr);
     ~AddStudentDialog();
 
+    // 对话框被接受后为刚写入数据库的那一行
+    const StudentTable &insertedStudent() const { return inserted; }
+
+    // 查重或写入进行中不能关闭，否则写入的结果无人接收
+    void reject() override;
+
 private slots:
     void on_buttonBox_accepted();    // 修改：从 on_addButton_clicked 改为 on_buttonBox_accepted
     void on_buttonBox_rejected();    // 修改：从 on_cancelButton_clicked 改为 on_buttonBox_rejected
 
 private:
     bool validateInput();
+    void checkStudentIdAsync();
+    void submitStudent(const QString &stuId, const QString &name, const QString &className,
+                       const QVector<double> &scores);
+    void setBusy(bool value);
 
     Ui::AddStudentDialog *ui;
-    Database *database;
+    AsyncDatabase *asyncDatabase;
+    QVector<QLineEdit *> scoreEdits;   // 按科目目录生成，下标即科目
+
+    // 后台查重的结果，学号未变时提交前不必再查一次
+    QString checkedStuId;
+    bool checkedStuIdExists = false;
+    bool busy = false;
+
+    StudentTable inserted;
 };
 
 #endif // ADDSTUDENTDIALOG_H
@@ -0,0 +1,380 @@
+#include "asyncdatabase.h"
+#include "database.h"
+#include <QtConcurrent>
+#include <QPromise>
+#include <QDebug>
+
+AsyncDatabase::AsyncDatabase(const ConnectionProfile &profile, QObject *parent)
+    : QObject(parent)
+    , connections(profile)
+{
+}
+
+AsyncDatabase::~AsyncDatabase()
+{
+    // 正在执行的装载/搜索尽快停下，连接池析构时等待它们结束
+    tableGeneration++;
+}
+
+Database *AsyncDatabase::writer()
+{
+    Database *db = connections.writer();
+    if (db && !ownChangesHooked) {
+        db->setOwnChangeListener([this](const ChangeRange &range, bool registered) {
+            recordOwnChange(range, registered);
+        });
+        ownChangesHooked = true;
+    }
+    return db;
+}
+
+// 连续的几次写入之间没有其他程序的修改时合并为一段；撤销时从合并的段中去掉这一次
+void AsyncDatabase::recordOwnChange(const ChangeRange &range, bool registered)
+{
+    QMutexLocker locker(&ownChangesLock);
+    if (registered) {
+        if (!ownChanges.isEmpty() && ownChanges.last().to == range.from)
+            ownChanges.last().to = range.to;
+        else
+            ownChanges.append(range);
+        // 长时间没有读取变更时只保留最近的，多出的当作外部修改处理，结果相同，只是多读几行
+        if (ownChanges.size() > MaxOwnChanges)
+            ownChanges.removeFirst();
+        return;
+    }
+
+    for (int i = ownChanges.size() - 1; i >= 0; i--) {
+        ChangeRange &own = ownChanges[i];
+        if (own.to == range.to && own.from <= range.from) {
+            if (own.from == range.from)
+                ownChanges.remove(i);
+            else
+                own.to = range.from;
+            return;
+        }
+    }
+}
+
+QFuture<ExternalChanges> AsyncDatabase::getExternalChanges(qint64 afterSeq, int limit)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, afterSeq, limit]() {
+        ExternalChanges changes;
+        Database *db = connections.reader();
+        if (!db)
+            return changes;
+
+        QVector<ChangeRange> skip;
+        {
+            QMutexLocker locker(&ownChangesLock);
+            skip = ownChanges;
+        }
+        changes.ok = db->getChangedStudentIds(afterSeq, limit, &changes.ids, &changes.lastSeq, skip);
+        if (!changes.ok)
+            return changes;
+        if (!changes.ids.isEmpty())
+            changes.rows = db->getStudentsByIds(changes.ids);
+
+        // 已经读过的部分不会再用到
+        QMutexLocker locker(&ownChangesLock);
+        while (!ownChanges.isEmpty() && ownChanges.first().to <= changes.lastSeq)
+            ownChanges.removeFirst();
+        return changes;
+    });
+}
+
+QFuture<StudentTable> AsyncDatabase::startTableQuery(const QString &keyword, bool search)
+{
+    // 新的装载/搜索到来后，旧请求的结果已无意义
+    const quint64 generation = ++tableGeneration;
+
+    return QtConcurrent::run(connections.writerPool(), [this, keyword, search, generation](QPromise<StudentTable> &promise) {
+        auto superseded = [this, &promise, generation]() {
+            return promise.isCanceled() || generation != tableGeneration.load();
+        };
+        if (superseded())
+            return;
+
+        Database *db = writer();
+        if (!db)
+            return;
+
+        auto consumer = [&promise, &superseded](StudentTable &&chunk) {
+            if (superseded())
+                return false;
+            promise.addResult(std::move(chunk));
+            return true;
+        };
+
+        if (search) {
+            db->searchStudents(keyword, ChunkSize, consumer);
+        } else {
+            db->getAllStudents(ChunkSize, consumer);
+        }
+    });
+}
+
+QFuture<StudentTable> AsyncDatabase::getAllStudents()
+{
+    return startTableQuery(QString(), false);
+}
+
+QFuture<StudentTable> AsyncDatabase::searchStudents(const QString &keyword)
+{
+    return startTableQuery(keyword, true);
+}
+
+QFuture<StudentTable> AsyncDatabase::getStudentPage(const QString &afterClass, const QString &afterStuId,
+                                                    int skip, int limit)
+{
+    return QtConcurrent::run(connections.readerPool(), [=]() {
+        Database *db = connections.reader();
+        return db ? db->getStudentPage(afterClass, afterStuId, skip, limit) : StudentTable();
+    });
+}
+
+QFuture<StudentTable> AsyncDatabase::getSortedStudentPage(int column, bool descending, int afterId, int skip, int limit)
+{
+    return QtConcurrent::run(connections.readerPool(), [=]() {
+        Database *db = connections.reader();
+        return db ? db->getSortedStudentPage(column, descending, afterId, skip, limit) : StudentTable();
+    });
+}
+
+QFuture<bool> AsyncDatabase::ensureSortIndex(int column)
+{
+    return QtConcurrent::run(connections.writerPool(), [this, column]() {
+        Database *db = writer();
+        return db && db->ensureSortIndex(column);
+    });
+}
+
+QFuture<int> AsyncDatabase::countStudents()
+{
+    return QtConcurrent::run(connections.readerPool(), [this]() {
+        Database *db = connections.reader();
+        return db ? db->countStudents() : 0;
+    });
+}
+
+QFuture<int> AsyncDatabase::countStudentsBefore(const QString &className, const QString &stuId)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, className, stuId]() {
+        Database *db = connections.reader();
+        return db ? db->countStudentsBefore(className, stuId) : 0;
+    });
+}
+
+QFuture<int> AsyncDatabase::countSortedBefore(int column, bool descending, int id)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, column, descending, id]() {
+        Database *db = connections.reader();
+        return db ? db->countSortedBefore(column, descending, id) : 0;
+    });
+}
+
+QFuture<StatisticsSnapshot> AsyncDatabase::getStatisticsSnapshot(const QVector<double> &bucketEdges)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, bucketEdges]() {
+        Database *db = connections.reader();
+        if (!db)
+            return StatisticsSnapshot();
+        if (db->readsClassStats(bucketEdges))
+            return db->getStatisticsSnapshot(bucketEdges);
+        return scanInParallel(db, bucketEdges);
+    });
+}
+
+StatisticsSnapshot AsyncDatabase::scanInParallel(Database *db, const QVector<double> &bucketEdges)
+{
+    const QStringList classes = db->getAllClasses();
+    const int parts = qMin(connections.readerCount(), int(classes.size()));
+    if (parts <= 1)
+        return db->getStatisticsSnapshot(bucketEdges);
+
+    // 按班级名称切成连续的几段，每段的首尾班级作为范围条件
+    // 各段在不同连接上各自读取，扫描期间若有写入，各段看到的可能不是同一时刻的数据
+    QVector<QPair<QString, QString>> ranges;
+    for (int i = 0; i < parts; i++) {
+        const int first = int(qint64(classes.size()) * i / parts);
+        const int last = int(qint64(classes.size()) * (i + 1) / parts) - 1;
+        ranges.append({classes.at(first), classes.at(last)});
+    }
+
+    // 当前线程也参与执行，因此在读线程中阻塞等待不会占满线程池
+    const QVector<StatisticsSnapshot> partials = QtConcurrent::blockingMapped<QVector<StatisticsSnapshot>>(
+        connections.readerPool(), ranges, [this, bucketEdges](const QPair<QString, QString> &range) {
+            Database *reader = connections.reader();
+            return reader ? reader->scanClassRange(bucketEdges, range.first, range.second) : StatisticsSnapshot();
+        });
+
+    StatisticsSnapshot snapshot;
+    snapshot.bucketEdges = bucketEdges;
+    for (const StatisticsSnapshot &partial : partials)
+        snapshot.classes += partial.classes;
+    snapshot.computeSchoolTotals();
+    return snapshot;
+}
+
+QFuture<QVector<QMap<QString, QVariant>>> AsyncDatabase::getSubjectStats(Subject subject)
+{
+    return getStatisticsSnapshot().then([subject](const StatisticsSnapshot &snapshot) {
+        return snapshot.subjectStats(subject);
+    });
+}
+
+QFuture<QVector<QMap<QString, QVariant>>> AsyncDatabase::getClassStats()
+{
+    return getStatisticsSnapshot().then([](const StatisticsSnapshot &snapshot) {
+        return snapshot.classStats();
+    });
+}
+
+QFuture<QVector<QMap<QString, QVariant>>> AsyncDatabase::getTrendData()
+{
+    return getStatisticsSnapshot().then([](const StatisticsSnapshot &snapshot) {
+        return snapshot.trendData();
+    });
+}
+
+QFuture<ExamTrend> AsyncDatabase::getExamTrend(int improvedLimit)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, improvedLimit]() {
+        Database *db = connections.reader();
+        return db ? db->getExamTrend(improvedLimit) : ExamTrend();
+    });
+}
+
+QFuture<int> AsyncDatabase::recordExam(const QString &name, const QDate &date)
+{
+    return QtConcurrent::run(connections.writerPool(), [this, name, date]() {
+        Database *db = writer();
+        return db ? db->recordExam(name, date) : -1;
+    });
+}
+
+QFuture<RankIndex> AsyncDatabase::getRankIndex()
+{
+    return QtConcurrent::run(connections.writerPool(), [this]() {
+        Database *db = writer();
+        return db ? db->getRankIndex() : RankIndex();
+    });
+}
+
+QFuture<StudentTable> AsyncDatabase::addStudent(const QString &stuId, const QString &name, const QString &className,
+                                                const QVector<double> &scores)
+{
+    return QtConcurrent::run(connections.writerPool(), [=]() {
+        StudentTable inserted;
+        Database *db = writer();
+        if (!db || !db->addStudent(stuId, name, className, scores, &inserted))
+            inserted.clear();
+        return inserted;
+    });
+}
+
+QFuture<bool> AsyncDatabase::updateStudent(const QString &stuId, const QString &name, const QString &className,
+                                           const QVector<double> &scores)
+{
+    return QtConcurrent::run(connections.writerPool(), [=]() {
+        Database *db = writer();
+        return db && db->updateStudent(stuId, name, className, scores);
+    });
+}
+
+QFuture<bool> AsyncDatabase::deleteStudent(const QString &stuId)
+{
+    return QtConcurrent::run(connections.writerPool(), [this, stuId]() {
+        Database *db = writer();
+        return db && db->deleteStudent(stuId);
+    });
+}
+
+QFuture<StudentEditResult> AsyncDatabase::applyStudentEdits(const QVector<StudentEdit> &edits)
+{
+    return QtConcurrent::run(connections.writerPool(), [this, edits]() {
+        StudentEditResult result;
+        Database *db = writer();
+        result.ok = db && db->applyStudentEdits(edits, &result.rows, &result.errors);
+        return result;
+    });
+}
+
+QFuture<bool> AsyncDatabase::isStudentExist(const QString &stuId)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, stuId]() {
+        Database *db = connections.reader();
+        return db && db->isStudentExist(stuId);
+    });
+}
+
+QFuture<CsvImporter::Result> AsyncDatabase::importCsv(const QString &filePath)
+{
+    return QtConcurrent::run(connections.writerPool(), [this, filePath](QPromise<CsvImporter::Result> &promise) {
+        promise.setProgressRange(0, 1000);
+
+        Database *db = writer();
+        if (!db) {
+            CsvImporter::Result result;
+            result.fatalError = "无法打开数据库";
+            promise.addResult(result);
+            return;
+        }
+
+        // 只读配置下导入会被 query_only 拒绝，不切换
+        const bool bulk = !connections.profile().readOnly
+                          && db->applyPragmas(ConnectionProfile::preset(ConnectionProfile::Preset::BulkImport,
+                                                                        connections.profile().databasePath));
+
+        CsvImporter importer(db);
+        CsvImporter::Result result = importer.importFile(filePath, [&promise](const CsvImporter::Progress &progress) {
+            if (progress.totalBytes > 0) {
+                promise.setProgressValueAndText(int(progress.bytesRead * 1000 / progress.totalBytes),
+                                                QString("已导入 %1 行").arg(progress.rowsImported));
+            }
+            return !promise.isCanceled();
+        });
+
+        if (bulk)
+            db->applyPragmas(connections.profile());
+        promise.addResult(result);
+    });
+}
+
+QFuture<DataExporter::Result> AsyncDatabase::exportStudents(const QString &filePath, DataExporter::Format format,
+                                                            const QString &keyword)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, filePath, format, keyword](QPromise<DataExporter::Result> &promise) {
+        Database *db = connections.reader();
+        if (!db) {
+            DataExporter::Result result;
+            result.error = "无法打开数据库";
+            promise.addResult(result);
+            return;
+        }
+
+        DataExporter exporter(db);
+        DataExporter::Result result = exporter.exportStudents(filePath, format, keyword,
+                                                              [&promise](const DataExporter::Progress &progress) {
+            if (progress.totalRows > 0) {
+                promise.setProgressRange(0, int(progress.totalRows));
+            }
+            promise.setProgressValueAndText(int(progress.rowsWritten),
+                                            QString("已导出 %1 行").arg(progress.rowsWritten));
+            return !promise.isCanceled();
+        });
+        promise.addResult(result);
+    });
+}
+
+QFuture<DataExporter::Result> AsyncDatabase::exportStatistics(const QString &dirPath, DataExporter::Format format)
+{
+    return QtConcurrent::run(connections.readerPool(), [this, dirPath, format]() {
+        Database *db = connections.reader();
+        if (!db) {
+            DataExporter::Result result;
+            result.error = "无法打开数据库";
+            return result;
+        }
+        return DataExporter(db).exportStatistics(dirPath, format);
+    });
+}
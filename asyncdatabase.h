@@ -0,0 +1,118 @@
+#ifndef ASYNCDATABASE_H
+#define ASYNCDATABASE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QVector>
+#include <QMap>
+#include <QVariant>
+#include <QDate>
+#include <QMutex>
+#include <atomic>
+#include "studenttable.h"
+#include "statisticssnapshot.h"
+#include "rankindex.h"
+#include "csvimporter.h"
+#include "dataexporter.h"
+#include "connectionpool.h"
+#include "database.h"
+
+// 其他程序对学生表的修改，见 AsyncDatabase::getExternalChanges
+struct ExternalChanges
+{
+    bool ok = false;        // 变更记录不可用、已被清理或涉及的学生太多时为 false，调用方应重新装载
+    qint64 lastSeq = -1;    // 读到的最大变更序号，下次从这里继续
+    QVector<int> ids;       // 变更过的学生 id
+    StudentTable rows;      // 其中仍然存在的学生的当前值
+};
+
+// 在工作线程上执行数据库查询，避免大查询卡住界面
+// 写操作和学生列表装载排在连接池唯一的写线程上；统计和导出使用读线程，
+// 不必等待导入等长时间的写操作。学生列表按块逐步返回，
+// 可通过 QFutureWatcher::resultsReadyAt 边读边显示
+class AsyncDatabase : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AsyncDatabase(const ConnectionProfile &profile, QObject *parent = nullptr);
+    ~AsyncDatabase();
+
+    // 装载与搜索共用同一个通道，新请求会取消尚未完成的旧请求
+    QFuture<StudentTable> getAllStudents();
+    QFuture<StudentTable> searchStudents(const QString &keyword);
+    // 分页模式的一页，在读线程上执行，不占用装载与搜索的通道；参数见 Database 中的同名函数
+    QFuture<StudentTable> getStudentPage(const QString &afterClass, const QString &afterStuId, int skip, int limit);
+    QFuture<StudentTable> getSortedStudentPage(int column, bool descending, int afterId, int skip, int limit);
+    // 读连接是只读的，排序索引在写线程上建立；分页模式按列排序时先建好索引再读取各页
+    QFuture<bool> ensureSortIndex(int column);
+    // 学生总数和分页模式下新行的位置，在读线程上计数
+    QFuture<int> countStudents();
+    QFuture<int> countStudentsBefore(const QString &className, const QString &stuId);
+    QFuture<int> countSortedBefore(int column, bool descending, int id);
+
+    // 统计；需要扫描学生表时按班级分段，在多个读连接上并行汇总
+    QFuture<StatisticsSnapshot> getStatisticsSnapshot(
+        const QVector<double> &bucketEdges = StatisticsSnapshot::defaultBucketEdges());
+    QFuture<QVector<QMap<QString, QVariant>>> getSubjectStats(Subject subject);
+    QFuture<QVector<QMap<QString, QVariant>>> getClassStats();
+    QFuture<QVector<QMap<QString, QVariant>>> getTrendData();
+
+    // 考试趋势在读线程上查询；记录考试是写操作
+    QFuture<ExamTrend> getExamTrend(int improvedLimit = 10);
+    QFuture<int> recordExam(const QString &name, const QDate &date);
+
+    // 排名索引在写线程上建立，与增删改按提交顺序排队，结果不会漏掉或重复计入某次修改
+    QFuture<RankIndex> getRankIndex();
+
+    // 外部修改：在读线程上读取序号 afterSeq 之后的变更记录和对应的学生
+    // 本程序写线程自己的增删改、导入已经显示在界面上，不计入；超过 limit 名学生时 ok 为 false
+    QFuture<ExternalChanges> getExternalChanges(qint64 afterSeq, int limit);
+
+    // 写操作在同一个线程上排队执行
+    // 添加成功时结果为写入后的一行（含 id 和总分），失败时为空表
+    QFuture<StudentTable> addStudent(const QString &stuId, const QString &name, const QString &className,
+                             const QVector<double> &scores);
+    QFuture<bool> updateStudent(const QString &stuId, const QString &name, const QString &className,
+                                const QVector<double> &scores);
+    QFuture<bool> deleteStudent(const QString &stuId);
+    // 表格中就地修改的一批写回，见 Database::applyStudentEdits
+    QFuture<StudentEditResult> applyStudentEdits(const QVector<StudentEdit> &edits);
+    // 查重只读，在读线程上执行，不必排在写操作之后；最终以写入时的唯一约束为准
+    QFuture<bool> isStudentExist(const QString &stuId);
+
+    // CSV 批量导入，进度为 0-1000 的千分比，可通过 QFuture::cancel() 中止
+    // 导入期间工作线程连接改用批量导入配置，结束后恢复
+    QFuture<CsvImporter::Result> importCsv(const QString &filePath);
+
+    // 流式导出，在读线程上执行，学生导出的进度为已写行数（总数未知时进度范围为 0）
+    QFuture<DataExporter::Result> exportStudents(const QString &filePath, DataExporter::Format format,
+                                                 const QString &keyword = QString());
+    QFuture<DataExporter::Result> exportStatistics(const QString &dirPath, DataExporter::Format format);
+
+    // 每块返回的行数
+    static constexpr int ChunkSize = 2000;
+
+private:
+    QFuture<StudentTable> startTableQuery(const QString &keyword, bool search);
+    // 在读线程中调用，各段的班级互不重叠，结果按班级顺序拼接
+    StatisticsSnapshot scanInParallel(Database *db, const QVector<double> &bucketEdges);
+    // 只在写线程中调用；第一次取得连接时登记自己的修改
+    Database *writer();
+    void recordOwnChange(const ChangeRange &range, bool registered);
+
+    // 每次装载/搜索递增，工作线程发现自己不是最新请求时立即停止
+    // 只记编号而不保存 QFuture，避免结果在这里多留一份
+    std::atomic<quint64> tableGeneration{0};
+
+    // 写线程提交的修改在变更记录中的各段序号，按序号排列；读取外部修改时跳过，读过之后丢弃
+    QMutex ownChangesLock;
+    QVector<ChangeRange> ownChanges;
+    bool ownChangesHooked = false;   // 只在写线程中访问
+    static constexpr int MaxOwnChanges = 4096;
+
+    // 放在最后，析构时最先等待各线程结束，此时其他成员仍然有效
+    ConnectionPool connections;
+};
+
+#endif // ASYNCDATABASE_H
@@ -0,0 +1,62 @@
+# 基准测试：qmake bench/bench.pro && make，运行 StudentGradeBench --students 100000 --classes 200
+# 结果写入 StudentGradeBench.json（可用 --json 指定），其余参数交给 QtTest，例如 -iterations 10
+# StudentTable 与逐行 QMap 的读取耗时和内存对比：getAllStudents / getAllStudentsAsRowMaps / studentTableMemory，
+# 分别以 --students 100000 和 --students 1000000 运行
+QT += core gui sql concurrent widgets testlib
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = StudentGradeBench
+
+APP = $$PWD/..
+INCLUDEPATH += $$APP
+
+SOURCES += \
+    studentgradebench.cpp \
+    syntheticdata.cpp \
+    $$APP/database.cpp \
+    $$APP/asyncdatabase.cpp \
+    $$APP/csvimporter.cpp \
+    $$APP/dataexporter.cpp \
+    $$APP/studentmodel.cpp \
+    $$APP/studenttable.cpp \
+    $$APP/subjectcatalogue.cpp \
+    $$APP/scorematrix.cpp \
+    $$APP/radixsort.cpp \
+    $$APP/statisticssnapshot.cpp \
+    $$APP/rankindex.cpp \
+    $$APP/connectionprofile.cpp \
+    $$APP/connectionpool.cpp \
+    $$APP/querytracer.cpp \
+    $$APP/statisticsdialog.cpp
+
+HEADERS += \
+    syntheticdata.h \
+    $$APP/database.h \
+    $$APP/asyncdatabase.h \
+    $$APP/csvimporter.h \
+    $$APP/dataexporter.h \
+    $$APP/studentmodel.h \
+    $$APP/studenttable.h \
+    $$APP/subjectcatalogue.h \
+    $$APP/scorematrix.h \
+    $$APP/radixsort.h \
+    $$APP/statisticssnapshot.h \
+    $$APP/rankindex.h \
+    $$APP/connectionprofile.h \
+    $$APP/connectionpool.h \
+    $$APP/querytracer.h \
+    $$APP/statisticsdialog.h
+
+FORMS += \
+    $$APP/statisticsdialog.ui
+
+# 与主程序输出到同一目录
+CONFIG(release, debug|release) {
+    DESTDIR = $$APP/release
+}
+
+CONFIG(debug, debug|release) {
+    DESTDIR = $$APP/debug
+}
@@ -0,0 +1,902 @@
+#include <QtTest>
+#include <QApplication>
+#include <QTemporaryDir>
+#include <QXmlStreamReader>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSqlRecord>
+#include "syntheticdata.h"
+#include "database.h"
+#include "asyncdatabase.h"
+#include "csvimporter.h"
+#include "dataexporter.h"
+#include "studentmodel.h"
+#include "statisticsdialog.h"
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+// 基准测试：在合成数据上测量 Database 各接口、表格模型和统计窗口
+// 数据规模通过 --students / --classes / --seed 指定，结果另存为 JSON 便于前后对比
+class StudentGradeBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StudentGradeBench(const SyntheticData::Options &options)
+        : data(options) {}
+
+    QString sqliteVersion;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    // 连接与表结构
+    void openDatabase();
+    void schemaVersion();
+    void checkQueryPlans();
+
+    // 单行读写
+    void isStudentExist();
+    void addAndDeleteStudent();
+    void updateStudent();
+    void applyStudentEdits();
+
+    // 批量写入，分别在交互和批量导入两种连接配置下测量
+    void insertStudentBatch_data();
+    void insertStudentBatch();
+    void importCsv_data();
+    void importCsv();
+
+    // 列表读取
+    void getAllStudentIds();
+    void getAllStudents();
+    void getAllStudentsChunked();
+    void getAllStudentsAsRowMaps();
+    void studentTableMemory_data();
+    void studentTableMemory();
+    void searchStudents_data();
+    void searchStudents();
+    void countStudents();
+    void countStudentsBefore();
+    void getStudentPage();
+    void getSortedStudentPage();
+
+    // 统计
+    void getStatisticsSnapshot();
+    void scanStatistics();
+    void parallelScanStatistics();
+    void aggregateScoreMatrix();
+    void getSubjectStats();
+    void getClassStats();
+    void getScoreDistribution();
+    void getTrendData();
+    void getRankIndex();
+    void recordExam();
+    void getExamTrend();
+    void rankIndexUpdate();
+    void getAllClasses();
+    void checkClassStats();
+    void rebuildClassStats();
+
+    // 导出
+    void exportStudents_data();
+    void exportStudents();
+    void exportStatistics();
+
+    // 表格模型与界面
+    void modelReset();
+    void modelIncrementalUpdate();
+    void modelUpdateRow();
+    void modelExternalChanges();
+    void modelSort_data();
+    void modelSort();
+    void modelData_data();
+    void modelData();
+    void pagedModelData();
+    void statisticsDialog_data();
+    void statisticsDialog();
+
+private:
+    QString scratchPath(const QString &name) const { return dir.filePath(name); }
+    ConnectionProfile profileFor(const QString &path, ConnectionProfile::Preset preset) const;
+
+    SyntheticData data;
+    QTemporaryDir dir;
+    ConnectionProfile profile;
+    Database db;
+    StudentTable allStudents;
+    QString csvPath;
+
+    // 自定义分数段会绕过 class_stats，强制扫描学生表
+    const QVector<double> customEdges = {0, 40, 60, 75, 85, 95, 100};
+};
+
+ConnectionProfile StudentGradeBench::profileFor(const QString &path, ConnectionProfile::Preset preset) const
+{
+    return ConnectionProfile::preset(preset, path);
+}
+
+void StudentGradeBench::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    const SyntheticData::Options &options = data.options();
+
+    profile = profileFor(scratchPath("bench.db"), ConnectionProfile::Preset::Interactive);
+    QVERIFY(db.openDatabase(profile, "bench"));
+
+    // 生成数据不计入结果，临时改用批量导入配置加快准备
+    QVERIFY(db.applyPragmas(profileFor(profile.databasePath, ConnectionProfile::Preset::BulkImport)));
+    QVERIFY(data.populate(&db));
+    QVERIFY(db.applyPragmas(profile));
+
+    csvPath = scratchPath("students.csv");
+    QVERIFY(data.writeCsv(csvPath));
+
+    allStudents = db.getAllStudents();
+    QCOMPARE(allStudents.size(), options.students);
+
+    QSqlQuery query(QSqlDatabase::database("bench"));
+    if (query.exec("SELECT sqlite_version()") && query.next())
+        sqliteVersion = query.value(0).toString();
+
+    qDebug() << "合成数据：" << options.students << "名学生，" << options.classes << "个班级，种子" << options.seed;
+}
+
+void StudentGradeBench::cleanupTestCase()
+{
+    const StatementCacheStats stats = db.statementCacheStats();
+    qDebug() << "预编译语句缓存命中率：" << stats.hitRate();
+}
+
+// ================ 连接与表结构 ================
+
+void StudentGradeBench::openDatabase()
+{
+    QBENCHMARK {
+        Database database;
+        QVERIFY(database.openDatabase(profile, "bench-open"));
+    }
+}
+
+void StudentGradeBench::schemaVersion()
+{
+    QBENCHMARK {
+        QVERIFY(db.schemaVersion() > 0);
+    }
+}
+
+void StudentGradeBench::checkQueryPlans()
+{
+    QStringList problems;
+    QBENCHMARK {
+        problems = db.checkQueryPlans();
+    }
+    QVERIFY2(problems.isEmpty(), qPrintable(problems.join("; ")));
+}
+
+// ================ 单行读写 ================
+
+void StudentGradeBench::isStudentExist()
+{
+    const int students = data.options().students;
+    int i = 0;
+    QBENCHMARK {
+        QVERIFY(db.isStudentExist(data.stuId(i++ % students)));
+    }
+}
+
+void StudentGradeBench::addAndDeleteStudent()
+{
+    const QString className = data.className(0);
+    int i = 0;
+    QBENCHMARK {
+        const QString stuId = QString("B%1").arg(i++);
+        QVERIFY(db.addStudent(stuId, "基准", className, QVector<double>(SubjectCount, 85)));
+        QVERIFY(db.deleteStudent(stuId));
+    }
+}
+
+void StudentGradeBench::updateStudent()
+{
+    const StudentRecord first = allStudents.record(0);
+    const QString stuId = first.stuId();
+    const QString name = first.name();
+    const QString className = first.className();
+    QVector<double> scores(SubjectCount, 80);
+    int i = 0;
+    QBENCHMARK {
+        scores[0] = 70 + i % 2;
+        QVERIFY(db.updateStudent(stuId, name, className, scores));
+        i++;
+    }
+}
+
+void StudentGradeBench::applyStudentEdits()
+{
+    // 一个班的成绩录入：前 40 名学生各改一科，写回队列合并后一次提交
+    const int count = qMin(40, allStudents.size());
+    QVector<StudentEdit> edits(count);
+    int i = 0;
+    QBENCHMARK {
+        for (int row = 0; row < count; row++) {
+            edits[row].id = allStudents.id(row);
+            edits[row].fields = StudentEdit::ScoreField;
+            edits[row].scores[0] = 70 + i % 2;
+        }
+        StudentTable rows;
+        QVector<QPair<int, QString>> errors;
+        QVERIFY(db.applyStudentEdits(edits, &rows, &errors));
+        QCOMPARE(rows.size(), count);
+        QVERIFY(errors.isEmpty());
+        i++;
+    }
+}
+
+// ================ 批量写入 ================
+
+void StudentGradeBench::insertStudentBatch_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::newRow("interactive") << int(ConnectionProfile::Preset::Interactive);
+    QTest::newRow("bulk-import") << int(ConnectionProfile::Preset::BulkImport);
+}
+
+void StudentGradeBench::insertStudentBatch()
+{
+    QFETCH(int, preset);
+
+    // 写到单独的数据库，不改变其他测试使用的数据
+    const QString path = scratchPath(QString("batch-%1.db").arg(preset));
+    Database database;
+    QVERIFY(database.openDatabase(profileFor(path, ConnectionProfile::Preset(preset)), "bench-batch"));
+
+    // 每次写入一批新的学号，数据库随迭代增长
+    const int batchSize = CsvImporter::BatchSize;
+    SyntheticData::Options options = data.options();
+    options.students = std::numeric_limits<int>::max();
+    const SyntheticData source(options);
+
+    int first = 0;
+    StudentBatch batch;
+    QVector<QPair<int, QString>> rowErrors;
+    QBENCHMARK {
+        batch.clear();
+        source.fill(first, batchSize, &batch);
+        first += batchSize;
+        QVERIFY(database.insertStudentBatch(batch, &rowErrors));
+        QVERIFY(rowErrors.isEmpty());
+    }
+}
+
+void StudentGradeBench::importCsv_data()
+{
+    insertStudentBatch_data();
+}
+
+void StudentGradeBench::importCsv()
+{
+    QFETCH(int, preset);
+
+    const QString path = scratchPath(QString("import-%1.db").arg(preset));
+    CsvImporter::Result result;
+    QBENCHMARK {
+        // 每次导入到空库，包含建表和建索引的开销
+        QFile::remove(path);
+        QFile::remove(path + "-wal");
+        QFile::remove(path + "-shm");
+        Database database;
+        QVERIFY(database.openDatabase(profileFor(path, ConnectionProfile::Preset(preset)), "bench-import"));
+        result = CsvImporter(&database).importFile(csvPath);
+    }
+    QVERIFY2(result.fatalError.isEmpty(), qPrintable(result.fatalError));
+    QCOMPARE(result.rowsImported, qint64(data.options().students));
+}
+
+// ================ 列表读取 ================
+
+void StudentGradeBench::getAllStudentIds()
+{
+    QBENCHMARK {
+        QCOMPARE(int(db.getAllStudentIds().size()), data.options().students);
+    }
+}
+
+void StudentGradeBench::getAllStudents()
+{
+    QBENCHMARK {
+        QCOMPARE(db.getAllStudents().size(), data.options().students);
+    }
+}
+
+void StudentGradeBench::getAllStudentsChunked()
+{
+    QBENCHMARK {
+        int rows = 0;
+        db.getAllStudents(AsyncDatabase::ChunkSize, [&rows](StudentTable &&chunk) {
+            rows += chunk.size();
+            return true;
+        });
+        QCOMPARE(rows, data.options().students);
+    }
+}
+
+// 改为 StudentTable 之前的读取方式：每行一个按列名取值的 QMap，作为 getAllStudents 的对照
+static QVector<QMap<QString, QVariant>> readRowMaps(const QString &connectionName)
+{
+    QVector<QMap<QString, QVariant>> students;
+    QSqlQuery query(QSqlDatabase::database(connectionName));
+    query.exec("SELECT * FROM students ORDER BY class, stu_id");
+    const QSqlRecord record = query.record();
+    while (query.next()) {
+        QMap<QString, QVariant> student;
+        for (int i = 0; i < record.count(); i++)
+            student[record.fieldName(i)] = query.value(record.fieldName(i));
+        students.append(student);
+    }
+    return students;
+}
+
+// 进程的常驻内存（字节），取不到时为 -1
+static qint64 residentBytes()
+{
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
+void StudentGradeBench::getAllStudentsAsRowMaps()
+{
+    QBENCHMARK {
+        QCOMPARE(readRowMaps("bench").size(), data.options().students);
+    }
+}
+
+void StudentGradeBench::studentTableMemory_data()
+{
+    QTest::addColumn<bool>("rowMaps");
+    QTest::newRow("columnar") << false;
+    QTest::newRow("row-maps") << true;
+}
+
+// 读出整张表前后常驻内存的增长；之前的用例释放的内存可能被复用，
+// 需要准确的数值时单独运行：StudentGradeBench studentTableMemory --students 1000000
+void StudentGradeBench::studentTableMemory()
+{
+    QFETCH(bool, rowMaps);
+    const qint64 before = residentBytes();
+    if (before < 0)
+        QSKIP("无法读取进程内存占用");
+
+    int rows = 0;
+    qint64 after = 0;
+    if (rowMaps) {
+        const QVector<QMap<QString, QVariant>> students = readRowMaps("bench");
+        rows = students.size();
+        after = residentBytes();
+    } else {
+        const StudentTable students = db.getAllStudents();
+        rows = students.size();
+        after = residentBytes();
+    }
+    QCOMPARE(rows, data.options().students);
+    QTest::setBenchmarkResult(qreal(after - before), QTest::BytesAllocated);
+}
+
+void StudentGradeBench::searchStudents_data()
+{
+    QTest::addColumn<QString>("keyword");
+    QTest::newRow("stu-id") << data.stuId(data.options().students / 2);
+    QTest::newRow("class") << data.className(1);
+    QTest::newRow("short") << QString("王");
+}
+
+void StudentGradeBench::searchStudents()
+{
+    QFETCH(QString, keyword);
+    QBENCHMARK {
+        QVERIFY(!db.searchStudents(keyword).isEmpty());
+    }
+}
+
+void StudentGradeBench::countStudents()
+{
+    QBENCHMARK {
+        QCOMPARE(db.countStudents(), data.options().students);
+    }
+}
+
+void StudentGradeBench::countStudentsBefore()
+{
+    const StudentRecord middle = allStudents.record(allStudents.size() / 2);
+    const QString className = middle.className();
+    const QString stuId = middle.stuId();
+    QBENCHMARK {
+        QCOMPARE(db.countStudentsBefore(className, stuId), allStudents.size() / 2);
+    }
+}
+
+void StudentGradeBench::getStudentPage()
+{
+    // 从中间某行之后取一页，模拟拖动滚动条后的分页读取
+    const StudentRecord anchor = allStudents.record(allStudents.size() / 2);
+    const QString className = anchor.className();
+    const QString stuId = anchor.stuId();
+    QBENCHMARK {
+        db.getStudentPage(className, stuId, 0, StudentModel::PageSize);
+    }
+}
+
+void StudentGradeBench::getSortedStudentPage()
+{
+    // 按总分降序从中间某行之后取一页，第一次调用时建立排序索引
+    const int afterId = allStudents.id(allStudents.size() / 2);
+    QCOMPARE(db.getSortedStudentPage(Database::ColTotal, true, afterId, 0, 1).size(), 1);
+    QBENCHMARK {
+        db.getSortedStudentPage(Database::ColTotal, true, afterId, 0, StudentModel::PageSize);
+    }
+}
+
+// ================ 统计 ================
+
+void StudentGradeBench::getStatisticsSnapshot()
+{
+    QBENCHMARK {
+        QCOMPARE(db.getStatisticsSnapshot().school.studentCount, qint64(data.options().students));
+    }
+}
+
+void StudentGradeBench::scanStatistics()
+{
+    QBENCHMARK {
+        QCOMPARE(db.getStatisticsSnapshot(customEdges).school.studentCount, qint64(data.options().students));
+    }
+}
+
+void StudentGradeBench::parallelScanStatistics()
+{
+    AsyncDatabase async(profile);
+    QBENCHMARK {
+        QCOMPARE(async.getStatisticsSnapshot(customEdges).result().school.studentCount,
+                 qint64(data.options().students));
+    }
+}
+
+void StudentGradeBench::aggregateScoreMatrix()
+{
+    // 只计内存中的一遍汇总，不含读表；对应 scanStatistics 中读完成绩之后的部分
+    const ScoreMatrix &matrix = allStudents.scoreMatrix();
+    SubjectAggregate subjects[SubjectCount];
+    QBENCHMARK {
+        matrix.aggregate(0, matrix.rows(), customEdges, subjects);
+    }
+
+    const StatisticsSnapshot snapshot = db.getStatisticsSnapshot(customEdges);
+    const ClassAggregate &school = snapshot.school;
+    for (int s = 0; s < SubjectCount; s++) {
+        QCOMPARE(subjects[s].count, school.subjects[s].count);
+        QCOMPARE(subjects[s].passCount, school.subjects[s].passCount);
+        QCOMPARE(subjects[s].buckets, school.subjects[s].buckets);
+    }
+}
+
+void StudentGradeBench::getSubjectStats()
+{
+    QBENCHMARK {
+        db.getSubjectStats(Subject::Math);
+    }
+}
+
+void StudentGradeBench::getClassStats()
+{
+    QBENCHMARK {
+        QCOMPARE(int(db.getClassStats().size()), data.options().classes);
+    }
+}
+
+void StudentGradeBench::getScoreDistribution()
+{
+    QBENCHMARK {
+        db.getScoreDistribution(Subject::English);
+    }
+}
+
+void StudentGradeBench::getTrendData()
+{
+    QBENCHMARK {
+        db.getTrendData();
+    }
+}
+
+void StudentGradeBench::getRankIndex()
+{
+    QBENCHMARK {
+        QCOMPARE(db.getRankIndex().schoolCount(RankIndex::TotalKey), allStudents.size());
+    }
+}
+
+void StudentGradeBench::recordExam()
+{
+    QBENCHMARK {
+        const int examId = db.recordExam("基准", QDate::currentDate());
+        QVERIFY(examId > 0);
+        QVERIFY(db.deleteExam(examId));
+    }
+}
+
+void StudentGradeBench::getExamTrend()
+{
+    // 趋势至少需要两次考试
+    const int first = db.recordExam("基准一", QDate::currentDate().addMonths(-1));
+    const int second = db.recordExam("基准二", QDate::currentDate());
+    QVERIFY(first > 0 && second > 0);
+
+    QBENCHMARK {
+        const ExamTrend trend = db.getExamTrend();
+        QVERIFY(trend.exams.size() >= 2);
+        QVERIFY(!trend.classTrend.isEmpty());
+    }
+
+    QVERIFY(db.deleteExam(first));
+    QVERIFY(db.deleteExam(second));
+}
+
+void StudentGradeBench::rankIndexUpdate()
+{
+    RankIndex index = db.getRankIndex();
+
+    // 改动一名学生的成绩后重新查询他的名次，对应界面上修改成绩后排名列的更新
+    StudentTable original;
+    original.appendRow(allStudents, 0);
+    float fullScores[SubjectCount];
+    std::fill(std::begin(fullScores), std::end(fullScores), float(FullScore));
+    StudentTable changed;
+    changed.append(original.id(0), original.stuId(0), original.name(0), original.className(0),
+                   fullScores, FullScore * SubjectCount, FullScore);
+    QBENCHMARK {
+        index.removeStudent(original, 0);
+        index.addStudent(changed, 0);
+        QVERIFY(index.schoolRank(RankIndex::TotalKey, changed.total(0)) > 0);
+        QVERIFY(index.classRank(changed.className(0), RankIndex::TotalKey, changed.total(0)) > 0);
+        std::swap(original, changed);
+    }
+    QCOMPARE(index.schoolCount(RankIndex::TotalKey), allStudents.size());
+}
+
+void StudentGradeBench::getAllClasses()
+{
+    QBENCHMARK {
+        QCOMPARE(int(db.getAllClasses().size()), data.options().classes);
+    }
+}
+
+void StudentGradeBench::checkClassStats()
+{
+    QStringList differences;
+    QBENCHMARK {
+        QVERIFY(db.checkClassStats(&differences));
+    }
+    QVERIFY2(differences.isEmpty(), qPrintable(differences.join("; ")));
+}
+
+void StudentGradeBench::rebuildClassStats()
+{
+    QBENCHMARK {
+        QVERIFY(db.rebuildClassStats());
+    }
+}
+
+// ================ 导出 ================
+
+void StudentGradeBench::exportStudents_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::newRow("csv") << int(DataExporter::Format::Csv);
+    QTest::newRow("jsonl") << int(DataExporter::Format::JsonLines);
+}
+
+void StudentGradeBench::exportStudents()
+{
+    QFETCH(int, format);
+    const DataExporter::Format exportFormat = DataExporter::Format(format);
+    const QString path = scratchPath("students." + DataExporter::extension(exportFormat));
+
+    DataExporter::Result result;
+    QBENCHMARK {
+        result = DataExporter(&db).exportStudents(path, exportFormat);
+    }
+    QVERIFY2(result.error.isEmpty(), qPrintable(result.error));
+    QCOMPARE(result.rowsWritten, qint64(data.options().students));
+
+    if (result.elapsedMs > 0) {
+        qDebug() << "导出速度：" << result.bytesWritten / 1048576.0 / (result.elapsedMs / 1000.0) << "MB/s";
+    }
+}
+
+void StudentGradeBench::exportStatistics()
+{
+    const QString path = scratchPath("statistics");
+    QBENCHMARK {
+        QVERIFY(DataExporter(&db).exportStatistics(path, DataExporter::Format::Csv).error.isEmpty());
+    }
+}
+
+// ================ 表格模型与界面 ================
+
+void StudentGradeBench::modelReset()
+{
+    StudentModel model;
+    QBENCHMARK {
+        model.setStudents(allStudents);
+    }
+    QCOMPARE(model.rowCount(), allStudents.size());
+}
+
+void StudentGradeBench::modelIncrementalUpdate()
+{
+    StudentModel model;
+    model.setStudents(allStudents);
+
+    // 插入一行再删掉，对应界面上添加、删除学生后的局部更新
+    float scores[SubjectCount];
+    std::fill(std::begin(scores), std::end(scores), 85.0f);
+    StudentTable added;
+    added.append(0, "B00000000", "基准", data.className(0), scores, 85 * SubjectCount, 85);
+    QBENCHMARK {
+        const int row = model.insertStudent(added, 0);
+        QVERIFY(model.removeStudent(row, added.stuId(0)));
+    }
+    QCOMPARE(model.rowCount(), allStudents.size());
+}
+
+// 与 modelReset 对比：修改一名学生后只替换这一行，而不是整表重新设置
+void StudentGradeBench::modelUpdateRow()
+{
+    StudentModel model;
+    model.setStudents(allStudents);
+    model.setRankIndex(db.getRankIndex());
+
+    // 交替写入原来的一行和只改了姓名的一行，每次迭代都是一次真正的修改
+    StudentTable versions[2];
+    versions[0].appendRow(allStudents, 0);
+    float scores[SubjectCount];
+    for (int s = 0; s < SubjectCount; s++)
+        scores[s] = allStudents.score(0, Subject(s));
+    versions[1].append(allStudents.id(0), allStudents.stuId(0), allStudents.name(0) + "改", allStudents.className(0),
+                       scores, allStudents.total(0), allStudents.average(0));
+    const QVector<int> ids = {allStudents.id(0)};
+    int i = 0;
+    QBENCHMARK {
+        bool ranksStale = false;
+        QVERIFY(model.applyChanges(ids, versions[++i % 2], true, &ranksStale));
+    }
+    QCOMPARE(model.rowCount(), allStudents.size());
+}
+
+void StudentGradeBench::modelExternalChanges()
+{
+    StudentModel model;
+    model.setStudents(db.getAllStudents());
+    model.setRankIndex(db.getRankIndex());
+
+    // 另一个程序改了一个班的成绩：读出变更记录和这些学生，增量应用到表格
+    // 计时包含写入本身，与 applyStudentEdits 的结果相减即为增量刷新的耗时
+    const int count = qMin(40, allStudents.size());
+    QVector<StudentEdit> edits(count);
+    int i = 0;
+    QBENCHMARK {
+        const qint64 afterSeq = db.lastChangeSeq();
+        for (int row = 0; row < count; row++) {
+            edits[row].id = allStudents.id(row);
+            edits[row].fields = StudentEdit::ScoreField;
+            edits[row].scores[0] = 60 + i % 2;
+        }
+        QVERIFY(db.applyStudentEdits(edits, nullptr, nullptr));
+
+        QVector<int> ids;
+        qint64 lastSeq = 0;
+        QVERIFY(db.getChangedStudentIds(afterSeq, 1000, &ids, &lastSeq));
+        QCOMPARE(ids.size(), count);
+        bool ranksStale = false;
+        QVERIFY(model.applyChanges(ids, db.getStudentsByIds(ids), true, &ranksStale));
+        QVERIFY(!ranksStale);
+        i++;
+    }
+    QCOMPARE(model.rowCount(), allStudents.size());
+}
+
+void StudentGradeBench::modelData_data()
+{
+    QTest::addColumn<int>("role");
+    QTest::newRow("display") << int(Qt::DisplayRole);
+    QTest::newRow("foreground") << int(Qt::ForegroundRole);
+    QTest::newRow("alignment") << int(Qt::TextAlignmentRole);
+}
+
+void StudentGradeBench::modelData()
+{
+    QFETCH(int, role);
+
+    StudentModel model;
+    model.setStudents(allStudents);
+    // 排名列的单元格也在 data() 中按索引取值，一并计入
+    model.setRankIndex(db.getRankIndex());
+
+    // 每次迭代取一屏多一点的单元格，与滚动时视图的调用方式相近
+    const int rows = qMin(model.rowCount(), 1000);
+    const int columns = model.columnCount();
+    QBENCHMARK {
+        for (int row = 0; row < rows; row++) {
+            for (int column = 0; column < columns; column++)
+                model.data(model.index(row, column), role);
+        }
+    }
+}
+
+void StudentGradeBench::modelSort_data()
+{
+    QTest::addColumn<QString>("header");
+    QTest::newRow("total") << QString("总分");
+    QTest::newRow("name") << QString("姓名");
+    QTest::newRow("class-rank") << QString("班级排名");
+}
+
+void StudentGradeBench::modelSort()
+{
+    QFETCH(QString, header);
+    StudentModel model;
+    model.setStudents(allStudents);
+    model.setRankIndex(db.getRankIndex());
+
+    int column = 0;
+    while (column < model.columnCount() && model.headerData(column, Qt::Horizontal).toString() != header)
+        column++;
+    QVERIFY(column < model.columnCount());
+
+    // 每次迭代升序、降序各排一遍，相同的排序不会重复执行
+    QBENCHMARK {
+        model.sort(column, Qt::DescendingOrder);
+        model.sort(column, Qt::AscendingOrder);
+    }
+    QCOMPARE(model.rowCount(), allStudents.size());
+}
+
+void StudentGradeBench::pagedModelData()
+{
+    StudentModel model;
+    model.setPagedSource(&db, db.countStudents());
+
+    // 按固定步长跳着读，让页缓存不断换入换出
+    const int total = model.rowCount();
+    const int step = qMax(1, total / 997);
+    int row = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; i++) {
+            model.data(model.index(row, 1), Qt::DisplayRole);
+            row = (row + step) % total;
+        }
+    }
+}
+
+void StudentGradeBench::statisticsDialog_data()
+{
+    QTest::addColumn<bool>("background");
+    QTest::newRow("sync") << false;
+    QTest::newRow("async") << true;
+}
+
+// sync 为构造时在界面线程上统计并填表的全部耗时；
+// async 与主窗口相同，统计在读线程上进行，计时只含构造，即打开窗口时界面线程被占用的时间
+void StudentGradeBench::statisticsDialog()
+{
+    QFETCH(bool, background);
+    AsyncDatabase async(profile);
+    QBENCHMARK {
+        StatisticsDialog dialog(nullptr, &db, background ? &async : nullptr);
+    }
+}
+
+// ================ 结果转换为 JSON ================
+
+// QtTest 的 XML 输出中每个 BenchmarkResult 对应一项结果，value 为每次迭代的数值
+static bool writeJson(const QString &xmlPath, const QString &jsonPath, const QJsonObject &header)
+{
+    QFile xmlFile(xmlPath);
+    if (!xmlFile.open(QIODevice::ReadOnly))
+        return false;
+
+    QJsonArray results;
+    QString function;
+    QXmlStreamReader xml(&xmlFile);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement)
+            continue;
+
+        const QXmlStreamAttributes attributes = xml.attributes();
+        if (xml.name() == QLatin1String("TestFunction")) {
+            function = attributes.value("name").toString();
+        } else if (xml.name() == QLatin1String("BenchmarkResult")) {
+            QJsonObject result;
+            result["function"] = function;
+            result["tag"] = attributes.value("tag").toString();
+            result["metric"] = attributes.value("metric").toString();
+            result["value"] = attributes.value("value").toDouble();
+            result["iterations"] = attributes.value("iterations").toInt();
+            results.append(result);
+        }
+    }
+    if (xml.hasError()) {
+        qWarning() << "解析测试结果失败：" << xml.errorString();
+        return false;
+    }
+
+    QJsonObject root = header;
+    root["results"] = results;
+
+    QFile jsonFile(jsonPath);
+    if (!jsonFile.open(QIODevice::WriteOnly))
+        return false;
+    return jsonFile.write(QJsonDocument(root).toJson()) > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // 统计窗口需要 QApplication；无显示环境下可设置 QT_QPA_PLATFORM=offscreen
+    QApplication app(argc, argv);
+    app.setApplicationName("StudentGradeBench");
+
+    // 自己的参数：--students N --classes N --seed N --json 文件；其余原样交给 QtTest
+    SyntheticData::Options options;
+    QString jsonPath = "StudentGradeBench.json";
+    QStringList testArguments;
+    const QStringList arguments = app.arguments();
+    for (int i = 0; i < arguments.size(); i++) {
+        const QString &argument = arguments.at(i);
+        const bool hasValue = i + 1 < arguments.size();
+        if (argument == "--students" && hasValue) {
+            options.students = arguments.at(++i).toInt();
+        } else if (argument == "--classes" && hasValue) {
+            options.classes = arguments.at(++i).toInt();
+        } else if (argument == "--seed" && hasValue) {
+            options.seed = arguments.at(++i).toUInt();
+        } else if (argument == "--json" && hasValue) {
+            jsonPath = arguments.at(++i);
+        } else {
+            testArguments << argument;
+        }
+    }
+
+    QTemporaryDir xmlDir;
+    const QString xmlPath = xmlDir.filePath("results.xml");
+    testArguments << "-o" << xmlPath + ",xml" << "-o" << "-,txt";
+
+    StudentGradeBench bench(options);
+    const int status = QTest::qExec(&bench, testArguments);
+
+    QJsonObject header;
+    header["suite"] = "StudentGradeBench";
+    header["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    header["qt"] = qVersion();
+    header["sqlite"] = bench.sqliteVersion;
+    header["students"] = options.students;
+    header["classes"] = options.classes;
+    header["seed"] = qint64(options.seed);
+
+    if (!writeJson(xmlPath, jsonPath, header)) {
+        qWarning() << "无法写入结果文件：" << jsonPath;
+        return status == 0 ? 1 : status;
+    }
+    qDebug() << "结果已写入" << jsonPath;
+    return status;
+}
+
+#include "studentgradebench.moc"
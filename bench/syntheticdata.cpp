@@ -0,0 +1,157 @@
+#include "syntheticdata.h"
+#include <QSaveFile>
+#include <QtMath>
+#include <QtNumeric>
+#include <QDebug>
+
+// SplitMix64：状态只有一个整数，可以按学生编号直接定位，不依赖标准库的分布实现
+class SplitMix64
+{
+public:
+    explicit SplitMix64(quint64 seed) : state(seed) {}
+
+    quint64 next()
+    {
+        quint64 z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1) 均匀分布
+    double uniform() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Box-Muller 变换得到正态分布
+    double normal(double mean, double stddev)
+    {
+        const double u1 = 1.0 - uniform();
+        const double u2 = uniform();
+        return mean + stddev * qSqrt(-2.0 * qLn(u1)) * qCos(2.0 * M_PI * u2);
+    }
+
+private:
+    quint64 state;
+};
+
+static quint64 mixSeed(quint32 seed, quint64 stream, quint64 index)
+{
+    return (quint64(seed) << 32) ^ (stream << 56) ^ index;
+}
+
+// 各科平均分和标准差，大致参照一次期中考试；科目多于三科时依次循环
+static const double SubjectMeans[] = {76, 72, 74};
+static const double SubjectSpread = 9;
+static const double AbilitySpread = 8;
+static const double ClassSpread = 4;
+
+SyntheticData::SyntheticData(const Options &options)
+    : opts(options)
+{
+    opts.students = qMax(0, opts.students);
+    opts.classes = qMax(1, opts.classes);
+}
+
+QString SyntheticData::stuId(int student) const
+{
+    return QString("S%1").arg(student, 8, 10, QChar('0'));
+}
+
+QString SyntheticData::className(int classIndex) const
+{
+    return QString("%1级%2班").arg(2023 + classIndex % 3).arg(classIndex / 3 + 1, 2, 10, QChar('0'));
+}
+
+double SyntheticData::classOffset(int classIndex) const
+{
+    SplitMix64 random(mixSeed(opts.seed, 1, quint64(classIndex)));
+    return random.normal(0, ClassSpread);
+}
+
+SyntheticData::Student SyntheticData::student(int index) const
+{
+    static const QString surnames = "王李张刘陈杨黄赵吴周徐孙马朱胡郭何高林罗";
+    static const QString givenChars = "伟芳娜敏静丽强磊军洋勇艳杰娟涛明超秀霞平刚桂英华玉萍红建文";
+
+    SplitMix64 random(mixSeed(opts.seed, 0, quint64(index)));
+    const int classIndex = index % opts.classes;
+
+    Student s;
+    s.stuId = stuId(index);
+    s.className = className(classIndex);
+    s.name = surnames.at(int(random.next() % surnames.size()));
+    const int givenLength = random.uniform() < 0.6 ? 2 : 1;
+    for (int i = 0; i < givenLength; i++)
+        s.name += givenChars.at(int(random.next() % givenChars.size()));
+
+    // 学生能力与班级水平叠加到各科均值上，再加单科波动；按 0.5 分取整并截到 0-100
+    const double base = random.normal(0, AbilitySpread) + classOffset(classIndex);
+    for (int subject = 0; subject < SubjectCount; subject++) {
+        if (random.uniform() < opts.missingRate) {
+            s.scores[subject] = qQNaN();
+            continue;
+        }
+        const double score = random.normal(SubjectMeans[subject % std::size(SubjectMeans)] + base, SubjectSpread);
+        s.scores[subject] = qBound(0.0, qRound(score * 2) / 2.0, double(FullScore));
+    }
+    return s;
+}
+
+void SyntheticData::fill(int first, int count, StudentBatch *batch) const
+{
+    const int end = qMin(opts.students, first + count);
+    for (int i = first; i < end; i++) {
+        const Student s = student(i);
+        batch->stuIds.append(s.stuId);
+        batch->names.append(s.name);
+        batch->classes.append(s.className);
+        for (int subject = 0; subject < SubjectCount; subject++) {
+            batch->scores[subject].append(qIsNaN(s.scores[subject]) ? QVariant() : QVariant(s.scores[subject]));
+        }
+    }
+}
+
+bool SyntheticData::populate(Database *database, int batchSize) const
+{
+    StudentBatch batch;
+    QVector<QPair<int, QString>> rowErrors;
+
+    for (int first = 0; first < opts.students; first += batchSize) {
+        batch.clear();
+        fill(first, batchSize, &batch);
+        if (!database->insertStudentBatch(batch, &rowErrors) || !rowErrors.isEmpty()) {
+            qDebug() << "写入合成数据失败，起始编号：" << first;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SyntheticData::writeCsv(const QString &filePath) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray buffer = "stu_id,name,class";
+    for (const SubjectInfo &subject : SubjectCatalogue)
+        buffer += QByteArray(",") + subject.column;
+    buffer += '\n';
+    for (int i = 0; i < opts.students; i++) {
+        const Student s = student(i);
+        buffer += s.stuId.toUtf8() + ',' + s.name.toUtf8() + ',' + s.className.toUtf8();
+        for (double score : s.scores) {
+            buffer += ',';
+            if (!qIsNaN(score))
+                buffer += QByteArray::number(score);
+        }
+        buffer += '\n';
+
+        if (buffer.size() >= 256 * 1024) {
+            if (file.write(buffer) != buffer.size())
+                return false;
+            buffer.resize(0);
+        }
+    }
+
+    return file.write(buffer) == buffer.size() && file.commit();
+}
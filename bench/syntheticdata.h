@@ -0,0 +1,50 @@
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include <QString>
+#include "database.h"
+
+// 基准测试用的合成数据
+// 第 i 个学生只由种子和 i 决定，同样的参数在任何平台上都生成完全相同的数据，
+// 因此不同版本的测试结果可以直接比较
+class SyntheticData
+{
+public:
+    struct Options
+    {
+        int students = 10000;
+        int classes = 50;
+        quint32 seed = 20240901;
+        double missingRate = 0.02;   // 成绩未录入的比例
+    };
+
+    explicit SyntheticData(const Options &options);
+
+    const Options &options() const { return opts; }
+
+    QString stuId(int student) const;
+    QString className(int classIndex) const;
+
+    // 把第 first 个起的 count 个学生追加到 batch
+    void fill(int first, int count, StudentBatch *batch) const;
+    // 按批写入数据库
+    bool populate(Database *database, int batchSize = 5000) const;
+    // 写成 CsvImporter 可以导入的 CSV 文件（带表头）
+    bool writeCsv(const QString &filePath) const;
+
+private:
+    struct Student
+    {
+        QString stuId;
+        QString name;
+        QString className;
+        double scores[SubjectCount];   // NaN 表示未录入
+    };
+
+    Student student(int index) const;
+    double classOffset(int classIndex) const;
+
+    Options opts;
+};
+
+#endif // SYNTHETICDATA_H
@@ -0,0 +1,64 @@
+#include "connectionpool.h"
+#include "database.h"
+#include <QtConcurrent>
+#include <QDebug>
+#include <atomic>
+
+static std::atomic<int> nextPoolId{0};
+
+ConnectionPool::ConnectionPool(const ConnectionProfile &profile, int readerCount)
+    : writeProfile(profile)
+    , readProfile(profile)
+    , poolId(nextPoolId++)
+{
+    readProfile.readOnly = true;
+
+    // 线程永不过期，连接一直留在同一个线程里
+    writerThread.setMaxThreadCount(1);
+    writerThread.setExpiryTimeout(-1);
+    readerThreads.setMaxThreadCount(qMax(1, readerCount));
+    readerThreads.setExpiryTimeout(-1);
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    // waitForDone 会等到读线程全部退出，QThreadStorage 随之在各线程中关闭读连接
+    readerThreads.waitForDone();
+
+    // 写连接必须在创建它的线程中关闭
+    QtConcurrent::run(&writerThread, [this]() {
+        delete writeConnection;
+        writeConnection = nullptr;
+    }).waitForFinished();
+    writerThread.waitForDone();
+}
+
+Database *ConnectionPool::writer()
+{
+    if (!writeConnection) {
+        writeConnection = new Database();
+        if (!writeConnection->openDatabase(writeProfile, QString("pool%1-writer").arg(poolId))) {
+            qDebug() << "写线程无法打开数据库：" << writeProfile.databasePath;
+            delete writeConnection;
+            writeConnection = nullptr;
+        }
+    }
+    return writeConnection;
+}
+
+Database *ConnectionPool::reader()
+{
+    if (readConnections.hasLocalData())
+        return readConnections.localData();
+
+    static std::atomic<int> nextReader{0};
+    Database *database = new Database();
+    if (!database->openDatabase(readProfile, QString("pool%1-reader%2").arg(poolId).arg(nextReader++))) {
+        qDebug() << "读线程无法打开数据库：" << readProfile.databasePath;
+        delete database;
+        return nullptr;
+    }
+
+    readConnections.setLocalData(database);
+    return database;
+}
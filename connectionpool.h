@@ -0,0 +1,43 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include "connectionprofile.h"
+
+class Database;
+
+// 数据库连接池：一个写线程加若干读线程，每个线程使用自己的命名连接
+// 写操作全部排在唯一的写线程上，不会互相争抢写锁；
+// WAL 模式下读连接可以与写线程以及彼此并发执行
+class ConnectionPool
+{
+public:
+    explicit ConnectionPool(const ConnectionProfile &profile, int readerCount = QThread::idealThreadCount());
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+    QThreadPool *writerPool() { return &writerThread; }
+    QThreadPool *readerPool() { return &readerThreads; }
+    int readerCount() const { return readerThreads.maxThreadCount(); }
+    const ConnectionProfile &profile() const { return writeProfile; }
+
+    // 只能在写线程中调用，第一次调用时打开连接
+    Database *writer();
+    // 只能在读线程中调用，每个线程第一次调用时打开自己的只读连接，线程退出时关闭
+    Database *reader();
+
+private:
+    ConnectionProfile writeProfile;
+    ConnectionProfile readProfile;
+    QThreadPool writerThread;
+    QThreadPool readerThreads;
+    Database *writeConnection = nullptr;        // 只在写线程中访问
+    QThreadStorage<Database *> readConnections; // 各读线程各自一份
+    const int poolId;                           // 区分不同连接池的连接名
+};
+
+#endif // CONNECTIONPOOL_H
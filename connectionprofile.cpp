@@ -0,0 +1,110 @@
+#include "connectionprofile.h"
+#include <QSettings>
+#include <QStandardPaths>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+ConnectionProfile ConnectionProfile::preset(Preset preset, const QString &databasePath)
+{
+    ConnectionProfile profile;
+    profile.databasePath = databasePath;
+
+    switch (preset) {
+    case Preset::Interactive:
+        break;
+    case Preset::BulkImport:
+        // 导入中途断电会丢失最近提交的批次，导入结束后应恢复为交互配置
+        profile.synchronous = "OFF";
+        profile.cacheSizeKiB = 256 * 1024;
+        profile.busyTimeoutMs = 30000;
+        break;
+    case Preset::ReadOnlyReporting:
+        profile.readOnly = true;
+        profile.cacheSizeKiB = 128 * 1024;
+        profile.mmapSizeBytes = 1024LL * 1024 * 1024;
+        profile.busyTimeoutMs = 10000;
+        break;
+    }
+
+    return profile;
+}
+
+bool ConnectionProfile::presetFromName(const QString &name, Preset *preset)
+{
+    static const Preset presets[] = {Preset::Interactive, Preset::BulkImport, Preset::ReadOnlyReporting};
+    for (Preset candidate : presets) {
+        if (name.compare(presetName(candidate), Qt::CaseInsensitive) == 0) {
+            *preset = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString ConnectionProfile::presetName(Preset preset)
+{
+    switch (preset) {
+    case Preset::Interactive: return "interactive";
+    case Preset::BulkImport: return "bulk-import";
+    case Preset::ReadOnlyReporting: return "reporting";
+    }
+    return QString();
+}
+
+ConnectionProfile ConnectionProfile::fromSettings(const QSettings &settings)
+{
+    Preset base = Preset::Interactive;
+    const QString name = settings.value("database/preset").toString();
+    if (!name.isEmpty() && !presetFromName(name, &base)) {
+        qDebug() << "未知的连接预设：" << name << "，使用 interactive";
+    }
+
+    ConnectionProfile profile = preset(base, settings.value("database/path", defaultDatabasePath()).toString());
+    profile.journalMode = settings.value("database/journal_mode", profile.journalMode).toString().toUpper();
+    profile.synchronous = settings.value("database/synchronous", profile.synchronous).toString().toUpper();
+    profile.cacheSizeKiB = settings.value("database/cache_size_kib", profile.cacheSizeKiB).toInt();
+    profile.mmapSizeBytes = settings.value("database/mmap_size", profile.mmapSizeBytes).toLongLong();
+    profile.tempStore = settings.value("database/temp_store", profile.tempStore).toString().toUpper();
+    profile.busyTimeoutMs = settings.value("database/busy_timeout_ms", profile.busyTimeoutMs).toInt();
+    profile.readOnly = settings.value("database/read_only", profile.readOnly).toBool();
+    return profile;
+}
+
+QString ConnectionProfile::defaultDatabasePath()
+{
+#ifdef Q_OS_WIN
+    // 兼容早期版本固定使用的位置
+    const QString legacyPath = "D:/StudentData/student_grade.db";
+    if (QFile::exists(legacyPath))
+        return legacyPath;
+#endif
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return QDir(dir).filePath("student_grade.db");
+}
+
+QStringList ConnectionProfile::pragmas() const
+{
+    // PRAGMA 不能绑定参数，文本取值只接受下列关键字
+    static const QStringList journalModes = {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"};
+    static const QStringList synchronousLevels = {"OFF", "NORMAL", "FULL", "EXTRA"};
+    static const QStringList tempStores = {"DEFAULT", "FILE", "MEMORY"};
+
+    QStringList statements;
+    statements << QString("PRAGMA busy_timeout = %1").arg(qMax(0, busyTimeoutMs));
+
+    // 只读连接不能切换日志模式
+    if (!readOnly && journalModes.contains(journalMode))
+        statements << QString("PRAGMA journal_mode = %1").arg(journalMode);
+    if (synchronousLevels.contains(synchronous))
+        statements << QString("PRAGMA synchronous = %1").arg(synchronous);
+
+    // 负数表示以 KiB 为单位
+    statements << QString("PRAGMA cache_size = -%1").arg(qMax(0, cacheSizeKiB))
+               << QString("PRAGMA mmap_size = %1").arg(qMax<qint64>(0, mmapSizeBytes));
+    if (tempStores.contains(tempStore))
+        statements << QString("PRAGMA temp_store = %1").arg(tempStore);
+
+    statements << QString("PRAGMA query_only = %1").arg(readOnly ? 1 : 0);
+    return statements;
+}
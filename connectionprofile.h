@@ -0,0 +1,41 @@
+#ifndef CONNECTIONPROFILE_H
+#define CONNECTIONPROFILE_H
+
+#include <QString>
+#include <QStringList>
+
+class QSettings;
+
+// 数据库连接配置：数据库文件位置以及打开连接后执行的 SQLite PRAGMA
+// 可从 QSettings（注册表或 ini 文件）的 database 分组读取，先取预设再逐项覆盖
+class ConnectionProfile
+{
+public:
+    enum class Preset {
+        Interactive,        // 桌面交互：WAL + NORMAL，兼顾响应速度和可靠性
+        BulkImport,         // 批量导入：暂时关闭同步写盘，加大缓存
+        ReadOnlyReporting   // 只读报表：只读打开，加大缓存和内存映射
+    };
+
+    static ConnectionProfile preset(Preset preset, const QString &databasePath = defaultDatabasePath());
+    static bool presetFromName(const QString &name, Preset *preset);
+    static QString presetName(Preset preset);
+
+    // 读取 database/preset 选定预设，再用 database/ 下的其余键覆盖
+    static ConnectionProfile fromSettings(const QSettings &settings);
+    static QString defaultDatabasePath();
+
+    // 打开连接后依次执行的 PRAGMA 语句；取值不合法的项会被跳过
+    QStringList pragmas() const;
+
+    QString databasePath;
+    QString journalMode = "WAL";      // DELETE / TRUNCATE / PERSIST / MEMORY / WAL / OFF
+    QString synchronous = "NORMAL";   // OFF / NORMAL / FULL / EXTRA
+    int cacheSizeKiB = 64 * 1024;     // 页缓存大小
+    qint64 mmapSizeBytes = 256LL * 1024 * 1024;
+    QString tempStore = "MEMORY";     // DEFAULT / FILE / MEMORY
+    int busyTimeoutMs = 5000;         // 其他连接持有写锁时的等待时间
+    bool readOnly = false;
+};
+
+#endif // CONNECTIONPROFILE_H
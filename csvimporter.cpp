@@ -0,0 +1,289 @@
+#include "csvimporter.h"
+#include "database.h"
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+
+void CsvImporter::PendingBatch::clear()
+{
+    lines.clear();
+    stuIds.clear();
+    names.clear();
+    classes.clear();
+    for (QVector<double> &column : scores)
+        column.clear();
+}
+
+CsvImporter::CsvImporter(Database *database)
+    : database(database)
+{
+    for (int i = 0; i < ColumnCount; i++)
+        columnIndex[i] = i;
+}
+
+CsvImporter::Result CsvImporter::importFile(const QString &filePath, const ProgressCallback &progress)
+{
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        result.fatalError = QString("无法打开文件：%1").arg(file.errorString());
+        return result;
+    }
+
+    QTextStream in(&file);
+    in.setEncoding(QStringConverter::Utf8);
+
+    // 学号查重只在开始时读一次数据库
+    knownStuIds = database->getAllStudentIds();
+    pending.clear();
+
+    Progress state;
+    state.totalBytes = file.size();
+
+    QStringList fields;
+    qint64 lineNumber = 0;
+    bool firstRecord = true;
+
+    while (true) {
+        qint64 recordLine = lineNumber + 1;
+        if (!readRecord(in, fields, lineNumber))
+            break;
+
+        // 第一条记录如果是表头，按表头确定列的位置
+        if (firstRecord) {
+            firstRecord = false;
+            if (mapHeader(fields))
+                continue;
+        }
+
+        if (fields.size() == 1 && fields.first().trimmed().isEmpty())
+            continue;   // 空行
+
+        result.rowsRead++;
+        addRow(fields, recordLine);
+
+        if (pending.size() >= BatchSize) {
+            if (!flushBatch(result))
+                break;
+
+            state.bytesRead = file.pos();
+            state.rowsRead = result.rowsRead;
+            state.rowsImported = result.rowsImported;
+            if (progress && !progress(state)) {
+                result.cancelled = true;
+                break;
+            }
+        }
+    }
+
+    if (!result.cancelled && result.fatalError.isEmpty()) {
+        flushBatch(result);
+    }
+
+    state.bytesRead = state.totalBytes;
+    state.rowsRead = result.rowsRead;
+    state.rowsImported = result.rowsImported;
+    if (progress)
+        progress(state);
+
+    knownStuIds.clear();
+    pending.clear();
+    result.elapsedMs = timer.elapsed();
+    qDebug() << "CSV 导入完成：读取" << result.rowsRead << "行，导入" << result.rowsImported
+             << "行，耗时" << result.elapsedMs << "ms";
+    return result;
+}
+
+bool CsvImporter::readRecord(QTextStream &in, QStringList &fields, qint64 &lineNumber)
+{
+    fields.clear();
+
+    QString line;
+    if (!in.readLineInto(&line))
+        return false;
+    lineNumber++;
+
+    QString field;
+    bool inQuotes = false;
+    int i = 0;
+
+    while (true) {
+        if (i >= line.size()) {
+            if (inQuotes) {
+                // 引号内的换行属于字段内容，继续读下一行
+                if (!in.readLineInto(&line))
+                    break;
+                lineNumber++;
+                field += QLatin1Char('\n');
+                i = 0;
+                continue;
+            }
+            break;
+        }
+
+        const QChar c = line.at(i++);
+        if (inQuotes) {
+            if (c == QLatin1Char('"')) {
+                if (i < line.size() && line.at(i) == QLatin1Char('"')) {
+                    field += c;   // 两个连续引号表示一个引号
+                    i++;
+                } else {
+                    inQuotes = false;
+                }
+            } else {
+                field += c;
+            }
+        } else if (c == QLatin1Char('"')) {
+            inQuotes = true;
+        } else if (c == QLatin1Char(',')) {
+            fields.append(field);
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+
+    fields.append(field);
+    return true;
+}
+
+bool CsvImporter::mapHeader(const QStringList &fields)
+{
+    // 前三列固定，成绩列的英文名和中文名来自科目目录
+    static const SubjectInfo fixedNames[FirstScore] = {
+        {"stu_id", "学号"}, {"name", "姓名"}, {"class", "班级"}
+    };
+
+    int mapped[ColumnCount];
+    int found = 0;
+    for (int column = 0; column < ColumnCount; column++) {
+        const SubjectInfo &names = column < FirstScore ? fixedNames[column] : SubjectCatalogue[column - FirstScore];
+        mapped[column] = -1;
+        for (int i = 0; i < fields.size(); i++) {
+            const QString name = fields.at(i).trimmed();
+            if (name.compare(QLatin1String(names.column), Qt::CaseInsensitive) == 0
+                || name == QString::fromUtf8(names.name)) {
+                mapped[column] = i;
+                found++;
+                break;
+            }
+        }
+    }
+
+    if (found == 0)
+        return false;   // 不是表头，按默认顺序解析
+
+    for (int column = 0; column < ColumnCount; column++)
+        columnIndex[column] = mapped[column];
+    return true;
+}
+
+void CsvImporter::addRow(const QStringList &fields, qint64 line)
+{
+    auto field = [&fields, this](int column) {
+        const int index = columnIndex[column];
+        return (index >= 0 && index < fields.size()) ? fields.at(index).trimmed() : QString();
+    };
+
+    pending.lines.append(line);
+    pending.stuIds.append(field(StuId));
+    pending.names.append(field(Name));
+    pending.classes.append(field(ClassName));
+
+    for (int s = 0; s < SubjectCount; s++) {
+        const QString text = field(FirstScore + s);
+        bool ok = true;
+        double value = text.isEmpty() ? NAN : text.toDouble(&ok);
+        pending.scores[s].append(ok ? value : -1.0);
+    }
+}
+
+bool CsvImporter::flushBatch(Result &result)
+{
+    const int count = pending.size();
+    if (count == 0)
+        return true;
+
+    // ================ 整列校验 ================
+    // 成绩按列连续存放，逐列扫描得到每行的错误标记，每个科目占一位
+    static_assert(SubjectCount <= 32, "错误标记按位存放，科目数不能超过 32");
+    QVector<quint32> badScore(count, 0);
+    for (int s = 0; s < SubjectCount; s++) {
+        const double *scores = pending.scores[s].constData();
+        quint32 *bad = badScore.data();
+        const quint32 bit = 1u << s;
+        for (int i = 0; i < count; i++) {
+            const double v = scores[i];
+            // NaN 表示未填写，不算错误
+            bad[i] |= (v < 0.0 || v > FullScore) ? bit : 0;
+        }
+    }
+
+    StudentBatch batch;
+    QVector<qint64> batchLines;
+    batchLines.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        const qint64 line = pending.lines.at(i);
+
+        if (pending.stuIds.at(i).isEmpty()) {
+            addError(result, line, "学号不能为空");
+            continue;
+        }
+        if (pending.names.at(i).isEmpty()) {
+            addError(result, line, "姓名不能为空");
+            continue;
+        }
+        if (pending.classes.at(i).isEmpty()) {
+            addError(result, line, "班级不能为空");
+            continue;
+        }
+        if (badScore.at(i)) {
+            for (int s = 0; s < SubjectCount; s++) {
+                if (badScore.at(i) & (1u << s)) {
+                    addError(result, line, QString("%1成绩必须是0-%2的数字").arg(subjectName(Subject(s))).arg(FullScore));
+                    break;
+                }
+            }
+            continue;
+        }
+        if (knownStuIds.contains(pending.stuIds.at(i))) {
+            addError(result, line, QString("学号 %1 已存在").arg(pending.stuIds.at(i)));
+            continue;
+        }
+        knownStuIds.insert(pending.stuIds.at(i));
+
+        batch.stuIds.append(pending.stuIds.at(i));
+        batch.names.append(pending.names.at(i));
+        batch.classes.append(pending.classes.at(i));
+        for (int s = 0; s < SubjectCount; s++) {
+            const double v = pending.scores[s].at(i);
+            batch.scores[s].append(std::isnan(v) ? QVariant() : QVariant(v));
+        }
+        batchLines.append(line);
+    }
+    pending.clear();
+
+    // ================ 批量写入 ================
+    QVector<QPair<int, QString>> rowErrors;
+    if (!database->insertStudentBatch(batch, &rowErrors)) {
+        result.fatalError = "写入数据库失败，导入已中止";
+        return false;
+    }
+
+    for (const auto &error : rowErrors)
+        addError(result, batchLines.at(error.first), error.second);
+    result.rowsImported += batch.size() - rowErrors.size();
+    return true;
+}
+
+void CsvImporter::addError(Result &result, qint64 line, const QString &message)
+{
+    if (result.errors.size() < MaxReportedErrors)
+        result.errors.append(RowError{line, message});
+}
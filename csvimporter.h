@@ -0,0 +1,83 @@
+#ifndef CSVIMPORTER_H
+#define CSVIMPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSet>
+#include <functional>
+#include "studenttable.h"
+
+class Database;
+class QTextStream;
+
+// CSV 批量导入
+// 逐条流式解析文件，每攒够一批先整列校验，再用一条预编译语句在一个事务内批量写入
+// 支持的表头：学号/stu_id、姓名/name、班级/class，之后是科目目录中各科的中文名或列名（如 语文/chinese），
+// 没有表头时按上述顺序解析
+class CsvImporter
+{
+public:
+    struct RowError
+    {
+        qint64 line;      // 文件中的行号（从 1 开始）
+        QString message;
+    };
+
+    struct Progress
+    {
+        qint64 bytesRead = 0;
+        qint64 totalBytes = 0;
+        qint64 rowsRead = 0;
+        qint64 rowsImported = 0;
+    };
+
+    struct Result
+    {
+        qint64 rowsRead = 0;
+        qint64 rowsImported = 0;
+        QVector<RowError> errors;
+        QString fatalError;     // 无法继续导入时的原因
+        bool cancelled = false;
+        qint64 elapsedMs = 0;
+    };
+
+    // 返回 false 表示取消导入
+    using ProgressCallback = std::function<bool(const Progress &progress)>;
+
+    explicit CsvImporter(Database *database);
+
+    Result importFile(const QString &filePath, const ProgressCallback &progress = ProgressCallback());
+
+    static constexpr int BatchSize = 5000;
+    static constexpr int MaxReportedErrors = 1000;   // 错误太多时只保留前面这些
+
+private:
+    enum Column { StuId = 0, Name, ClassName, FirstScore, ColumnCount = FirstScore + SubjectCount };
+
+    // 当前批次的原始数据，按列存放便于整列校验
+    struct PendingBatch
+    {
+        QVector<qint64> lines;
+        QVector<QString> stuIds;
+        QVector<QString> names;
+        QVector<QString> classes;
+        QVector<double> scores[SubjectCount];   // NaN 表示未填写，无法解析的记为 -1
+
+        int size() const { return lines.size(); }
+        void clear();
+    };
+
+    static bool readRecord(QTextStream &in, QStringList &fields, qint64 &lineNumber);
+    bool mapHeader(const QStringList &fields);
+    void addRow(const QStringList &fields, qint64 line);
+    bool flushBatch(Result &result);
+    void addError(Result &result, qint64 line, const QString &message);
+
+    Database *database;
+    int columnIndex[ColumnCount];
+    QSet<QString> knownStuIds;   // 数据库中已有的和本次已读到的学号
+    PendingBatch pending;
+};
+
+#endif // CSVIMPORTER_H
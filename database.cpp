@@ -1,38 +1,207 @@
 #include "database.h"
+#include "querytracer.h"
 #include <QDebug>
-#include <QStandardPaths>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
 #include <QDir>
+#include <iterator>
+
+// 科目目录中的各科成绩列，每列前加上 prefix（如表别名 "s."）
+static QString scoreColumns(const QString &prefix = QString())
+{
+    QStringList columns;
+    for (const SubjectInfo &subject : SubjectCatalogue)
+        columns << prefix + QLatin1String(subject.column);
+    return columns.join(", ");
+}
+
+// 查询学生时使用的列，顺序与 Database::StudentColumn 一一对应
+// 与全文索引连接查询时列名与 students_fts 重名，需要加表别名
+static QString studentColumns(const QString &prefix = QString())
+{
+    return QString("%1id, %1stu_id, %1name, %1class, %2, %1total, %1average").arg(prefix, scoreColumns(prefix));
+}
+
+// n 个以逗号分隔的参数占位符
+static QString placeholders(int n)
+{
+    QStringList marks;
+    for (int i = 0; i < n; i++)
+        marks << "?";
+    return marks.join(", ");
+}
+
+// 可供排序的列名，与 Database::StudentColumn 对应
+static QString sortColumnName(int column)
+{
+    switch (column) {
+    case Database::ColStuId: return "stu_id";
+    case Database::ColName: return "name";
+    case Database::ColClass: return "class";
+    case Database::ColTotal: return "total";
+    case Database::ColAverage: return "average";
+    default: return QLatin1String(SubjectCatalogue[column - Database::ColFirstScore].column);
+    }
+}
+
+// 按某一列排序时的排序表达式，与该列的排序索引一致
+// 成绩和平均分未录入时可能是 NULL 也可能是 -1，统一成 -1 排在最前，与内存中的排序一致
+static QString sortExpression(int column)
+{
+    if (column == Database::ColAverage || (column >= Database::ColFirstScore && column < Database::ColTotal))
+        return QString("IFNULL(%1, -1)").arg(sortColumnName(column));
+    return sortColumnName(column);
+}
+
+// 排序后位于 id 这一行之后（op 为 ">"）或之前（op 为 "<"）的条件，需要绑定三次 id
+// 不用行值比较：表达式索引只有写成对单个表达式的范围条件时才能直接定位
+static QString sortedKeyCondition(const QString &expression, const char *op)
+{
+    const QString key = QString("(SELECT %1 FROM students WHERE id = ?)").arg(expression);
+    return QString("%1 %2= %3 AND (%1 %2 %3 OR id %2 ?)").arg(expression, QLatin1String(op), key);
+}
+
+// 三元组分词至少需要 3 个字符
+static const int MinIndexedKeywordLength = 3;
 
 Database::Database(QObject *parent) : QObject(parent)
 {
 }
 
+void StudentBatch::clear()
+{
+    stuIds.clear();
+    names.clear();
+    classes.clear();
+    for (QVariantList &column : scores)
+        column.clear();
+}
+
+void StudentEdit::merge(const StudentEdit &newer)
+{
+    if (newer.fields & NameField)
+        name = newer.name;
+    if (newer.fields & ClassField)
+        className = newer.className;
+    for (int s = 0; s < SubjectCount; s++) {
+        if (newer.hasScore(s))
+            scores[s] = newer.scores[s];
+    }
+    fields |= newer.fields;
+}
+
+void StudentEdit::applyTo(QString *studentName, QString *studentClass, float *studentScores) const
+{
+    if (fields & NameField)
+        *studentName = name;
+    if (fields & ClassField)
+        *studentClass = className;
+    for (int s = 0; s < SubjectCount; s++) {
+        if (hasScore(s))
+            studentScores[s] = scores[s];
+    }
+}
+
 Database::~Database()
 {
+    if (cacheStats.hits + cacheStats.misses > 0) {
+        qDebug() << "预编译语句缓存：" << statementCache.size() << "条语句，命中率"
+                 << QString::number(cacheStats.hitRate() * 100, 'f', 1) + "%";
+    }
+    statementCache.clear();
+
     if (db.isOpen()) {
         db.close();
     }
+
+    // 先释放句柄再移除连接，否则 Qt 会提示连接仍在使用
+    QString connectionName = db.connectionName();
+    db = QSqlDatabase();
+    if (!connectionName.isEmpty()) {
+        QSqlDatabase::removeDatabase(connectionName);
+    }
 }
 
 
 bool Database::openDatabase()
 {
+    QSettings settings;
+    return openDatabase(ConnectionProfile::fromSettings(settings),
+                        QLatin1String(QSqlDatabase::defaultConnection));
+}
+
+bool Database::openDatabase(const ConnectionProfile &connectionProfile, const QString &connectionName)
+{
+    profile = connectionProfile;
+    if (!openConnection(connectionName))
+        return false;
+
+    // 新建或升级表结构，再按科目目录补上缺少的成绩列
+    if (!migrate() || !syncSubjectColumns())
+        return false;
+
+    if (profile.readOnly) {
+        // 只读连接不建索引和触发器，已有的就直接使用
+        searchIndexAvailable = tableExists("students_fts");
+        classStatsAvailable = tableExists("class_stats") && tableExists("class_score_counts");
+        changeLogAvailable = tableExists("student_changes");
+    } else {
+        // 全文索引只影响搜索速度，建不起来时仍可使用
+        searchIndexAvailable = createSearchIndex();
+
+        // 统计表建不起来时退回到直接扫描 students
+        classStatsAvailable = createClassStats();
+
+        // 变更记录建不起来时，外部修改只能整表重新装载
+        changeLogAvailable = createChangeLog();
+    }
+
+#ifdef QT_DEBUG
+    for (const QString &problem : checkQueryPlans())
+        qDebug() << "查询计划需要临时排序：" << problem;
+#endif
+
+    return true;
+}
+
+bool Database::upgradeSchema(const QString &databasePath, const QString &connectionName)
+{
+    // 可写连接会新建不存在的文件，这里只升级已有的数据库
+    if (!QFile::exists(databasePath)) {
+        qDebug() << "错误：数据库文件不存在！路径：" << databasePath;
+        return false;
+    }
 
-    QString dbPath = "D:/StudentData/student_grade.db";
+    Database database;
+    database.profile = ConnectionProfile::preset(ConnectionProfile::Preset::Interactive, databasePath);
+    database.profile.journalMode.clear();   // 保持文件原有的日志模式
+    return database.openConnection(connectionName) && database.migrate() && database.syncSubjectColumns();
+}
 
+// 按 profile 打开连接并设置 PRAGMA，不检查表结构
+bool Database::openConnection(const QString &connectionName)
+{
+    const QString &dbPath = profile.databasePath;
     qDebug() << "数据库路径：" << dbPath;
 
     // ================ 验证文件是否存在 ================
-    QFile file(dbPath);
-    if (!file.exists()) {
-        qDebug() << "错误：数据库文件不存在！路径：" << dbPath;
-        qDebug() << "请先在Navicat中创建数据库文件";
+    // 只读连接要求文件已存在；否则创建所在目录，由 SQLite 新建文件，再由迁移建表
+    if (profile.readOnly) {
+        if (!QFile::exists(dbPath)) {
+            qDebug() << "错误：数据库文件不存在！路径：" << dbPath;
+            return false;
+        }
+    } else if (!QDir().mkpath(QFileInfo(dbPath).absolutePath())) {
+        qDebug() << "错误：无法创建数据库目录：" << QFileInfo(dbPath).absolutePath();
         return false;
     }
 
     // ================ 连接数据库 ================
-    db = QSqlDatabase::addDatabase("QSQLITE");
+    db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
     db.setDatabaseName(dbPath);
+    if (profile.readOnly)
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
 
     if (!db.open()) {
         qDebug() << "无法打开数据库：" << db.lastError().text();
@@ -41,27 +210,43 @@ bool Database::openDatabase()
 
     qDebug() << "数据库连接成功！";
 
-    // 检查表是否存在
-    QSqlQuery query;
-    if (!query.exec("SELECT name FROM sqlite_master WHERE type='table' AND name='students'")) {
-        qDebug() << "检查表失败：" << query.lastError().text();
-        return false;
-    }
+    return applyPragmas(profile);
+}
+
+bool Database::applyPragmas(const ConnectionProfile &settings)
+{
+    QSqlQuery query(db);
+    for (const QString &pragma : settings.pragmas()) {
+        if (!query.exec(pragma)) {
+            qDebug() << "设置失败：" << pragma << query.lastError().text();
+            return false;
+        }
 
-    if (!query.next()) {
-        qDebug() << "表'students'不存在，正在创建...";
-        return createTables();  // 如果表不存在，创建表
+        // journal_mode 返回实际生效的模式，例如内存数据库无法使用 WAL
+        if (pragma.startsWith("PRAGMA journal_mode") && query.next()) {
+            const QString mode = query.value(0).toString();
+            if (mode.compare(settings.journalMode, Qt::CaseInsensitive) != 0)
+                qDebug() << "日志模式为" << mode << "，而不是" << settings.journalMode;
+        }
+        query.finish();
     }
 
-    qDebug() << "表已存在，直接使用";
     return true;
 }
 
+bool Database::tableExists(const QString &name)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name=?");
+    query.addBindValue(name);
+    return query.exec() && query.next();
+}
+
 bool Database::createTables()
 {
-    QSqlQuery query;
+    QSqlQuery query(db);
 
-    // 创建学生表
+    // 版本 1 的学生表，保持原样；版本 2 起由 rebuildStudentsTable 按科目目录重建
     QString createTableSQL = "CREATE TABLE IF NOT EXISTS students ("
                              "id INTEGER PRIMARY KEY AUTOINCREMENT,"
                              "stu_id TEXT UNIQUE NOT NULL,"
@@ -93,241 +278,1975 @@ bool Database::createTables()
     return true;
 }
 
-bool Database::addStudent(const QString &stuId, const QString &name, const QString &className,
-                          double chinese, double math, double english)
+// ================ 表结构版本 ================
+// 表结构版本保存在 PRAGMA user_version 中，打开数据库时按顺序执行尚未执行的迁移
+// 每一步迁移和版本号的更新放在同一个事务里，中途失败时数据库保持原样
+
+int Database::schemaVersion()
 {
-    QSqlQuery query;
-    query.prepare("INSERT INTO students (stu_id, name, class, chinese, math, english) "
-                  "VALUES (?, ?, ?, ?, ?, ?)");
-    query.addBindValue(stuId);
-    query.addBindValue(name);
-    query.addBindValue(className);
-    query.addBindValue(chinese >= 0 ? chinese : QVariant());
-    query.addBindValue(math >= 0 ? math : QVariant());
-    query.addBindValue(english >= 0 ? english : QVariant());
+    QSqlQuery query(db);
+    if (query.exec("PRAGMA user_version") && query.next())
+        return query.value(0).toInt();
+    return -1;
+}
+
+bool Database::migrate()
+{
+    struct Migration
+    {
+        int version;
+        const char *description;
+        bool (Database::*apply)();
+    };
+    static const Migration migrations[] = {
+        {1, "创建学生表", &Database::createTables},
+        {2, "总分、平均分改为存储列，建立覆盖索引", &Database::migrateStoredColumns},
+        {3, "建立考试和历次成绩表", &Database::migrateExamHistory},
+        {4, "建立学生变更记录表", &Database::migrateChangeLog},
+    };
+    const int latest = migrations[std::size(migrations) - 1].version;
+
+    const int version = schemaVersion();
+    if (version < 0) {
+        qDebug() << "读取数据库版本失败：" << db.lastError().text();
+        return false;
+    }
+    if (version > latest) {
+        qDebug() << "数据库版本" << version << "高于程序支持的版本" << latest << "，请升级程序";
+        return false;
+    }
+    if (version < latest && profile.readOnly) {
+        qDebug() << "数据库版本" << version << "需要升级，只读连接无法升级";
+        return false;
+    }
 
-    return query.exec();
+    QSqlQuery query(db);
+    for (const Migration &migration : migrations) {
+        if (migration.version <= version)
+            continue;
+
+        qDebug() << "升级数据库到版本" << migration.version << "：" << migration.description;
+        if (!db.transaction()) {
+            qDebug() << "开启事务失败：" << db.lastError().text();
+            return false;
+        }
+        // PRAGMA 不能绑定参数，版本号只来自上面的表
+        if (!(this->*migration.apply)()
+            || !query.exec(QString("PRAGMA user_version = %1").arg(migration.version))
+            || !db.commit()) {
+            qDebug() << "升级数据库失败：" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+
+    return true;
 }
 
-bool Database::updateStudent(const QString &stuId, const QString &name, const QString &className,
-                             double chinese, double math, double english)
+bool Database::migrateStoredColumns()
 {
-    QSqlQuery query;
-    query.prepare("UPDATE students SET name = ?, class = ?, chinese = ?, math = ?, english = ? "
-                  "WHERE stu_id = ?");
-    query.addBindValue(name);
-    query.addBindValue(className);
-    query.addBindValue(chinese >= 0 ? chinese : QVariant());
-    query.addBindValue(math >= 0 ? math : QVariant());
-    query.addBindValue(english >= 0 ? english : QVariant());
-    query.addBindValue(stuId);
+    // 原来的总分、平均分是虚拟列，每次读取、排序、求平均都要重新计算
+    // SQLite 不能把已有的列改成存储列，只能新建表复制数据后替换
+    return rebuildStudentsTable();
+}
 
-    return query.exec();
+QStringList Database::studentScoreColumns()
+{
+    // table_info 不列出生成列，去掉固定的几列后剩下的就是成绩列
+    static const QStringList fixedColumns = {"id", "stu_id", "name", "class"};
+    QStringList columns;
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA table_info(students)"))
+        return columns;
+    while (query.next()) {
+        const QString column = query.value(1).toString();
+        if (!fixedColumns.contains(column))
+            columns << column;
+    }
+    return columns;
 }
 
-bool Database::deleteStudent(const QString &stuId)
+bool Database::rebuildStudentsTable()
 {
-    QSqlQuery query;
-    query.prepare("DELETE FROM students WHERE stu_id = ?");
-    query.addBindValue(stuId);
+    // 按科目目录生成成绩列、总分和平均分（平均分 = 总分 / 已录入科目数）
+    QStringList scoreDefinitions, validScores, enteredScores, copiedColumns = {"id", "stu_id", "name", "class"};
+    const QStringList existing = studentScoreColumns();
+    for (const SubjectInfo &subject : SubjectCatalogue) {
+        const QString column = QLatin1String(subject.column);
+        scoreDefinitions << column + " REAL DEFAULT -1";
+        validScores << QString("CASE WHEN %1 >= 0 THEN %1 ELSE 0 END").arg(column);
+        enteredScores << QString("CASE WHEN %1 >= 0 THEN 1 ELSE 0 END").arg(column);
+        if (existing.contains(column))
+            copiedColumns << column;
+    }
+    const QString total = validScores.join(" + ");
+
+    // 删掉旧表时 sqlite_sequence 中它的记录随之删除，新表的记录只到现有的最大 id
+    // 先记下原来用到的最大 id，重命名后写回，删除过的学生的 id 不会被新学生重新使用
+    // （历次成绩、变更记录都按 id 关联，重新使用会让新学生继承已删除学生的记录）
+    QSqlQuery query(db);
+    qint64 highWater = 0;
+    if (query.exec("SELECT seq FROM sqlite_sequence WHERE name = 'students'") && query.next())
+        highWater = query.value(0).toLongLong();
+    query.finish();
+
+    // id 原样复制，全文索引仍然有效；只复制新旧两表都有的成绩列，新增的科目取默认值
+    // 旧表上的触发器随旧表删除，打开数据库时由 createSearchIndex / createClassStats / createChangeLog 重新建立
+    const QStringList statements = {
+        QString("CREATE TABLE students_new ("
+                "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                "stu_id TEXT UNIQUE NOT NULL,"
+                "name TEXT NOT NULL,"
+                "class TEXT NOT NULL,"
+                "%1,"
+                "total REAL GENERATED ALWAYS AS (%2) STORED,"
+                "average REAL GENERATED ALWAYS AS ((%2) * 1.0 / NULLIF(%3, 0)) STORED"
+                ")").arg(scoreDefinitions.join(", "), total, enteredScores.join(" + ")),
+        QString("INSERT INTO students_new (%1) SELECT %1 FROM students").arg(copiedColumns.join(", ")),
+        "DROP TABLE students",
+        "ALTER TABLE students_new RENAME TO students",
+        "DELETE FROM sqlite_sequence WHERE name = 'students'",
+        QString("INSERT INTO sqlite_sequence (name, seq) "
+                "SELECT 'students', MAX(%1, IFNULL((SELECT MAX(id) FROM students), 0))").arg(highWater),
+        // 默认排序、分页、按班级统计都按 (class, stu_id) 顺序读取，索引包含全部查询列，不必回表
+        QString("CREATE INDEX idx_students_class_stu_id ON students("
+                "class, stu_id, id, name, %1, total, average)").arg(scoreColumns())
+    };
 
-    return query.exec();
+    for (const QString &sql : statements) {
+        if (!query.exec(sql)) {
+            qDebug() << "重建学生表失败：" << query.lastError().text();
+            return false;
+        }
+    }
+
+    // 确认 id 的最大值没有倒退，否则由调用方回滚整个事务
+    if (!query.exec("SELECT seq FROM sqlite_sequence WHERE name = 'students'") || !query.next()
+        || query.value(0).toLongLong() < highWater) {
+        qDebug() << "重建学生表后 id 序号倒退，放弃重建";
+        return false;
+    }
+    return true;
 }
 
-QVector<QMap<QString, QVariant>> Database::getAllStudents()
+bool Database::syncSubjectColumns()
 {
-    QVector<QMap<QString, QVariant>> students;
-    QSqlQuery query("SELECT * FROM students ORDER BY class, stu_id");
+    const QStringList existing = studentScoreColumns();
+    QStringList missing;
+    for (const SubjectInfo &subject : SubjectCatalogue) {
+        if (!existing.contains(QLatin1String(subject.column)))
+            missing << QLatin1String(subject.column);
+    }
+    if (missing.isEmpty())
+        return true;
 
-    while (query.next()) {
-        QMap<QString, QVariant> student;
+    if (profile.readOnly) {
+        qDebug() << "学生表缺少成绩列" << missing << "，只读连接无法补上";
+        return false;
+    }
 
-        // Qt 6的正确写法：通过字段名获取数据
-        student["id"] = query.value("id");
-        student["stu_id"] = query.value("stu_id");
-        student["name"] = query.value("name");
-        student["class"] = query.value("class");
-        student["chinese"] = query.value("chinese");
-        student["math"] = query.value("math");
-        student["english"] = query.value("english");
-        student["total"] = query.value("total");
-        student["average"] = query.value("average");
+    qDebug() << "科目目录新增" << missing << "，重建学生表";
+    if (!db.transaction()) {
+        qDebug() << "开启事务失败：" << db.lastError().text();
+        return false;
+    }
 
-        students.append(student);
+    // 科目只在目录末尾追加，已有科目的编号不变；考试汇总中总分的编号等于科目数，随之后移
+    // 班级统计表缺少新科目的行，删掉后由 createClassStats 重新汇总
+    // 考试表由迁移 3 建立，迁移失败或被删掉时没有需要后移的编号
+    QSqlQuery query(db);
+    const bool hasExamStats = tableExists("exam_class_stats");
+    if (!rebuildStudentsTable()
+        || (hasExamStats && !query.exec(QString("UPDATE exam_class_stats SET subject = %1 WHERE subject = %2")
+                                            .arg(SubjectCount).arg(existing.size())))
+        || !query.exec("DROP TABLE IF EXISTS class_stats")
+        || !query.exec("DROP TABLE IF EXISTS class_score_counts")
+        || !db.commit()) {
+        qDebug() << "补充成绩列失败：" << query.lastError().text();
+        db.rollback();
+        return false;
     }
 
-    return students;
+    return true;
 }
 
-QVector<QMap<QString, QVariant>> Database::searchStudents(const QString &keyword)
+bool Database::migrateExamHistory()
 {
-    QVector<QMap<QString, QVariant>> students;
-    QSqlQuery query;
-    query.prepare("SELECT * FROM students WHERE stu_id LIKE ? OR name LIKE ? OR class LIKE ? "
-                  "ORDER BY class, stu_id");
-    QString pattern = "%" + keyword + "%";
-    query.addBindValue(pattern);
-    query.addBindValue(pattern);
-    query.addBindValue(pattern);
+    // scores 以 (exam_id, student_id, subject) 为主键，不要 rowid，每个成绩只存一份
+    // 按学生查历次成绩走 idx_scores_student，索引包含成绩列，不必回表
+    static const char *const statements[] = {
+        "CREATE TABLE exams ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT NOT NULL,"
+        "exam_date TEXT NOT NULL)",   // yyyy-MM-dd
+        "CREATE INDEX idx_exams_date ON exams(exam_date, id)",
+        "CREATE TABLE scores ("
+        "exam_id INTEGER NOT NULL,"
+        "student_id INTEGER NOT NULL,"
+        "subject INTEGER NOT NULL,"
+        "score REAL NOT NULL,"
+        "PRIMARY KEY (exam_id, student_id, subject)) WITHOUT ROWID",
+        "CREATE INDEX idx_scores_student ON scores(student_id, exam_id, subject, score)",
+        "CREATE TABLE exam_class_stats ("
+        "exam_id INTEGER NOT NULL,"
+        "class TEXT NOT NULL,"
+        "subject INTEGER NOT NULL,"
+        "students INTEGER NOT NULL,"
+        "score_sum REAL NOT NULL,"
+        "PRIMARY KEY (exam_id, class, subject)) WITHOUT ROWID"
+    };
 
-    if (query.exec()) {
-        while (query.next()) {
-            QMap<QString, QVariant> student;
-            student["id"] = query.value("id");
-            student["stu_id"] = query.value("stu_id");
-            student["name"] = query.value("name");
-            student["class"] = query.value("class");
-            student["chinese"] = query.value("chinese");
-            student["math"] = query.value("math");
-            student["english"] = query.value("english");
-            student["total"] = query.value("total");
-            student["average"] = query.value("average");
-            students.append(student);
+    QSqlQuery query(db);
+    for (const char *sql : statements) {
+        if (!query.exec(sql)) {
+            qDebug() << "创建考试表失败：" << query.lastError().text();
+            return false;
         }
     }
 
-    return students;
+    // 已有的成绩记为第一次考试，升级后趋势从这里开始
+    if (!query.exec("SELECT 1 FROM students LIMIT 1")) {
+        qDebug() << "读取学生表失败：" << query.lastError().text();
+        return false;
+    }
+    if (!query.next())
+        return true;
+    query.finish();
+    query.prepare("INSERT INTO exams (name, exam_date) VALUES (?, ?)");
+    query.addBindValue("升级前成绩");
+    query.addBindValue(QDate::currentDate().toString(Qt::ISODate));
+    if (!query.exec()) {
+        qDebug() << "记录升级前成绩失败：" << query.lastError().text();
+        return false;
+    }
+    return insertExamScores(query.lastInsertId().toInt());
 }
 
-QVector<QMap<QString, QVariant>> Database::getSubjectStats(const QString &subject)
+bool Database::migrateChangeLog()
 {
-    QVector<QMap<QString, QVariant>> stats;
-    QSqlQuery query;
+    // 序号用 AUTOINCREMENT，清理过的序号不会重复使用，读取方据此判断记录是否连续
+    QSqlQuery query(db);
+    if (!query.exec("CREATE TABLE student_changes ("
+                    "seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+                    "student_id INTEGER NOT NULL)")) {
+        qDebug() << "创建变更记录表失败：" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
 
-    // 修正：简化查询，移除 WHERE %1 >= 0 条件
-    QString sql = QString("SELECT class, "
-                          "COUNT(*) as count, "
-                          "AVG(%1) as avg_score, "
-                          "MAX(%1) as max_score, "
-                          "MIN(%1) as min_score, "
-                          "SUM(CASE WHEN %1 >= 60 AND %1 >= 0 THEN 1 ELSE 0 END) * 100.0 / COUNT(*) as pass_rate "
-                          "FROM students GROUP BY class").arg(subject);
+QStringList Database::checkQueryPlans()
+{
+    // 程序中的主要查询，参数不影响查询计划，留空即可
+    const QString columns = studentColumns();
+    const QStringList queries = {
+        QString("SELECT %1 FROM students ORDER BY class, stu_id").arg(columns),
+        QString("SELECT %1 FROM students WHERE (class, stu_id) > (?, ?) ORDER BY class, stu_id LIMIT ? OFFSET ?")
+            .arg(columns),
+        QString("SELECT %1 FROM students WHERE stu_id LIKE ? OR name LIKE ? OR class LIKE ? ORDER BY class, stu_id")
+            .arg(columns),
+        QString("SELECT class, total, %1 FROM students ORDER BY class").arg(scoreColumns()),
+        "SELECT s.id FROM students_fts JOIN students AS s ON s.id = students_fts.rowid "
+        "WHERE students_fts MATCH ? ORDER BY students_fts.rank",
+        "SELECT DISTINCT class FROM students ORDER BY class",
+        "SELECT 1 FROM students WHERE stu_id = ? LIMIT 1",
+        "SELECT * FROM class_stats ORDER BY class, subject",
+        "SELECT class, subject, score, students FROM class_score_counts "
+        "WHERE class >= ? AND class <= ? ORDER BY class, subject, score",
+        "SELECT c.exam_id, c.class, c.score_sum / c.students, c.students "
+        "FROM exams AS e CROSS JOIN exam_class_stats AS c ON c.exam_id = e.id "
+        "WHERE c.subject = ? ORDER BY e.exam_date, e.id, c.class"
+    };
 
-    if (query.exec(sql)) {
+    QStringList problems;
+    QSqlQuery query(db);
+    for (const QString &sql : queries) {
+        if (!query.exec(QString("EXPLAIN QUERY PLAN %1").arg(sql)))
+            continue;   // 全文索引或统计表不可用
         while (query.next()) {
-            QMap<QString, QVariant> stat;
-            stat["class"] = query.value("class");
-            stat["count"] = query.value("count");
-            stat["avg_score"] = query.value("avg_score");
-            stat["max_score"] = query.value("max_score");
-            stat["min_score"] = query.value("min_score");
-            stat["pass_rate"] = query.value("pass_rate");
-            stats.append(stat);
+            // 第 4 列是计划说明，如 "USE TEMP B-TREE FOR ORDER BY"
+            const QString detail = query.value(3).toString();
+            if (detail.contains("TEMP B-TREE"))
+                problems << QString("%1 -- %2").arg(sql, detail);
         }
     }
 
-    return stats;
+    return problems;
 }
 
-QVector<QMap<QString, QVariant>> Database::getClassStats()
+bool Database::createSearchIndex()
 {
-    QVector<QMap<QString, QVariant>> stats;
-    QSqlQuery query;
+    QSqlQuery query(db);
 
-    QString sql = "SELECT class, "
-                  "COUNT(*) as total_students, "
-                  "AVG(CASE WHEN chinese >= 0 THEN chinese ELSE NULL END) as chinese_avg, "
-                  "AVG(CASE WHEN math >= 0 THEN math ELSE NULL END) as math_avg, "
-                  "AVG(CASE WHEN english >= 0 THEN english ELSE NULL END) as english_avg, "
-                  "AVG(total) as total_avg "
-                  "FROM students GROUP BY class ORDER BY total_avg DESC";
+    // 三元组分词可以匹配任意位置的子串，代替前后都带 % 的 LIKE 全表扫描
+    if (!tableExists("students_fts")) {
+        if (!query.exec("CREATE VIRTUAL TABLE students_fts USING fts5("
+                        "stu_id, name, class, "
+                        "content='students', content_rowid='id', tokenize='trigram')")) {
+            qDebug() << "创建全文索引失败，搜索将使用 LIKE：" << query.lastError().text();
+            return false;
+        }
 
-    if (query.exec(sql)) {
-        while (query.next()) {
-            QMap<QString, QVariant> stat;
-            stat["class"] = query.value("class");
-            stat["total_students"] = query.value("total_students");
-            stat["chinese_avg"] = query.value("chinese_avg");
-            stat["math_avg"] = query.value("math_avg");
-            stat["english_avg"] = query.value("english_avg");
-            stat["total_avg"] = query.value("total_avg");
-            stats.append(stat);
+        qDebug() << "正在建立全文索引...";
+        if (!query.exec("INSERT INTO students_fts(students_fts) VALUES('rebuild')")) {
+            qDebug() << "建立全文索引失败：" << query.lastError().text();
+            return false;
         }
     }
 
-    return stats;
+    // 用触发器让索引与 students 表保持同步
+    const char *const triggers[] = {
+        "CREATE TRIGGER IF NOT EXISTS students_fts_ai AFTER INSERT ON students BEGIN "
+        "  INSERT INTO students_fts(rowid, stu_id, name, class) "
+        "  VALUES (new.id, new.stu_id, new.name, new.class); "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS students_fts_ad AFTER DELETE ON students BEGIN "
+        "  INSERT INTO students_fts(students_fts, rowid, stu_id, name, class) "
+        "  VALUES ('delete', old.id, old.stu_id, old.name, old.class); "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS students_fts_au AFTER UPDATE OF stu_id, name, class ON students BEGIN "
+        "  INSERT INTO students_fts(students_fts, rowid, stu_id, name, class) "
+        "  VALUES ('delete', old.id, old.stu_id, old.name, old.class); "
+        "  INSERT INTO students_fts(rowid, stu_id, name, class) "
+        "  VALUES (new.id, new.stu_id, new.name, new.class); "
+        "END"
+    };
+
+    for (const char *sql : triggers) {
+        if (!query.exec(sql)) {
+            qDebug() << "创建全文索引触发器失败：" << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ================ 班级统计表 ================
+// class_stats 每个 (班级, 科目) 一行，保存人数、总和、平方和、最值和默认分数段人数，
+// 由 students 上的触发器增量维护，统计时只需读取 O(班级数) 行
+
+// 某一行（new 或 old）对 class_stats 的贡献；未录入的成绩视为 -1
+static QString scoreOf(const QString &row, Subject subject)
+{
+    return QString("IFNULL(%1.%2, -1)").arg(row, QString(subjectColumn(subject)));
+}
+
+static QString bucketCondition(const QString &score, const QVector<double> &edges, int bucket)
+{
+    const bool last = bucket == edges.size() - 2;
+    return QString("%1 >= %2 AND %1 %3 %4").arg(score).arg(edges.at(bucket))
+        .arg(last ? "<=" : "<").arg(edges.at(bucket + 1));
+}
+
+static QStringList classStatsBucketColumns()
+{
+    QStringList columns;
+    const int bucketCount = StatisticsSnapshot::defaultBucketEdges().size() - 1;
+    for (int i = 0; i < bucketCount; i++)
+        columns << QString("bucket%1").arg(i);
+    return columns;
+}
+
+// 把一行学生计入所属班级
+static QString classStatsAddRow(const QString &row, Subject subject)
+{
+    const QVector<double> edges = StatisticsSnapshot::defaultBucketEdges();
+    const QStringList bucketColumns = classStatsBucketColumns();
+    const QString score = scoreOf(row, subject);
+    const QString valid = QString("MAX(%1, 0)").arg(score);
+
+    QStringList values = {
+        QString("%1.class").arg(row), QString::number(int(subject)), "1", QString("%1.total").arg(row),
+        QString("%1 >= 0").arg(score), valid, QString("%1 * %1").arg(valid),
+        QString("CASE WHEN %1 >= 0 THEN %1 END").arg(score),
+        QString("CASE WHEN %1 >= 0 THEN %1 END").arg(score),
+        QString("%1 >= %2").arg(score).arg(StatisticsSnapshot::PassScore)
+    };
+    QStringList updates = {
+        "students = students + 1", "total_sum = total_sum + excluded.total_sum",
+        "score_count = score_count + excluded.score_count", "score_sum = score_sum + excluded.score_sum",
+        "score_sumsq = score_sumsq + excluded.score_sumsq",
+        // 标量 MIN/MAX 遇到 NULL 返回 NULL，用 COALESCE 取非空的一方
+        "score_min = COALESCE(MIN(score_min, excluded.score_min), score_min, excluded.score_min)",
+        "score_max = COALESCE(MAX(score_max, excluded.score_max), score_max, excluded.score_max)",
+        "pass_count = pass_count + excluded.pass_count"
+    };
+    for (int i = 0; i < bucketColumns.size(); i++) {
+        values << QString("(%1)").arg(bucketCondition(score, edges, i));
+        updates << QString("%1 = %1 + excluded.%1").arg(bucketColumns.at(i));
+    }
+
+    return QString("INSERT INTO class_stats (class, subject, students, total_sum, score_count, score_sum, "
+                   "score_sumsq, score_min, score_max, pass_count, %1) VALUES (%2) "
+                   "ON CONFLICT(class, subject) DO UPDATE SET %3;")
+        .arg(bucketColumns.join(", "), values.join(", "), updates.join(", "));
 }
 
-QVector<QMap<QString, QVariant>> Database::getScoreDistribution(const QString &subject)
+// 把一行学生从所属班级中扣除；去掉的恰好是最值时，只在该班级内重新求最值
+static QString classStatsRemoveRow(const QString &row, Subject subject)
 {
-    QVector<QMap<QString, QVariant>> distribution;
+    const QVector<double> edges = StatisticsSnapshot::defaultBucketEdges();
+    const QStringList bucketColumns = classStatsBucketColumns();
+    const QString column = subjectColumn(subject);
+    const QString score = scoreOf(row, subject);
+    const QString valid = QString("MAX(%1, 0)").arg(score);
+    const QString recompute = QString("(SELECT %1(CASE WHEN %2 >= 0 THEN %2 END) FROM students WHERE class = %3.class)");
 
-    // 定义分数段
-    QStringList ranges = {"0-59", "60-69", "70-79", "80-89", "90-100"};
+    QStringList updates = {
+        "students = students - 1", QString("total_sum = total_sum - %1.total").arg(row),
+        QString("score_count = score_count - (%1 >= 0)").arg(score),
+        QString("score_sum = score_sum - %1").arg(valid),
+        QString("score_sumsq = score_sumsq - %1 * %1").arg(valid),
+        QString("score_min = CASE WHEN %1 >= 0 AND %1 <= score_min THEN %2 ELSE score_min END")
+            .arg(score, recompute.arg(QStringLiteral("MIN"), column, row)),
+        QString("score_max = CASE WHEN %1 >= 0 AND %1 >= score_max THEN %2 ELSE score_max END")
+            .arg(score, recompute.arg(QStringLiteral("MAX"), column, row)),
+        QString("pass_count = pass_count - (%1 >= %2)").arg(score).arg(StatisticsSnapshot::PassScore)
+    };
+    for (int i = 0; i < bucketColumns.size(); i++)
+        updates << QString("%1 = %1 - (%2)").arg(bucketColumns.at(i), bucketCondition(score, edges, i));
 
-    for (const QString &range : ranges) {
-        QStringList parts = range.split("-");
-        int min = parts[0].toInt();
-        int max = parts[1].toInt();
+    return QString("UPDATE class_stats SET %1 WHERE class = %2.class AND subject = %3;")
+        .arg(updates.join(", "), row).arg(int(subject));
+}
+
+// 从 students 重新汇总出与 class_stats 同结构的结果
+static QString classStatsSelect()
+{
+    const QVector<double> edges = StatisticsSnapshot::defaultBucketEdges();
+    const QStringList bucketColumns = classStatsBucketColumns();
 
-        QSqlQuery query;
-        // 修正：移除 WHERE 条件中的 %1 >= 0
-        query.prepare(QString("SELECT COUNT(*) as count FROM students "
-                              "WHERE %1 >= ? AND %1 <= ?").arg(subject));
-        query.addBindValue(min);
-        query.addBindValue(max);
+    QStringList selects;
+    for (int s = 0; s < SubjectCount; s++) {
+        const QString column = subjectColumn(Subject(s));
+        const QString valid = QString("CASE WHEN %1 >= 0 THEN %1 END").arg(column);
 
-        if (query.exec() && query.next()) {
-            QMap<QString, QVariant> item;
-            item["range"] = range;
-            item["count"] = query.value("count");
-            distribution.append(item);
+        QStringList columns = {
+            "class", QString("%1 AS subject").arg(s), "COUNT(*) AS students", "TOTAL(total) AS total_sum",
+            QString("COUNT(%1) AS score_count").arg(valid), QString("TOTAL(%1) AS score_sum").arg(valid),
+            QString("TOTAL((%1) * (%1)) AS score_sumsq").arg(valid),
+            QString("MIN(%1) AS score_min").arg(valid), QString("MAX(%1) AS score_max").arg(valid),
+            QString("COUNT(CASE WHEN %1 >= %2 THEN 1 END) AS pass_count").arg(column).arg(StatisticsSnapshot::PassScore)
+        };
+        for (int i = 0; i < bucketColumns.size(); i++) {
+            columns << QString("COUNT(CASE WHEN %1 THEN 1 END) AS %2")
+                           .arg(bucketCondition(column, edges, i), bucketColumns.at(i));
         }
+        selects << QString("SELECT %1 FROM students GROUP BY class").arg(columns.join(", "));
     }
+    return selects.join(" UNION ALL ");
+}
 
-    return distribution;
+// ================ 分数计数表 ================
+// class_score_counts 记录每个 (班级, 科目, 分值) 的人数，与 class_stats 一起由触发器维护
+// 成绩的取值种类有限，表的大小只与班级数有关；中位数、四分位数、标准差都由它精确求出
+
+static QString scoreCountsAddRow(const QString &row, Subject subject)
+{
+    const QString column = QString("%1.%2").arg(row, QString(subjectColumn(subject)));
+    return QString("INSERT INTO class_score_counts (class, subject, score, students) "
+                   "SELECT %1.class, %2, %3, 1 WHERE %3 >= 0 "
+                   "ON CONFLICT(class, subject, score) DO UPDATE SET students = students + 1;")
+        .arg(row).arg(int(subject)).arg(column);
 }
 
-QVector<QMap<QString, QVariant>> Database::getTrendData()
+static QString scoreCountsRemoveRow(const QString &row, Subject subject)
 {
-    QVector<QMap<QString, QVariant>> trendData;
-    QSqlQuery query;
+    const QString column = QString("%1.%2").arg(row, QString(subjectColumn(subject)));
+    const QString key = QString("class = %1.class AND subject = %2 AND score = %3").arg(row).arg(int(subject)).arg(column);
+    return QString("UPDATE class_score_counts SET students = students - 1 WHERE %1; "
+                   "DELETE FROM class_score_counts WHERE %1 AND students <= 0;").arg(key);
+}
 
-    // 获取各班级平均分趋势
-    // 修正：移除 WHERE 条件
-    QString sql = "SELECT class, "
-                  "AVG(chinese) as chinese, "
-                  "AVG(math) as math, "
-                  "AVG(english) as english "
-                  "FROM students "
-                  "GROUP BY class "
-                  "ORDER BY class";
+// 从 students 重新计数，结果与 class_score_counts 同结构
+static QString scoreCountsSelect()
+{
+    QStringList selects;
+    for (int s = 0; s < SubjectCount; s++) {
+        const QString column = subjectColumn(Subject(s));
+        selects << QString("SELECT class, %1 AS subject, %2 AS score, COUNT(*) AS students FROM students "
+                           "WHERE %2 >= 0 GROUP BY class, %2").arg(s).arg(column);
+    }
+    return selects.join(" UNION ALL ");
+}
 
-    if (query.exec(sql)) {
-        while (query.next()) {
-            QMap<QString, QVariant> data;
-            data["class"] = query.value("class");
-            data["chinese"] = query.value("chinese");
-            data["math"] = query.value("math");
-            data["english"] = query.value("english");
-            trendData.append(data);
+bool Database::createClassStats()
+{
+    QSqlQuery query(db);
+
+    const bool exists = tableExists("class_stats");
+    const bool countsExist = tableExists("class_score_counts");
+
+    // 建表、填充和建触发器放在一个事务里，避免留下一张没有触发器维护的统计表
+    if (!db.transaction()) {
+        qDebug() << "开启事务失败：" << db.lastError().text();
+        return false;
+    }
+
+    QStringList statements;
+    if (!exists) {
+        QStringList bucketColumns;
+        for (const QString &column : classStatsBucketColumns())
+            bucketColumns << column + " INTEGER NOT NULL DEFAULT 0";
+
+        statements << QString("CREATE TABLE class_stats ("
+                              "class TEXT NOT NULL, subject INTEGER NOT NULL, "
+                              "students INTEGER NOT NULL, total_sum REAL NOT NULL, "
+                              "score_count INTEGER NOT NULL, score_sum REAL NOT NULL, score_sumsq REAL NOT NULL, "
+                              "score_min REAL, score_max REAL, pass_count INTEGER NOT NULL, %1, "
+                              "PRIMARY KEY (class, subject)) WITHOUT ROWID").arg(bucketColumns.join(", "))
+                   << "INSERT INTO class_stats " + classStatsSelect();
+    }
+
+    if (!countsExist) {
+        statements << "CREATE TABLE class_score_counts ("
+                      "class TEXT NOT NULL, subject INTEGER NOT NULL, score REAL NOT NULL, "
+                      "students INTEGER NOT NULL, PRIMARY KEY (class, subject, score)) WITHOUT ROWID"
+                   << "INSERT INTO class_score_counts " + scoreCountsSelect();
+    }
+
+    QString addNew, removeOld, countNew, uncountOld;
+    for (int s = 0; s < SubjectCount; s++) {
+        addNew += classStatsAddRow("new", Subject(s));
+        removeOld += classStatsRemoveRow("old", Subject(s));
+        countNew += scoreCountsAddRow("new", Subject(s));
+        uncountOld += scoreCountsRemoveRow("old", Subject(s));
+    }
+    const QString dropEmpty = "DELETE FROM class_stats WHERE class = old.class AND students <= 0;";
+
+    statements << "CREATE TRIGGER IF NOT EXISTS class_stats_ai AFTER INSERT ON students BEGIN " + addNew + " END"
+               << "CREATE TRIGGER IF NOT EXISTS class_stats_ad AFTER DELETE ON students BEGIN "
+                      + removeOld + dropEmpty + " END"
+               << "CREATE TRIGGER IF NOT EXISTS class_stats_au AFTER UPDATE OF class, " + scoreColumns()
+                      + " ON students BEGIN " + removeOld + dropEmpty + addNew + " END"
+               << "CREATE TRIGGER IF NOT EXISTS class_score_counts_ai AFTER INSERT ON students BEGIN "
+                      + countNew + " END"
+               << "CREATE TRIGGER IF NOT EXISTS class_score_counts_ad AFTER DELETE ON students BEGIN "
+                      + uncountOld + " END"
+               << "CREATE TRIGGER IF NOT EXISTS class_score_counts_au AFTER UPDATE OF class, " + scoreColumns()
+                      + " ON students BEGIN " + uncountOld + countNew + " END";
+
+    for (const QString &sql : statements) {
+        if (!query.exec(sql)) {
+            qDebug() << "创建班级统计表失败，统计将直接扫描学生表：" << query.lastError().text();
+            db.rollback();
+            return false;
         }
     }
 
-    return trendData;
+    return db.commit();
 }
 
-QStringList Database::getAllClasses()
+// 重建学生表会连同触发器一起删除，与统计表的触发器一样每次打开时补建
+bool Database::createChangeLog()
 {
-    QStringList classes;
-    QSqlQuery query("SELECT DISTINCT class FROM students ORDER BY class");
+    QSqlQuery query(db);
+    const QStringList statements = {
+        "CREATE TRIGGER IF NOT EXISTS student_changes_ai AFTER INSERT ON students BEGIN "
+        "INSERT INTO student_changes (student_id) VALUES (new.id); END",
+        "CREATE TRIGGER IF NOT EXISTS student_changes_ad AFTER DELETE ON students BEGIN "
+        "INSERT INTO student_changes (student_id) VALUES (old.id); END",
+        "CREATE TRIGGER IF NOT EXISTS student_changes_au AFTER UPDATE ON students BEGIN "
+        "INSERT INTO student_changes (student_id) VALUES (new.id); END",
+        // 只保留最近的记录；更早的变更由读取方发现序号断开后整表重新装载
+        // 写入时每隔 ChangeLogPruneEvery 条清理一次，长时间不重新打开的数据库也不会无限增长
+        QString("CREATE TRIGGER IF NOT EXISTS student_changes_prune AFTER INSERT ON student_changes "
+                "WHEN new.seq % %1 = 0 BEGIN DELETE FROM student_changes WHERE seq <= new.seq - %2; END")
+            .arg(ChangeLogPruneEvery).arg(ChangeLogKeep),
+        QString("DELETE FROM student_changes WHERE seq <= (SELECT MAX(seq) FROM student_changes) - %1")
+            .arg(ChangeLogKeep)
+    };
+
+    for (const QString &sql : statements) {
+        if (!query.exec(sql)) {
+            qDebug() << "创建变更记录失败，外部修改将整表重新装载：" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Database::rebuildClassStats()
+{
+    if (!classStatsAvailable)
+        return false;
+
+    QuerySpan span("rebuildClassStats", db);
+    QSqlQuery query(db);
+    if (!db.transaction()) {
+        qDebug() << "开启事务失败：" << db.lastError().text();
+        return false;
+    }
+    if (!query.exec("DELETE FROM class_stats") || !query.exec("INSERT INTO class_stats " + classStatsSelect())
+        || !query.exec("DELETE FROM class_score_counts")
+        || !query.exec("INSERT INTO class_score_counts " + scoreCountsSelect())) {
+        qDebug() << "重建班级统计表失败：" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+// 逐项比较两份快照，浮点累加顺序不同会有微小误差，按相对误差比较
+static void compareAggregates(const QString &where, const SubjectAggregate &expected,
+                              const SubjectAggregate &actual, QStringList *differences)
+{
+    auto same = [](double a, double b) {
+        return qAbs(a - b) <= 1e-6 * qMax(1.0, qMax(qAbs(a), qAbs(b)));
+    };
+    auto report = [&](const QString &field, const QVariant &a, const QVariant &b) {
+        differences->append(QString("%1 %2：应为 %3，实际为 %4").arg(where, field, a.toString(), b.toString()));
+    };
 
+    if (expected.count != actual.count) report("score_count", expected.count, actual.count);
+    if (!same(expected.sum, actual.sum)) report("score_sum", expected.sum, actual.sum);
+    if (!same(expected.sumSquares, actual.sumSquares)) report("score_sumsq", expected.sumSquares, actual.sumSquares);
+    if (expected.count > 0 && !same(expected.min, actual.min)) report("score_min", expected.min, actual.min);
+    if (expected.count > 0 && !same(expected.max, actual.max)) report("score_max", expected.max, actual.max);
+    if (expected.passCount != actual.passCount) report("pass_count", expected.passCount, actual.passCount);
+    if (expected.buckets != actual.buckets) report("buckets", QVariant(), QVariant());
+}
+
+bool Database::checkClassStats(QStringList *differences)
+{
+    if (!classStatsAvailable)
+        return false;
+
+    // 按当前数据重新汇总到临时表，再与触发器维护的结果比较
+    QuerySpan span("checkClassStats", db);
+    QSqlQuery query(db);
+    if (!query.exec("DROP TABLE IF EXISTS temp.class_stats_check")
+        || !query.exec("CREATE TEMP TABLE class_stats_check AS " + classStatsSelect())) {
+        qDebug() << "重新汇总班级统计失败：" << query.lastError().text();
+        return false;
+    }
+
+    const StatisticsSnapshot expected = readClassStats("temp.class_stats_check");
+    const StatisticsSnapshot actual = readClassStats("class_stats");
+    query.exec("DROP TABLE temp.class_stats_check");
+
+    QStringList found;
+    QMap<QString, const ClassAggregate *> actualClasses;
+    for (const ClassAggregate &aggregate : actual.classes)
+        actualClasses.insert(aggregate.className, &aggregate);
+
+    for (const ClassAggregate &aggregate : expected.classes) {
+        const ClassAggregate *other = actualClasses.take(aggregate.className);
+        if (!other) {
+            found << QString("%1：统计表中缺少该班级").arg(aggregate.className);
+            continue;
+        }
+        if (aggregate.studentCount != other->studentCount)
+            found << QString("%1 students：应为 %2，实际为 %3").arg(aggregate.className)
+                         .arg(aggregate.studentCount).arg(other->studentCount);
+        for (int s = 0; s < SubjectCount; s++) {
+            compareAggregates(QString("%1/%2").arg(aggregate.className, QString(subjectColumn(Subject(s)))),
+                              aggregate.subjects[s], other->subjects[s], &found);
+        }
+    }
+    for (auto it = actualClasses.constBegin(); it != actualClasses.constEnd(); ++it)
+        found << QString("%1：统计表中多出该班级").arg(it.key());
+
+    // 分数计数是整数，两边做差集，任何一边多出的行都是不一致
+    const QString fresh = QString("SELECT * FROM (%1)").arg(scoreCountsSelect());
+    const QString stored = "SELECT class, subject, score, students FROM class_score_counts";
+    if (query.exec(QString("SELECT (SELECT COUNT(*) FROM (%1 EXCEPT %2)) + (SELECT COUNT(*) FROM (%2 EXCEPT %1))")
+                       .arg(stored, fresh))
+        && query.next()) {
+        const qint64 mismatched = query.value(0).toLongLong();
+        if (mismatched > 0)
+            found << QString("class_score_counts：%1 行与学生表不一致").arg(mismatched);
+    } else {
+        found << QString("class_score_counts：校验失败 %1").arg(query.lastError().text());
+    }
+    query.finish();
+
+    for (const QString &difference : found)
+        qDebug() << "班级统计不一致：" << difference;
+    if (differences)
+        *differences = found;
+    return found.isEmpty();
+}
+
+StatisticsSnapshot Database::readClassStats(const QString &table)
+{
+    StatisticsSnapshot snapshot;
+    snapshot.bucketEdges = StatisticsSnapshot::defaultBucketEdges();
+    const QStringList bucketColumns = classStatsBucketColumns();
+
+    auto buildSql = [&]() {
+        return QString("SELECT class, subject, students, total_sum, score_count, score_sum, score_sumsq, "
+                       "score_min, score_max, pass_count, %1 FROM %2 ORDER BY class, subject")
+            .arg(bucketColumns.join(", "), table);
+    };
+
+    // 只缓存读取统计表的语句，校验时读的临时表每次重建，语句不能复用
+    QuerySpan span("readClassStats", db);
+    QSqlQuery scratch(db);
+    QSqlQuery *cached = &scratch;
+    if (table == QLatin1String("class_stats")) {
+        cached = cachedQuery(StmtReadClassStats, 0, buildSql);
+    } else {
+        scratch.setForwardOnly(true);
+        if (!scratch.prepare(buildSql()))
+            cached = nullptr;
+    }
+    span.prepared();
+    if (!cached || !cached->exec()) {
+        qDebug() << "读取班级统计失败：" << (cached ? cached->lastError() : db.lastError()).text();
+        return snapshot;
+    }
+    span.executed(cached);
+    QSqlQuery &query = *cached;
+
+    // 每个班级有 SubjectCount 行，按班级归并
     while (query.next()) {
-        classes.append(query.value(0).toString());
+        const QString className = query.value(0).toString();
+        if (snapshot.classes.isEmpty() || snapshot.classes.constLast().className != className) {
+            ClassAggregate aggregate;
+            aggregate.className = className;
+            aggregate.studentCount = query.value(2).toLongLong();
+            aggregate.totalSum = query.value(3).toDouble();
+            snapshot.classes.append(aggregate);
+        }
+
+        const int subject = query.value(1).toInt();
+        if (subject < 0 || subject >= SubjectCount)
+            continue;
+
+        SubjectAggregate &scores = snapshot.classes.last().subjects[subject];
+        scores.count = query.value(4).toLongLong();
+        scores.sum = query.value(5).toDouble();
+        scores.sumSquares = query.value(6).toDouble();
+        scores.min = query.value(7).toDouble();
+        scores.max = query.value(8).toDouble();
+        scores.passCount = query.value(9).toLongLong();
+        scores.buckets.resize(bucketColumns.size());
+        for (int i = 0; i < bucketColumns.size(); i++)
+            scores.buckets[i] = query.value(10 + i).toLongLong();
+        span.addRows(1);
     }
 
-    return classes;
+    query.finish();
+    if (table == QLatin1String("class_stats"))
+        readScoreCounts(snapshot);
+    snapshot.computeSchoolTotals();
+    return snapshot;
 }
 
-bool Database::isStudentExist(const QString &stuId)
+// 读统计表时分布取自触发器维护的计数表；扫描学生表时分布在 ScoreMatrix::aggregate 中一并算出
+void Database::readScoreCounts(StatisticsSnapshot &snapshot)
+{
+    QSqlQuery *query = cachedQuery(StmtReadScoreCounts, "SELECT class, subject, score, students FROM class_score_counts");
+    if (!query)
+        return;
+
+    if (!query->exec()) {
+        qDebug() << "读取分数分布失败：" << query->lastError().text();
+        return;
+    }
+
+    QHash<QString, int> classIndex;
+    for (int i = 0; i < snapshot.classes.size(); i++)
+        classIndex.insert(snapshot.classes.at(i).className, i);
+
+    while (query->next()) {
+        const int index = classIndex.value(query->value(0).toString(), -1);
+        const int subject = query->value(1).toInt();
+        if (index < 0 || subject < 0 || subject >= SubjectCount)
+            continue;
+        snapshot.classes[index].subjects[subject].distribution.add(query->value(2).toDouble(),
+                                                                    query->value(3).toLongLong());
+    }
+    query->finish();
+}
+
+// ================ 预编译语句缓存 ================
+// 常用语句只编译一次，之后每次调用只重新绑定参数并执行
+// 取出的语句用完后要调用 finish()，否则未读完的语句会一直占着读锁
+
+QSqlQuery *Database::cachedQuery(Statement statement, const char *sql)
+{
+    return cachedQuery(statement, 0, [sql]() { return QString(sql); });
+}
+
+QSqlQuery *Database::cachedQuery(Statement statement, int variant, const std::function<QString()> &buildSql)
+{
+    const quint32 key = (quint32(statement) << 16) | quint32(variant & 0xFFFF);
+    auto it = statementCache.find(key);
+    if (it != statementCache.end()) {
+        cacheStats.hits++;
+        return &it.value();
+    }
+
+    cacheStats.misses++;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare(buildSql())) {
+        qDebug() << "预编译语句失败：" << query.lastError().text();
+        return nullptr;
+    }
+    return &statementCache.insert(key, query).value();
+}
+
+StatementCacheStats Database::statementCacheStats() const
+{
+    StatementCacheStats stats = cacheStats;
+    stats.statements = statementCache.size();
+    return stats;
+}
+
+bool Database::addStudent(const QString &stuId, const QString &name, const QString &className,
+                          const QVector<double> &scores, StudentTable *inserted)
+{
+    // RETURNING 直接取回写入后的整行（含 id 和计算出的总分），调用方无需重新查询
+    QuerySpan span("addStudent", db);
+    QSqlQuery *query = cachedQuery(StmtAddStudent, 0, []() {
+        return QString("INSERT INTO students (stu_id, name, class, %1) VALUES (?, ?, ?, %2) RETURNING %3")
+            .arg(scoreColumns(), placeholders(SubjectCount), studentColumns());
+    });
+    if (!query)
+        return false;
+    span.prepared();
+
+    query->bindValue(0, stuId);
+    query->bindValue(1, name);
+    query->bindValue(2, className);
+    for (int s = 0; s < SubjectCount; s++) {
+        const double score = scores.value(s, -1);
+        query->bindValue(3 + s, score >= 0 ? score : QVariant());
+    }
+
+    return trackedWrite([&]() {
+        if (!query->exec()) {
+            qDebug() << "添加学生失败：" << query->lastError().text();
+            return false;
+        }
+        span.executed(query);
+        if (inserted)
+            fillStudentTable(*query, *inserted, &span);
+        query->finish();
+        return true;
+    });
+}
+
+bool Database::updateStudent(const QString &stuId, const QString &name, const QString &className,
+                             const QVector<double> &scores, StudentTable *updated)
 {
-    QSqlQuery query;
-    query.prepare("SELECT COUNT(*) FROM students WHERE stu_id = ?");
-    query.addBindValue(stuId);
+    QuerySpan span("updateStudent", db);
+    QSqlQuery *query = cachedQuery(StmtUpdateStudent, 0, []() {
+        return QString("UPDATE students SET name = ?, class = ?, %1 = ? WHERE stu_id = ? RETURNING %2")
+            .arg(scoreColumns().replace(", ", " = ?, "), studentColumns());
+    });
+    if (!query)
+        return false;
+    span.prepared();
 
-    if (query.exec() && query.next()) {
-        return query.value(0).toInt() > 0;
+    query->bindValue(0, name);
+    query->bindValue(1, className);
+    for (int s = 0; s < SubjectCount; s++) {
+        const double score = scores.value(s, -1);
+        query->bindValue(2 + s, score >= 0 ? score : QVariant());
     }
+    query->bindValue(2 + SubjectCount, stuId);
+
+    return trackedWrite([&]() {
+        if (!query->exec()) {
+            qDebug() << "修改学生失败：" << query->lastError().text();
+            return false;
+        }
+        span.executed(query);
+        if (updated)
+            fillStudentTable(*query, *updated, &span);
+        query->finish();
+        return true;
+    });
+}
+
+bool Database::applyStudentEdits(const QVector<StudentEdit> &edits, StudentTable *rows,
+                                 QVector<QPair<int, QString>> *rowErrors)
+{
+    if (edits.isEmpty())
+        return true;
+
+    // 每个字段绑定两个参数：是否修改、新值；没有修改的字段写回原值，同一条语句适用于任意字段组合
+    QuerySpan span("applyStudentEdits", db);
+    span.addRows(edits.size());
+    QSqlQuery *query = cachedQuery(StmtApplyEdit, 0, []() {
+        QStringList assignments;
+        for (const QString &column : QStringList{"name", "class"} + scoreColumns().split(", "))
+            assignments << QString("%1 = CASE WHEN ? THEN ? ELSE %1 END").arg(column);
+        return QString("UPDATE students SET %1 WHERE id = ? RETURNING %2")
+            .arg(assignments.join(", "), studentColumns());
+    });
+    QSqlQuery *current = cachedQuery(StmtStudentById, 0, []() {
+        return QString("SELECT %1 FROM students WHERE id = ?").arg(studentColumns());
+    });
+    if (!query || !current)
+        return false;
+    span.prepared();
+
+    if (!beginTrackedWrite())
+        return false;
+
+    // 保存点本身出错时无法只回滚一行，整批回滚，由调用方整批重试
+    auto abandon = [this, rows, rowErrors](const QString &step, const QSqlQuery &failed) {
+        qDebug() << step << "失败，放弃整批修改：" << failed.lastError().text();
+        rollbackTrackedWrite();
+        if (rows)
+            rows->clear();
+        if (rowErrors)
+            rowErrors->clear();
+        return false;
+    };
+
+    QSqlQuery savepoint(db);
+    for (const StudentEdit &edit : edits) {
+        int parameter = 0;
+        query->bindValue(parameter++, bool(edit.fields & StudentEdit::NameField));
+        query->bindValue(parameter++, edit.name);
+        query->bindValue(parameter++, bool(edit.fields & StudentEdit::ClassField));
+        query->bindValue(parameter++, edit.className);
+        for (int s = 0; s < SubjectCount; s++) {
+            query->bindValue(parameter++, edit.hasScore(s));
+            query->bindValue(parameter++, StudentTable::isMissing(edit.scores[s]) ? QVariant() : QVariant(edit.scores[s]));
+        }
+        query->bindValue(parameter++, edit.id);
+
+        if (!savepoint.exec("SAVEPOINT student_edit"))
+            return abandon("建立保存点", savepoint);
+        StudentTable written;
+        QString error;
+        if (!query->exec()) {
+            error = query->lastError().text();
+        } else {
+            fillStudentTable(*query, written);
+            if (written.isEmpty())
+                error = "学生不存在";   // 修改排队期间已被删除
+        }
+        query->finish();
+
+        // 释放失败时保存点仍在，按失败的行回滚
+        if (error.isEmpty()) {
+            if (savepoint.exec("RELEASE student_edit")) {
+                if (rows)
+                    rows->append(written);
+                continue;
+            }
+            error = savepoint.lastError().text();
+        }
+
+        // 只回滚这一行（包括触发器对统计表的改动），再读出原有的值交给界面恢复
+        if (!savepoint.exec("ROLLBACK TO student_edit"))
+            return abandon("回滚到保存点", savepoint);
+        if (!savepoint.exec("RELEASE student_edit"))
+            return abandon("释放保存点", savepoint);
+        if (rowErrors)
+            rowErrors->append(qMakePair(edit.id, error));
+        current->bindValue(0, edit.id);
+        if (rows && current->exec()) {
+            StudentTable original;
+            fillStudentTable(*current, original);
+            rows->append(original);
+        }
+        current->finish();
+    }
+
+    if (!commitTrackedWrite()) {
+        if (rows)
+            rows->clear();
+        if (rowErrors)
+            rowErrors->clear();
+        return false;
+    }
+    span.executed(nullptr);   // 每行一条语句，不记录参数
+    return true;
+}
+
+bool Database::deleteStudent(const QString &stuId)
+{
+    QuerySpan span("deleteStudent", db);
+    QSqlQuery *query = cachedQuery(StmtDeleteStudent, "DELETE FROM students WHERE stu_id = ?");
+    if (!query)
+        return false;
+    span.prepared();
+
+    query->bindValue(0, stuId);
+    return trackedWrite([&]() {
+        const bool ok = query->exec();
+        span.executed(query);
+        span.addRows(query->numRowsAffected());
+        return ok;
+    });
+}
+
+bool Database::insertStudentBatch(const StudentBatch &batch, QVector<QPair<int, QString>> *rowErrors)
+{
+    if (batch.size() == 0)
+        return true;
+
+    QuerySpan span("insertStudentBatch", db);
+    span.addRows(batch.size());
+    QSqlQuery *cached = cachedQuery(StmtInsertBatch, 0, []() {
+        return QString("INSERT INTO students (stu_id, name, class, %1) VALUES (?, ?, ?, %2)")
+            .arg(scoreColumns(), placeholders(SubjectCount));
+    });
+    if (!cached)
+        return false;
+    span.prepared();
+
+    QSqlQuery &query = *cached;
+    query.bindValue(0, batch.stuIds);
+    query.bindValue(1, batch.names);
+    query.bindValue(2, batch.classes);
+    for (int s = 0; s < SubjectCount; s++)
+        query.bindValue(3 + s, batch.scores[s]);
+
+    // ================ 整批写入 ================
+    if (!beginTrackedWrite())
+        return false;
+    if (query.execBatch() && commitTrackedWrite()) {
+        span.executed(nullptr);   // 绑定的是整列数据，不记录参数
+        return true;
+    }
+    rollbackTrackedWrite();
+
+    // ================ 整批失败时逐行定位错误 ================
+    if (!beginTrackedWrite())
+        return false;
+    for (int row = 0; row < batch.size(); row++) {
+        query.bindValue(0, batch.stuIds.at(row));
+        query.bindValue(1, batch.names.at(row));
+        query.bindValue(2, batch.classes.at(row));
+        for (int s = 0; s < SubjectCount; s++)
+            query.bindValue(3 + s, batch.scores[s].at(row));
+
+        if (!query.exec() && rowErrors) {
+            rowErrors->append(qMakePair(row, query.lastError().text()));
+        }
+    }
+    return commitTrackedWrite();
+}
+
+QSet<QString> Database::getAllStudentIds()
+{
+    QuerySpan span("getAllStudentIds", db);
+    QSet<QString> ids;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (query.exec("SELECT stu_id FROM students")) {
+        span.executed(&query);
+        while (query.next()) {
+            ids.insert(query.value(0).toString());
+        }
+    }
+    span.addRows(ids.size());
+    return ids;
+}
+
+void Database::fillStudentTable(QSqlQuery &query, StudentTable &table, QuerySpan *span)
+{
+    fillStudentChunks(query, 0, [&table](StudentTable &&rows) {
+        table = std::move(rows);
+        return true;
+    }, span);
+}
+
+bool Database::fillStudentChunks(QSqlQuery &query, int chunkSize, const StudentChunkConsumer &consumer,
+                                 QuerySpan *span)
+{
+    qint64 rows = 0;
+    StudentTable chunk;
+    if (chunkSize > 0)
+        chunk.reserve(chunkSize);
+
+    // 按列下标取值，避免按字段名查找
+    float scores[SubjectCount];
+    while (query.next()) {
+        for (int s = 0; s < SubjectCount; s++) {
+            const QVariant score = query.value(ColFirstScore + s);
+            scores[s] = StudentTable::scoreFromDatabase(score.toDouble(), score.isNull());
+        }
+
+        chunk.append(query.value(ColId).toInt(),
+                     query.value(ColStuId).toString(),
+                     query.value(ColName).toString(),
+                     query.value(ColClass).toString(),
+                     scores,
+                     query.value(ColTotal).toFloat(),
+                     query.value(ColAverage).toFloat());
+        rows++;
+
+        if (chunkSize > 0 && chunk.size() >= chunkSize) {
+            if (!consumer(std::move(chunk))) {
+                if (span)
+                    span->addRows(rows);
+                return false;
+            }
+            chunk = StudentTable();
+            chunk.reserve(chunkSize);
+        }
+    }
+
+    if (span)
+        span->addRows(rows);
+
+    // 不分块时即使没有数据也要交出一张空表
+    if (!chunk.isEmpty() || chunkSize <= 0)
+        return consumer(std::move(chunk));
+    return true;
+}
+
+StudentTable Database::getAllStudents()
+{
+    StudentTable students;
+    getAllStudents(0, [&students](StudentTable &&rows) {
+        students = std::move(rows);
+        return true;
+    });
+    return students;
+}
+
+bool Database::getAllStudents(int chunkSize, const StudentChunkConsumer &consumer)
+{
+    QuerySpan span("getAllStudents", db);
+    QSqlQuery query = selectStudents();
+    if (!query.isActive())
+        return false;
+    span.executed(&query);
+
+    return fillStudentChunks(query, chunkSize, consumer, &span);
+}
+
+QSqlQuery Database::selectStudents(const QString &keyword)
+{
+    // 只计准备和执行，逐行读取由调用方完成
+    QuerySpan span("selectStudents", db);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (keyword.isEmpty()) {
+        query.prepare(QString("SELECT %1 FROM students ORDER BY class, stu_id").arg(studentColumns()));
+    } else if (searchIndexAvailable && keyword.size() >= MinIndexedKeywordLength) {
+        // 整个关键字作为一个短语匹配，短语内的双引号需要写两次
+        query.prepare(QString("SELECT %1 FROM students_fts JOIN students AS s ON s.id = students_fts.rowid "
+                              "WHERE students_fts MATCH ? ORDER BY students_fts.rank")
+                          .arg(studentColumns("s.")));
+        QString phrase = keyword;
+        phrase.replace('"', "\"\"");
+        query.addBindValue(QString("\"%1\"").arg(phrase));
+    } else {
+        query.prepare(QString("SELECT %1 FROM students WHERE stu_id LIKE ? OR name LIKE ? OR class LIKE ? "
+                              "ORDER BY class, stu_id").arg(studentColumns()));
+        QString pattern = "%" + keyword + "%";
+        query.addBindValue(pattern);
+        query.addBindValue(pattern);
+        query.addBindValue(pattern);
+    }
+
+    span.prepared();
+    if (!query.exec()) {
+        qDebug() << "查询学生失败：" << query.lastError().text();
+    }
+    span.executed(&query);
+    return query;
+}
+
+StudentTable Database::searchStudents(const QString &keyword)
+{
+    StudentTable students;
+    searchStudents(keyword, 0, [&students](StudentTable &&rows) {
+        students = std::move(rows);
+        return true;
+    });
+    return students;
+}
+
+bool Database::searchStudents(const QString &keyword, int chunkSize, const StudentChunkConsumer &consumer)
+{
+    QuerySpan span("searchStudents", db);
+    QSqlQuery query = selectStudents(keyword);
+    if (!query.isActive())
+        return false;
+    span.executed(&query);
+
+    return fillStudentChunks(query, chunkSize, consumer, &span);
+}
+
+int Database::countStudents()
+{
+    QuerySpan span("countStudents", db);
+    QSqlQuery *query = cachedQuery(StmtCountStudents, "SELECT COUNT(*) FROM students");
+    span.prepared();
+    int count = 0;
+    if (query && query->exec() && query->next()) {
+        span.executed(query);
+        count = query->value(0).toInt();
+    }
+    if (query)
+        query->finish();
+
+    return count;
+}
+
+int Database::countStudentsBefore(const QString &className, const QString &stuId)
+{
+    QuerySpan span("countStudentsBefore", db);
+    QSqlQuery *query = cachedQuery(StmtCountStudentsBefore,
+                                   "SELECT COUNT(*) FROM students WHERE (class, stu_id) < (?, ?)");
+    if (!query)
+        return 0;
+    span.prepared();
+
+    query->bindValue(0, className);
+    query->bindValue(1, stuId);
+
+    int count = 0;
+    if (query->exec() && query->next()) {
+        span.executed(query);
+        count = query->value(0).toInt();
+    }
+    query->finish();
+
+    return count;
+}
+
+StudentTable Database::getStudentPage(const QString &afterClass, const QString &afterStuId,
+                                      int skip, int limit)
+{
+    StudentTable page;
+    page.reserve(limit);
+
+    // 有起始键时用行值比较从索引中定位，不必像 OFFSET 那样从头数过去
+    QuerySpan span("getStudentPage", db);
+    QSqlQuery *query = nullptr;
+    int parameter = 0;
+    if (afterStuId.isEmpty()) {
+        query = cachedQuery(StmtFirstPage, 0, []() {
+            return QString("SELECT %1 FROM students ORDER BY class, stu_id LIMIT ? OFFSET ?").arg(studentColumns());
+        });
+    } else {
+        query = cachedQuery(StmtPageAfter, 0, []() {
+            return QString("SELECT %1 FROM students WHERE (class, stu_id) > (?, ?) "
+                           "ORDER BY class, stu_id LIMIT ? OFFSET ?").arg(studentColumns());
+        });
+        if (query) {
+            query->bindValue(parameter++, afterClass);
+            query->bindValue(parameter++, afterStuId);
+        }
+    }
+    if (!query)
+        return page;
+    span.prepared();
+
+    query->bindValue(parameter++, limit);
+    query->bindValue(parameter++, skip);
+
+    if (!query->exec()) {
+        qDebug() << "分页查询失败：" << query->lastError().text();
+        return page;
+    }
+    span.executed(query);
+
+    fillStudentTable(*query, page, &span);
+    query->finish();
+    return page;
+}
+
+bool Database::ensureSortIndex(int column)
+{
+    // 学号上已有唯一索引，按 (stu_id, id) 的顺序存放
+    if (column == ColStuId || sortIndexes.contains(column))
+        return true;
+    if (profile.readOnly)
+        return false;   // 只读连接没有索引时由 SQLite 临时排序
+
+    QuerySpan span("ensureSortIndex", db);
+    QSqlQuery query(db);
+    if (!query.exec(QString("CREATE INDEX IF NOT EXISTS idx_students_sort_%1 ON students(%2)")
+                        .arg(sortColumnName(column), sortExpression(column)))) {
+        qDebug() << "建立排序索引失败：" << query.lastError().text();
+        return false;
+    }
+    span.executed(&query);
+    sortIndexes.insert(column);
+    return true;
+}
+
+StudentTable Database::getSortedStudentPage(int column, bool descending, int afterId, int skip, int limit)
+{
+    StudentTable page;
+    page.reserve(limit);
+    if (column <= ColId || column > ColAverage)
+        return page;
+    ensureSortIndex(column);
+
+    QuerySpan span("getSortedStudentPage", db);
+    const bool anchored = afterId >= 0;
+    QSqlQuery *query = cachedQuery(StmtSortedPage, column * 4 + (descending ? 2 : 0) + (anchored ? 1 : 0),
+                                   [column, descending, anchored]() {
+        const QString expression = sortExpression(column);
+        const char *direction = descending ? " DESC" : "";
+        return QString("SELECT %1 FROM students %2 ORDER BY %3%4, id%4 LIMIT ? OFFSET ?")
+            .arg(studentColumns(),
+                 anchored ? "WHERE " + sortedKeyCondition(expression, descending ? "<" : ">") : QString(),
+                 expression, QLatin1String(direction));
+    });
+    if (!query)
+        return page;
+    span.prepared();
+
+    int parameter = 0;
+    if (anchored) {
+        for (int i = 0; i < 3; i++)
+            query->bindValue(parameter++, afterId);
+    }
+    query->bindValue(parameter++, limit);
+    query->bindValue(parameter++, skip);
+
+    if (!query->exec()) {
+        qDebug() << "排序分页查询失败：" << query->lastError().text();
+        return page;
+    }
+    span.executed(query);
+
+    fillStudentTable(*query, page, &span);
+    query->finish();
+    return page;
+}
+
+int Database::countSortedBefore(int column, bool descending, int id)
+{
+    if (column <= ColId || column > ColAverage)
+        return 0;
+    ensureSortIndex(column);
+
+    QuerySpan span("countSortedBefore", db);
+    QSqlQuery *query = cachedQuery(StmtCountSortedBefore, column * 2 + (descending ? 1 : 0), [column, descending]() {
+        return QString("SELECT COUNT(*) FROM students WHERE %1")
+            .arg(sortedKeyCondition(sortExpression(column), descending ? ">" : "<"));
+    });
+    if (!query)
+        return 0;
+    span.prepared();
+
+    for (int i = 0; i < 3; i++)
+        query->bindValue(i, id);
+
+    int count = 0;
+    if (query->exec() && query->next()) {
+        span.executed(query);
+        count = query->value(0).toInt();
+    }
+    query->finish();
+
+    return count;
+}
+
+StatisticsSnapshot Database::getStatisticsSnapshot(const QVector<double> &bucketEdges)
+{
+    // 默认分数段直接读统计表，自定义分数段需要扫描学生表
+    if (readsClassStats(bucketEdges))
+        return readClassStats("class_stats");
+    return scanStatistics(bucketEdges);
+}
+
+bool Database::readsClassStats(const QVector<double> &bucketEdges) const
+{
+    return classStatsAvailable && bucketEdges == StatisticsSnapshot::defaultBucketEdges();
+}
+
+StatisticsSnapshot Database::scanClassRange(const QVector<double> &bucketEdges,
+                                            const QString &firstClass, const QString &lastClass)
+{
+    return scanStatistics(bucketEdges, firstClass, lastClass);
+}
+
+StatisticsSnapshot Database::scanStatistics(const QVector<double> &bucketEdges,
+                                            const QString &firstClass, const QString &lastClass)
+{
+    StatisticsSnapshot snapshot;
+    snapshot.bucketEdges = bucketEdges;
+    const bool ranged = !firstClass.isNull();
+    QuerySpan span(ranged ? "scanClassRange" : "scanStatistics", db);
+
+    // ================ 按班级顺序读出成绩 ================
+    // 原来每个科目、每个分数段各拼一组聚合列，科目越多 SQL 越长；现在只顺序读 (class, ...) 覆盖索引，
+    // 成绩放进按科目连续存放的矩阵，再逐班级一遍算出各科汇总和分布，语句与分数段无关
+    QSqlQuery *cached = cachedQuery(StmtScanStatistics, ranged ? 1 : 0, [ranged]() {
+        return QString("SELECT class, total, %1 FROM students %2ORDER BY class")
+            .arg(scoreColumns(), ranged ? "WHERE class >= ? AND class <= ? " : "");
+    });
+    if (!cached)
+        return snapshot;
+    span.prepared();
+
+    QSqlQuery &query = *cached;
+    if (ranged) {
+        query.bindValue(0, firstClass);
+        query.bindValue(1, lastClass);
+    }
+
+    if (!query.exec()) {
+        qDebug() << "统计查询失败：" << query.lastError().text();
+        return snapshot;
+    }
+    span.executed(&query);
+
+    ScoreMatrix matrix;
+    QVector<int> firstRows;   // 各班级在矩阵中的起始行
+    float scores[SubjectCount];
+    while (query.next()) {
+        const QString className = query.value(0).toString();
+        if (snapshot.classes.isEmpty() || snapshot.classes.constLast().className != className) {
+            ClassAggregate aggregate;
+            aggregate.className = className;
+            snapshot.classes.append(aggregate);
+            firstRows.append(matrix.rows());
+        }
+
+        ClassAggregate &aggregate = snapshot.classes.last();
+        aggregate.studentCount++;
+        aggregate.totalSum += query.value(1).toDouble();
+        for (int s = 0; s < SubjectCount; s++) {
+            const QVariant score = query.value(2 + s);
+            scores[s] = StudentTable::scoreFromDatabase(score.toDouble(), score.isNull());
+        }
+        matrix.appendRow(scores);
+    }
+    span.addRows(matrix.rows());
+    query.finish();
+
+    // ================ 逐班级汇总 ================
+    for (int i = 0; i < snapshot.classes.size(); i++) {
+        ClassAggregate &aggregate = snapshot.classes[i];
+        matrix.aggregate(firstRows.at(i), int(aggregate.studentCount), bucketEdges, aggregate.subjects);
+    }
+
+    snapshot.computeSchoolTotals();
+    return snapshot;
+}
+
+QVector<QMap<QString, QVariant>> Database::getSubjectStats(Subject subject)
+{
+    return getStatisticsSnapshot().subjectStats(subject);
+}
+
+QVector<QMap<QString, QVariant>> Database::getClassStats()
+{
+    return getStatisticsSnapshot().classStats();
+}
+
+QVector<QMap<QString, QVariant>> Database::getScoreDistribution(Subject subject)
+{
+    return getStatisticsSnapshot().scoreDistribution(subject);
+}
+
+QVector<QMap<QString, QVariant>> Database::getTrendData()
+{
+    return getStatisticsSnapshot().trendData();
+}
+
+RankIndex Database::getRankIndex()
+{
+    // 总分不在 class_score_counts 中，这里直接顺序读覆盖索引，不排序
+    QuerySpan span("getRankIndex", db);
+    RankIndex index;
+    QSqlQuery *query = cachedQuery(StmtRankScores, 0, []() {
+        return QString("SELECT class, %1, total FROM students").arg(scoreColumns());
+    });
+    span.prepared();
+    if (!query || !query->exec())
+        return index;
+    span.executed(query);
+
+    qint64 rows = 0;
+    float scores[SubjectCount];
+    while (query->next()) {
+        for (int s = 0; s < SubjectCount; s++) {
+            const QVariant value = query->value(1 + s);
+            scores[s] = StudentTable::scoreFromDatabase(value.toDouble(), value.isNull());
+        }
+        index.add(query->value(0).toString(), scores, query->value(1 + SubjectCount).toFloat());
+        rows++;
+    }
+    query->finish();
+    span.addRows(rows);
+
+    return index;
+}
+
+// ================ 考试记录 ================
+
+// 把 students 中的当前成绩复制为 examId 这次考试的成绩，并按班级汇总
+// 总分按 students.total 汇总（未录入的科目记 0），人数为全班人数，与 class_stats 的口径一致
+bool Database::insertExamScores(int examId)
+{
+    QStringList scoreSelects;
+    QStringList statSelects;
+    for (int s = 0; s < SubjectCount; s++) {
+        const QString column = subjectColumn(Subject(s));
+        scoreSelects << QString("SELECT %1, id, %2, %3 FROM students WHERE %3 >= 0").arg(examId).arg(s).arg(column);
+        statSelects << QString("SELECT %1, class, %2, COUNT(*), SUM(%3) FROM students WHERE %3 >= 0 GROUP BY class")
+                           .arg(examId).arg(s).arg(column);
+    }
+    statSelects << QString("SELECT %1, class, %2, COUNT(*), SUM(total) FROM students GROUP BY class")
+                       .arg(examId).arg(SubjectCount);
+
+    QSqlQuery query(db);
+    if (!query.exec("INSERT INTO scores (exam_id, student_id, subject, score) " + scoreSelects.join(" UNION ALL "))
+        || !query.exec("INSERT INTO exam_class_stats (exam_id, class, subject, students, score_sum) "
+                       + statSelects.join(" UNION ALL "))) {
+        qDebug() << "写入考试成绩失败：" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+int Database::recordExam(const QString &name, const QDate &date)
+{
+    QuerySpan span("recordExam", db);
+    if (!db.transaction()) {
+        qDebug() << "开启事务失败：" << db.lastError().text();
+        return -1;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO exams (name, exam_date) VALUES (?, ?)");
+    query.addBindValue(name);
+    query.addBindValue(date.toString(Qt::ISODate));
+    if (!query.exec()) {
+        qDebug() << "记录考试失败：" << query.lastError().text();
+        db.rollback();
+        return -1;
+    }
+    span.executed(&query);
+
+    const int examId = query.lastInsertId().toInt();
+    if (!insertExamScores(examId) || !db.commit()) {
+        db.rollback();
+        return -1;
+    }
+    return examId;
+}
+
+bool Database::deleteExam(int examId)
+{
+    QuerySpan span("deleteExam", db);
+    if (!db.transaction()) {
+        qDebug() << "开启事务失败：" << db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    for (const char *sql : {"DELETE FROM scores WHERE exam_id = ?",
+                            "DELETE FROM exam_class_stats WHERE exam_id = ?",
+                            "DELETE FROM exams WHERE id = ?"}) {
+        query.prepare(sql);
+        query.addBindValue(examId);
+        if (!query.exec()) {
+            qDebug() << "删除考试失败：" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    return db.commit();
+}
+
+QVector<QMap<QString, QVariant>> Database::getExams()
+{
+    QuerySpan span("getExams", db);
+    QVector<QMap<QString, QVariant>> exams;
+    // 人数用相关子查询取，外层直接按日期索引的顺序读，不必分组后再排序
+    QSqlQuery *query = cachedQuery(StmtExams,
+                                   "SELECT e.id, e.name, e.exam_date, "
+                                   "(SELECT SUM(c.students) FROM exam_class_stats AS c "
+                                   " WHERE c.exam_id = e.id AND c.subject = ?) "
+                                   "FROM exams AS e ORDER BY e.exam_date, e.id");
+    if (!query)
+        return exams;
+    span.prepared();
+
+    query->bindValue(0, SubjectCount);
+    if (!query->exec())
+        return exams;
+    span.executed(query);
+
+    while (query->next()) {
+        QMap<QString, QVariant> exam;
+        exam["exam_id"] = query->value(0).toInt();
+        exam["exam"] = query->value(1).toString();
+        exam["date"] = QDate::fromString(query->value(2).toString(), Qt::ISODate);
+        exam["students"] = query->value(3).toInt();
+        exams.append(exam);
+    }
+    query->finish();
+    span.addRows(exams.size());
+
+    return exams;
+}
+
+QVector<QMap<QString, QVariant>> Database::getClassTrend(int subject)
+{
+    QuerySpan span("getClassTrend", db);
+    QVector<QMap<QString, QVariant>> trend;
+    // CROSS JOIN 固定以 exams 为外层，按日期索引的顺序逐次考试读汇总表，结果已经有序
+    QSqlQuery *query = cachedQuery(StmtClassTrend,
+                                   "SELECT c.exam_id, c.class, c.score_sum / c.students, c.students "
+                                   "FROM exams AS e CROSS JOIN exam_class_stats AS c ON c.exam_id = e.id "
+                                   "WHERE c.subject = ? ORDER BY e.exam_date, e.id, c.class");
+    if (!query)
+        return trend;
+    span.prepared();
+
+    query->bindValue(0, subject);
+    if (!query->exec())
+        return trend;
+    span.executed(query);
+
+    while (query->next()) {
+        QMap<QString, QVariant> row;
+        row["exam_id"] = query->value(0).toInt();
+        row["class"] = query->value(1).toString();
+        row["average"] = query->value(2).toDouble();
+        row["students"] = query->value(3).toInt();
+        trend.append(row);
+    }
+    query->finish();
+    span.addRows(trend.size());
+
+    return trend;
+}
+
+QVector<QMap<QString, QVariant>> Database::getStudentDeltas(int fromExam, int toExam, int subject, int limit)
+{
+    QuerySpan span("getStudentDeltas", db);
+    QVector<QMap<QString, QVariant>> deltas;
+
+    // 单科按主键逐个对应两次考试的成绩；总分先按学生分组求和，主键顺序正好按学生排列，分组不需要排序
+    // 总分只是已录入科目之和，两次录入的科目不同时差值没有意义（例如缺考一科就成了大幅退步），
+    // 因此总分只比较两次考试科目完全相同的学生：主键保证每科至多一行，各科的位相加即科目集合
+    const bool total = subject == SubjectCount;
+    QSqlQuery *query = cachedQuery(StmtStudentDeltas, total ? 1 : 0, [total]() {
+        const QString scores = total
+            ? "(SELECT student_id, SUM(score) AS score, SUM(1 << subject) AS subjects "
+              "FROM scores WHERE exam_id = ? GROUP BY student_id)"
+            : "(SELECT student_id, score FROM scores WHERE exam_id = ? AND subject = ?)";
+        const QString sameSubjects = total ? " AND b.subjects = a.subjects" : "";
+        return QString("SELECT st.stu_id, st.name, st.class, a.score, b.score, b.score - a.score AS delta "
+                       "FROM %1 AS a JOIN %1 AS b ON b.student_id = a.student_id%2 "
+                       "JOIN students AS st ON st.id = a.student_id "
+                       "ORDER BY delta DESC, st.stu_id LIMIT ?").arg(scores, sameSubjects);
+    });
+    if (!query)
+        return deltas;
+    span.prepared();
+
+    int parameter = 0;
+    for (int examId : {fromExam, toExam}) {
+        query->bindValue(parameter++, examId);
+        if (!total)
+            query->bindValue(parameter++, subject);
+    }
+    query->bindValue(parameter, limit);
+    if (!query->exec())
+        return deltas;
+    span.executed(query);
+
+    while (query->next()) {
+        QMap<QString, QVariant> row;
+        row["stu_id"] = query->value(0).toString();
+        row["name"] = query->value(1).toString();
+        row["class"] = query->value(2).toString();
+        row["from"] = query->value(3).toDouble();
+        row["to"] = query->value(4).toDouble();
+        row["delta"] = query->value(5).toDouble();
+        deltas.append(row);
+    }
+    query->finish();
+    span.addRows(deltas.size());
+
+    return deltas;
+}
+
+QVector<QMap<QString, QVariant>> Database::getStudentHistory(const QString &stuId)
+{
+    QuerySpan span("getStudentHistory", db);
+    QVector<QMap<QString, QVariant>> history;
+    QSqlQuery *query = cachedQuery(StmtStudentHistory,
+                                   "SELECT e.id, e.name, e.exam_date, sc.subject, sc.score "
+                                   "FROM students AS st JOIN scores AS sc ON sc.student_id = st.id "
+                                   "JOIN exams AS e ON e.id = sc.exam_id "
+                                   "WHERE st.stu_id = ? ORDER BY e.exam_date, e.id, sc.subject");
+    if (!query)
+        return history;
+    span.prepared();
+
+    query->bindValue(0, stuId);
+    if (!query->exec())
+        return history;
+    span.executed(query);
+
+    // 同一次考试的各科成绩相邻，合并为一行；未录入的科目为空
+    int currentExam = -1;
+    while (query->next()) {
+        const int examId = query->value(0).toInt();
+        if (examId != currentExam) {
+            QMap<QString, QVariant> exam;
+            exam["exam_id"] = examId;
+            exam["exam"] = query->value(1).toString();
+            exam["date"] = QDate::fromString(query->value(2).toString(), Qt::ISODate);
+            for (int s = 0; s < SubjectCount; s++)
+                exam[subjectColumn(Subject(s))] = QVariant();
+            exam["total"] = 0.0;
+            history.append(exam);
+            currentExam = examId;
+        }
+
+        const int subject = query->value(3).toInt();
+        const double score = query->value(4).toDouble();
+        QMap<QString, QVariant> &exam = history.last();
+        if (subject >= 0 && subject < SubjectCount)
+            exam[subjectColumn(Subject(subject))] = score;
+        exam["total"] = exam["total"].toDouble() + score;
+    }
+    query->finish();
+    span.addRows(history.size());
+
+    return history;
+}
+
+ExamTrend Database::getExamTrend(int improvedLimit)
+{
+    ExamTrend trend;
+    trend.exams = getExams();
+    if (trend.exams.size() < 2)
+        return trend;
+
+    trend.classTrend = getClassTrend(SubjectCount);
+    const int fromExam = trend.exams.at(trend.exams.size() - 2)["exam_id"].toInt();
+    const int toExam = trend.exams.last()["exam_id"].toInt();
+    trend.mostImproved = getStudentDeltas(fromExam, toExam, SubjectCount, improvedLimit);
+    return trend;
+}
+
+int Database::dataVersion()
+{
+    QSqlQuery *query = cachedQuery(StmtDataVersion, "PRAGMA data_version");
+    int version = -1;
+    if (query && query->exec() && query->next())
+        version = query->value(0).toInt();
+    if (query)
+        query->finish();
+    return version;
+}
+
+qint64 Database::lastChangeSeq()
+{
+    if (!changeLogAvailable)
+        return -1;
+
+    QSqlQuery *query = cachedQuery(StmtLastChangeSeq, "SELECT IFNULL(MAX(seq), 0) FROM student_changes");
+    qint64 seq = -1;
+    if (query && query->exec() && query->next())
+        seq = query->value(0).toLongLong();
+    if (query)
+        query->finish();
+    return seq;
+}
+
+// 本连接自己的写入用 BEGIN IMMEDIATE 先取得写锁，提交之前其他连接无法写入，
+// 开始时和提交前读到的最大序号之间的变更记录都来自这次写入
+bool Database::beginTrackedWrite()
+{
+    QSqlQuery query(db);
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        qDebug() << "开启事务失败：" << query.lastError().text();
+        return false;
+    }
+    trackedFrom = lastChangeSeq();
+    return true;
+}
+
+bool Database::commitTrackedWrite()
+{
+    const qint64 to = trackedFrom >= 0 ? lastChangeSeq() : -1;
+    const ChangeRange range{trackedFrom, to};
+    const bool tracked = ownChangeListener && trackedFrom >= 0 && to > trackedFrom;
+    trackedFrom = -1;
+
+    // 先登记再提交：其他连接一旦能读到这些记录，登记一定已经完成；提交失败时撤销
+    if (tracked)
+        ownChangeListener(range, true);
+    QSqlQuery query(db);
+    if (!query.exec("COMMIT")) {
+        qDebug() << "提交修改失败：" << query.lastError().text();
+        if (tracked)
+            ownChangeListener(range, false);
+        rollbackTrackedWrite();
+        return false;
+    }
+    return true;
+}
+
+void Database::rollbackTrackedWrite()
+{
+    QSqlQuery query(db);
+    query.exec("ROLLBACK");
+    trackedFrom = -1;
+}
+
+bool Database::trackedWrite(const std::function<bool()> &write)
+{
+    if (!beginTrackedWrite())
+        return false;
+    if (!write()) {
+        rollbackTrackedWrite();
+        return false;
+    }
+    return commitTrackedWrite();
+}
+
+void Database::setOwnChangeListener(const OwnChangeListener &listener)
+{
+    ownChangeListener = listener;
+}
+
+bool Database::getChangedStudentIds(qint64 afterSeq, int limit, QVector<int> *ids, qint64 *lastSeq,
+                                    const QVector<ChangeRange> &skip)
+{
+    ids->clear();
+    *lastSeq = afterSeq;
+    if (!changeLogAvailable || afterSeq < 0)
+        return false;
+
+    QuerySpan span("getChangedStudentIds", db);
+    QSqlQuery *range = cachedQuery(StmtChangeRange, "SELECT MIN(seq), MAX(seq) FROM student_changes");
+    if (!range || !range->exec() || !range->next()) {
+        if (range)
+            range->finish();
+        return false;
+    }
+    const bool empty = range->value(1).isNull();
+    const qint64 first = range->value(0).toLongLong();
+    const qint64 last = range->value(1).toLongLong();
+    range->finish();
+
+    // 记录被清空或 afterSeq 之后的记录已被清理，无法知道期间改了哪些学生
+    if (empty)
+        return afterSeq == 0;
+    if (first > afterSeq + 1)
+        return false;
+    if (last <= afterSeq)
+        return true;
+
+    QSqlQuery *query = cachedQuery(StmtChangedIds,
+                                   "SELECT DISTINCT student_id FROM student_changes WHERE seq > ? AND seq <= ? LIMIT ?");
+    if (!query)
+        return false;
+    span.prepared();
+
+    // 跳过 skip 中的各段，逐段读取其余的记录；各段按序号排列，通常只有一两段
+    QVector<ChangeRange> gaps;
+    qint64 from = afterSeq;
+    for (const ChangeRange &range : skip) {
+        if (range.to <= from || range.from >= last)
+            continue;
+        if (range.from > from)
+            gaps.append({from, range.from});
+        from = qMax(from, range.to);
+    }
+    if (from < last)
+        gaps.append({from, last});
+
+    QSet<int> seen;
+    for (const ChangeRange &gap : gaps) {
+        query->bindValue(0, gap.from);
+        query->bindValue(1, gap.to);
+        query->bindValue(2, limit + 1);
+        if (!query->exec()) {
+            qDebug() << "读取变更记录失败：" << query->lastError().text();
+            ids->clear();
+            return false;
+        }
+        span.executed(query);
+        while (query->next()) {
+            const int id = query->value(0).toInt();
+            if (!seen.contains(id)) {
+                seen.insert(id);
+                ids->append(id);
+            }
+        }
+        query->finish();
+        if (ids->size() > limit) {
+            ids->clear();
+            return false;
+        }
+    }
+    span.addRows(ids->size());
+    *lastSeq = last;
+    return true;
+}
+
+StudentTable Database::getStudentsByIds(const QVector<int> &ids)
+{
+    StudentTable students;
+    QuerySpan span("getStudentsByIds", db);
+    QSqlQuery *query = cachedQuery(StmtStudentById, 0, []() {
+        return QString("SELECT %1 FROM students WHERE id = ?").arg(studentColumns());
+    });
+    if (!query)
+        return students;
+    span.prepared();
+
+    // 变更通常只涉及几名学生，逐个按主键读取
+    for (int id : ids) {
+        query->bindValue(0, id);
+        if (query->exec()) {
+            StudentTable row;
+            fillStudentTable(*query, row);
+            students.append(row);
+        }
+        query->finish();
+    }
+    span.executed(nullptr);
+    span.addRows(students.size());
+    return students;
+}
+
+QStringList Database::getAllClasses()
+{
+    QuerySpan span("getAllClasses", db);
+    QStringList classes;
+    QSqlQuery *query = cachedQuery(StmtAllClasses, "SELECT DISTINCT class FROM students ORDER BY class");
+    span.prepared();
+    if (!query || !query->exec())
+        return classes;
+    span.executed(query);
+
+    while (query->next()) {
+        classes.append(query->value(0).toString());
+    }
+    query->finish();
+    span.addRows(classes.size());
+
+    return classes;
+}
+
+bool Database::isStudentExist(const QString &stuId)
+{
+    // 找到一行即可，不必数完
+    QuerySpan span("isStudentExist", db);
+    QSqlQuery *query = cachedQuery(StmtIsStudentExist, "SELECT 1 FROM students WHERE stu_id = ? LIMIT 1");
+    if (!query)
+        return false;
+    span.prepared();
+
+    query->bindValue(0, stuId);
+    const bool exists = query->exec() && query->next();
+    span.executed(query);
+    query->finish();
 
-    return false;
+    return exists;
 }
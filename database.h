@@ -8,6 +8,81 @@
 #include <QVariant>
 #include <QVector>
 #include <QMap>
+#include <QSet>
+#include <QPair>
+#include <QDate>
+#include <functional>
+#include "studenttable.h"
+#include "statisticssnapshot.h"
+#include "rankindex.h"
+#include "connectionprofile.h"
+
+// 批量写入的一批学生，各列等长，成绩为空值表示未录入
+struct StudentBatch
+{
+    QVariantList stuIds;
+    QVariantList names;
+    QVariantList classes;
+    QVariantList scores[SubjectCount];
+
+    int size() const { return stuIds.size(); }
+    void clear();
+};
+
+// 表格中就地修改的一名学生：只写入 fields 中标记的字段，其余保持数据库中的值
+struct StudentEdit
+{
+    // fields 中的标志位：姓名、班级，以及第 s 科成绩对应的 ScoreField << s
+    enum Field : quint32 { NameField = 1u << 0, ClassField = 1u << 1, ScoreField = 1u << 2 };
+
+    int id = -1;
+    quint32 fields = 0;
+    QString name;
+    QString className;
+    float scores[SubjectCount] = {};   // NaN 表示清除该科成绩
+
+    bool hasScore(int subject) const { return fields & (ScoreField << subject); }
+    // 用 newer 中修改过的字段覆盖本次的值
+    void merge(const StudentEdit &newer);
+    // 把修改套用到一名学生的取值上
+    void applyTo(QString *name, QString *className, float *scores) const;
+};
+static_assert(SubjectCount + 2 <= 32, "修改标志位为 32 位，科目数不能超过 30");
+
+// 一批就地修改的写入结果
+// 变更记录中序号在 (from, to] 之间的一段
+struct ChangeRange
+{
+    qint64 from;
+    qint64 to;
+};
+
+struct StudentEditResult
+{
+    bool ok = false;                          // 整批失败（例如无法开启事务）时为 false，可整批重试
+    StudentTable rows;                        // 写入后的各行；某行失败时为回滚后数据库中原有的值
+    QVector<QPair<int, QString>> errors;      // 失败的学生 id 和原因
+};
+
+// 预编译语句缓存的命中统计
+struct StatementCacheStats
+{
+    quint64 hits = 0;
+    quint64 misses = 0;
+    int statements = 0;   // 当前缓存的语句数
+
+    double hitRate() const { return hits + misses > 0 ? double(hits) / double(hits + misses) : 0; }
+};
+
+// 统计对话框趋势页需要的几项考试数据，在同一个连接上依次查询
+struct ExamTrend
+{
+    QVector<QMap<QString, QVariant>> exams;          // 见 Database::getExams
+    QVector<QMap<QString, QVariant>> classTrend;     // 各班各次考试的总分平均分
+    QVector<QMap<QString, QVariant>> mostImproved;   // 最近两次考试之间总分进步最大的学生
+};
+
+class QuerySpan;
 
 class Database : public QObject
 {
@@ -17,30 +92,191 @@ public:
     explicit Database(QObject *parent = nullptr);
     ~Database();
 
+    // 学生查询结果中各列的下标
+    // 成绩列从 ColFirstScore 开始，按科目目录的顺序排列
+    enum StudentColumn {
+        ColId = 0, ColStuId, ColName, ColClass,
+        ColFirstScore, ColTotal = ColFirstScore + SubjectCount, ColAverage
+    };
+
+    // 按 QSettings 中的连接配置打开默认连接
     bool openDatabase();
+    // 以指定的配置和连接名打开数据库，每个线程必须使用自己的连接
+    bool openDatabase(const ConnectionProfile &connectionProfile, const QString &connectionName);
+    // 只读连接不能升级表结构：用一个短暂的可写连接把旧版本（或缺少新科目成绩列）的数据库升级到当前版本
+    // 只做迁移和补列，不建全文索引、统计表和触发器，也不改变文件的日志模式；已是最新版本时不写入任何内容
+    static bool upgradeSchema(const QString &databasePath, const QString &connectionName);
+    // 在已打开的连接上改用另一组 PRAGMA（例如批量导入期间），不改变保存的配置
+    bool applyPragmas(const ConnectionProfile &settings);
+    const ConnectionProfile &connectionProfile() const { return profile; }
+    QString databasePath() const { return profile.databasePath; }
     bool createTables();
+    bool createSearchIndex();
+    bool createClassStats();
+    bool createChangeLog();
 
     // 学生信息操作
+    // scores 依次为目录中各科的成绩，负数表示未录入
+    // inserted / updated 非空时返回写入后的那一行，用于局部更新表格
     bool addStudent(const QString &stuId, const QString &name, const QString &className,
-                    double chinese, double math, double english);
+                    const QVector<double> &scores, StudentTable *inserted = nullptr);
     bool updateStudent(const QString &stuId, const QString &name, const QString &className,
-                       double chinese, double math, double english);
+                       const QVector<double> &scores, StudentTable *updated = nullptr);
     bool deleteStudent(const QString &stuId);
-    QVector<QMap<QString, QVariant>> getAllStudents();
-    QVector<QMap<QString, QVariant>> searchStudents(const QString &keyword);
+    // 表格中就地修改：整批放在一个事务中，复用同一条预编译语句；每名学生各用一个保存点，某一行失败只回滚这一行
+    // rows 返回写入后的各行（失败的行为数据库中原有的值），rowErrors 返回失败学生的 id 和原因
+    bool applyStudentEdits(const QVector<StudentEdit> &edits, StudentTable *rows,
+                           QVector<QPair<int, QString>> *rowErrors);
+
+    // 批量导入：复用同一条预编译语句，整批放在一个事务中
+    // 整批失败时回滚并逐行重试，rowErrors 返回失败行在批内的下标和原因
+    bool insertStudentBatch(const StudentBatch &batch, QVector<QPair<int, QString>> *rowErrors);
+    QSet<QString> getAllStudentIds();
+    StudentTable getAllStudents();
+    StudentTable searchStudents(const QString &keyword);
+
+    // 逐块读取：每读满 chunkSize 行交给 consumer 一次，consumer 返回 false 时提前结束
+    using StudentChunkConsumer = std::function<bool(StudentTable &&chunk)>;
+    bool getAllStudents(int chunkSize, const StudentChunkConsumer &consumer);
+    bool searchStudents(const QString &keyword, int chunkSize, const StudentChunkConsumer &consumer);
+
+    // 返回已执行的只进查询（keyword 为空时查询全部），列顺序见 StudentColumn
+    // 用于导出等需要逐行流式处理、不想把结果装入内存的场合
+    // 关键字不少于 3 个字符时走全文索引，结果按相关度排序；否则按班级、学号排序
+    QSqlQuery selectStudents(const QString &keyword = QString());
+
+    // 分页读取：按 (class, stu_id) 键集分页，从 afterKey 之后跳过 skip 行再取 limit 行
+    int countStudents();
+    int countStudentsBefore(const QString &className, const QString &stuId);   // 该键在默认排序中的行号
+    StudentTable getStudentPage(const QString &afterClass, const QString &afterStuId,
+                                int skip, int limit);
+    // 按任一列排序的分页读取：column 取 StudentColumn 中除 ColId 外的列，同值的行再按 id 排序
+    // afterId 为上一页最后一行的 id，-1 表示从第一行开始；第一次按某列排序时为该列建立索引
+    StudentTable getSortedStudentPage(int column, bool descending, int afterId, int skip, int limit);
+    // 按某一列排序时使用的索引，用到时才建立，不用的列不增加写入开销；只读连接上不建立，返回 false
+    bool ensureSortIndex(int column);
+    int countSortedBefore(int column, bool descending, int id);   // 该学生在这种排序中的行号
 
     // 统计函数
-    QVector<QMap<QString, QVariant>> getSubjectStats(const QString &subject);
+    // 一次分组扫描算出所有班级、科目的汇总；下面几个函数都是快照的视图，
+    // 需要多项统计时应直接取快照，避免重复扫描
+    StatisticsSnapshot getStatisticsSnapshot(const QVector<double> &bucketEdges = StatisticsSnapshot::defaultBucketEdges());
+    QVector<QMap<QString, QVariant>> getSubjectStats(Subject subject);
     QVector<QMap<QString, QVariant>> getClassStats();
-    QVector<QMap<QString, QVariant>> getScoreDistribution(const QString &subject);
+    QVector<QMap<QString, QVariant>> getScoreDistribution(Subject subject);
     QVector<QMap<QString, QVariant>> getTrendData();
+    // 读出全部学生的班级、各科成绩和总分，建立排名索引；之后的增删改由调用方增量更新
+    RankIndex getRankIndex();
+
+    // 考试记录：记录时把 students 中的当前成绩复制到 scores 表，按 (exam_id, student_id, subject) 存储
+    // 同时按班级汇总到 exam_class_stats，趋势查询只读汇总表；已记录的考试不随之后的增删改变化
+    // 下面的 subject 取 SubjectCount 时表示总分
+    int recordExam(const QString &name, const QDate &date);   // 返回考试 id，失败返回 -1
+    bool deleteExam(int examId);
+    // 按考试日期排序：exam_id, exam, date, students
+    QVector<QMap<QString, QVariant>> getExams();
+    // 每次考试每个班级一行，按考试日期、班级排序：exam_id, class, average, students
+    QVector<QMap<QString, QVariant>> getClassTrend(int subject);
+    // 两次考试都有成绩的学生，按进步幅度从大到小：stu_id, name, class, from, to, delta；limit 为 -1 时不限行数
+    // 总分只比较两次录入的科目完全相同的学生，科目不同的学生不出现在结果中
+    QVector<QMap<QString, QVariant>> getStudentDeltas(int fromExam, int toExam, int subject, int limit = -1);
+    // 某个学生的历次成绩，每次考试一行：exam_id, exam, date, 各科成绩（列名同 students）, total
+    QVector<QMap<QString, QVariant>> getStudentHistory(const QString &stuId);
+    ExamTrend getExamTrend(int improvedLimit = 10);
+
+    // 默认分数段且统计表可用时，getStatisticsSnapshot 只读 class_stats，不扫描学生表
+    bool readsClassStats(const QVector<double> &bucketEdges) const;
+    // 只扫描班级名称在 [firstClass, lastClass] 内的学生，用于多个连接分段并行统计
+    StatisticsSnapshot scanClassRange(const QVector<double> &bucketEdges,
+                                      const QString &firstClass, const QString &lastClass);
+
+    // 班级统计表 class_stats 和分数计数表 class_score_counts 由触发器维护，下面两个函数用于校验和修复
+    // checkClassStats 重新汇总一遍并与维护结果逐项比较，differences 返回不一致之处
+    bool checkClassStats(QStringList *differences = nullptr);
+    bool rebuildClassStats();
+
+    // 预编译语句缓存的命中次数，用于观察常用操作是否只在重新绑定参数
+    StatementCacheStats statementCacheStats() const;
+
+    // 表结构版本（PRAGMA user_version），读取失败时返回 -1
+    int schemaVersion();
+    // 对程序中的主要查询执行 EXPLAIN QUERY PLAN，返回需要临时 B 树排序的查询
+    QStringList checkQueryPlans();
+
+    // 外部修改检测：其他连接（其他程序或本程序的其他线程）提交修改后 data_version 随之变化
+    // 读取它只看文件头，不访问任何表，可以频繁轮询；失败时返回 -1
+    int dataVersion();
+    // 变更记录：触发器把每次增删改的学生 id 按序号记入 student_changes，不论修改来自哪个程序
+    // 只保留最近 ChangeLogKeep 条：写入时每 ChangeLogPruneEvery 条清理一次，打开数据库时也清理一次
+    static constexpr int ChangeLogKeep = 100000;
+    static constexpr int ChangeLogPruneEvery = 1000;
+    qint64 lastChangeSeq();   // 当前最大的序号，没有记录时为 0，失败时为 -1
+    // 序号在 (afterSeq, *lastSeq] 之间变更过的学生 id（去重），lastSeq 返回读到的最大序号；skip 中各段的记录不计入
+    // 记录已被清理、变更记录不可用或涉及的学生超过 limit 名时返回 false，调用方应整表重新装载
+    bool getChangedStudentIds(qint64 afterSeq, int limit, QVector<int> *ids, qint64 *lastSeq,
+                              const QVector<ChangeRange> &skip = QVector<ChangeRange>());
+    // 本连接自己的增删改在变更记录中产生的序号：每次提交之前以 registered = true 通知，提交失败时以 false 撤销
+    // 写线程的连接据此告诉读取变更的一方，本程序自己的修改不再当作外部修改处理
+    using OwnChangeListener = std::function<void(const ChangeRange &range, bool registered)>;
+    void setOwnChangeListener(const OwnChangeListener &listener);
+    // 按 id 读取学生，已删除的不在结果中
+    StudentTable getStudentsByIds(const QVector<int> &ids);
 
     // 工具函数
     QStringList getAllClasses();
     bool isStudentExist(const QString &stuId);
 
 private:
+    // 缓存的预编译语句；同一语句按变体号（如分数段个数）区分不同的 SQL
+    enum Statement {
+        StmtAddStudent, StmtUpdateStudent, StmtDeleteStudent, StmtIsStudentExist, StmtInsertBatch,
+        StmtApplyEdit, StmtStudentById,
+        StmtCountStudents, StmtCountStudentsBefore, StmtFirstPage, StmtPageAfter,
+        StmtSortedPage, StmtCountSortedBefore,
+        StmtScanStatistics, StmtReadClassStats, StmtReadScoreCounts, StmtRankScores, StmtAllClasses,
+        StmtExams, StmtClassTrend, StmtStudentDeltas, StmtStudentHistory,
+        StmtDataVersion, StmtChangeRange, StmtChangedIds, StmtLastChangeSeq
+    };
+    QSqlQuery *cachedQuery(Statement statement, const char *sql);
+    QSqlQuery *cachedQuery(Statement statement, int variant, const std::function<QString()> &buildSql);
+
+    bool openConnection(const QString &connectionName);
+    bool migrate();
+    bool tableExists(const QString &name);
+    bool migrateStoredColumns();
+    // 按科目目录重建 students 表；目录新增科目时由 syncSubjectColumns 调用
+    bool rebuildStudentsTable();
+    bool syncSubjectColumns();
+    QStringList studentScoreColumns();
+    bool migrateExamHistory();
+    bool migrateChangeLog();
+    bool insertExamScores(int examId);
+    // 本连接的写事务，提交时记下这次写入产生的变更序号，见 takeOwnChanges
+    bool beginTrackedWrite();
+    bool commitTrackedWrite();
+    void rollbackTrackedWrite();
+    bool trackedWrite(const std::function<bool()> &write);
+
+    // span 非空时把读到的行数计入该次计时
+    static void fillStudentTable(QSqlQuery &query, StudentTable &table, QuerySpan *span = nullptr);
+    static bool fillStudentChunks(QSqlQuery &query, int chunkSize, const StudentChunkConsumer &consumer,
+                                  QuerySpan *span = nullptr);
+    StatisticsSnapshot scanStatistics(const QVector<double> &bucketEdges,
+                                      const QString &firstClass = QString(), const QString &lastClass = QString());
+    StatisticsSnapshot readClassStats(const QString &table);
+    // 把 class_score_counts 中各班级各科的分数计数填入快照中的分布，快照里没有的班级跳过
+    void readScoreCounts(StatisticsSnapshot &snapshot);
+
     QSqlDatabase db;
+    ConnectionProfile profile;
+    QMap<quint32, QSqlQuery> statementCache;   // 用 QMap 是因为插入新语句时已有元素不会移动
+    StatementCacheStats cacheStats;
+    bool searchIndexAvailable = false;   // SQLite 不支持 FTS5 时退回 LIKE 搜索
+    bool classStatsAvailable = false;    // 统计表不可用时直接扫描学生表
+    bool changeLogAvailable = false;     // 变更记录不可用时外部修改只能整表重新装载
+    qint64 trackedFrom = -1;             // 当前写事务开始时的最大变更序号
+    OwnChangeListener ownChangeListener;
+    QSet<int> sortIndexes;               // 本连接已确认存在的排序索引，按 StudentColumn
 };
 
 #endif // DATABASE_H
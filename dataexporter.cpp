@@ -0,0 +1,339 @@
+#include "dataexporter.h"
+#include "database.h"
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocale>
+#include <QElapsedTimer>
+#include <QDebug>
+
+// ================ 字段编码 ================
+
+static void appendCsvText(QByteArray &out, const QString &text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    bool needQuotes = false;
+    for (char c : utf8) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+            needQuotes = true;
+            break;
+        }
+    }
+
+    if (!needQuotes) {
+        out += utf8;
+        return;
+    }
+
+    out += '"';
+    for (char c : utf8) {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+static void appendJsonText(QByteArray &out, const QString &text)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out += '"';
+    for (char c : text.toUtf8()) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (uchar(c) < 0x20) {
+                out += "\\u00";
+                out += hex[(uchar(c) >> 4) & 0xF];
+                out += hex[uchar(c) & 0xF];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+// 空值在 CSV 中写成空字段，在 JSON 中写成 null
+static void appendNumber(QByteArray &out, const QVariant &value, DataExporter::Format format)
+{
+    if (value.isNull()) {
+        if (format == DataExporter::Format::JsonLines)
+            out += "null";
+        return;
+    }
+    out += QByteArray::number(value.toDouble(), 'g', QLocale::FloatingPointShortest);
+}
+
+static void appendValue(QByteArray &out, const QVariant &value, DataExporter::Format format)
+{
+    const int type = value.typeId();
+    if (value.isNull() || type == QMetaType::Double || type == QMetaType::Float
+        || type == QMetaType::Int || type == QMetaType::LongLong) {
+        appendNumber(out, value, format);
+    } else if (format == DataExporter::Format::JsonLines) {
+        appendJsonText(out, value.toString());
+    } else {
+        appendCsvText(out, value.toString());
+    }
+}
+
+static void appendHeader(QByteArray &out, const QStringList &columns)
+{
+    for (int i = 0; i < columns.size(); i++) {
+        if (i > 0) out += ',';
+        appendCsvText(out, columns.at(i));
+    }
+    out += '\n';
+}
+
+// 逐字段拼出一行，CSV 用逗号分隔，JSON Lines 每行一个对象
+class RowWriter
+{
+public:
+    RowWriter(QByteArray &out, DataExporter::Format format, const QStringList &columns)
+        : out(out), format(format), columns(columns) {}
+
+    void begin()
+    {
+        column = 0;
+        if (format == DataExporter::Format::JsonLines)
+            out += '{';
+    }
+
+    void add(const QVariant &value)
+    {
+        separate();
+        appendValue(out, value, format);
+    }
+
+    void end()
+    {
+        if (format == DataExporter::Format::JsonLines)
+            out += '}';
+        out += '\n';
+    }
+
+private:
+    void separate()
+    {
+        if (column > 0)
+            out += ',';
+        if (format == DataExporter::Format::JsonLines) {
+            appendJsonText(out, columns.at(column));
+            out += ':';
+        }
+        column++;
+    }
+
+    QByteArray &out;
+    DataExporter::Format format;
+    const QStringList &columns;
+    int column = 0;
+};
+
+// ================ DataExporter ================
+
+DataExporter::DataExporter(Database *database)
+    : database(database)
+{
+}
+
+DataExporter::Format DataExporter::formatForFile(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return (suffix == "jsonl" || suffix == "json") ? Format::JsonLines : Format::Csv;
+}
+
+QString DataExporter::extension(Format format)
+{
+    return format == Format::JsonLines ? "jsonl" : "csv";
+}
+
+DataExporter::Result DataExporter::exportStudents(const QString &filePath, Format format, const QString &keyword,
+                                                  const ProgressCallback &progress)
+{
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.error = QString("无法写入文件：%1").arg(file.errorString());
+        return result;
+    }
+
+    Progress state;
+    if (keyword.isEmpty())
+        state.totalRows = database->countStudents();
+
+    QSqlQuery query = database->selectStudents(keyword);
+    if (!query.isActive()) {
+        file.cancelWriting();
+        result.error = "查询学生失败";
+        return result;
+    }
+
+    // 成绩列按科目目录排列，与 Database::StudentColumn 的顺序一致
+    static const QStringList columns = []() {
+        QStringList names = {"stu_id", "name", "class"};
+        for (const SubjectInfo &subject : SubjectCatalogue)
+            names << QLatin1String(subject.column);
+        return names << "total" << "average";
+    }();
+
+    QByteArray buffer;
+    buffer.reserve(BufferSize + 4096);
+    if (format == Format::Csv)
+        appendHeader(buffer, columns);
+
+    RowWriter row(buffer, format, columns);
+    bool ok = true;
+
+    while (query.next()) {
+        row.begin();
+        row.add(query.value(Database::ColStuId));
+        row.add(query.value(Database::ColName));
+        row.add(query.value(Database::ColClass));
+        for (int s = 0; s < SubjectCount; s++) {
+            // 负数（默认值 -1）表示未录入，与 NULL 一样导出为空
+            QVariant score = query.value(Database::ColFirstScore + s);
+            row.add((!score.isNull() && score.toDouble() < 0) ? QVariant() : score);
+        }
+        row.add(query.value(Database::ColTotal));
+        row.add(query.value(Database::ColAverage));
+        row.end();
+        result.rowsWritten++;
+
+        if (buffer.size() >= BufferSize) {
+            if (file.write(buffer) != buffer.size()) {
+                ok = false;
+                break;
+            }
+            result.bytesWritten += buffer.size();
+            buffer.resize(0);   // 保留容量，缓冲区只分配一次
+        }
+
+        if (progress && result.rowsWritten % ProgressInterval == 0) {
+            state.rowsWritten = result.rowsWritten;
+            state.bytesWritten = result.bytesWritten;
+            if (!progress(state)) {
+                result.cancelled = true;
+                break;
+            }
+        }
+    }
+    query.finish();
+
+    if (ok && !result.cancelled && !buffer.isEmpty()) {
+        ok = file.write(buffer) == buffer.size();
+        result.bytesWritten += buffer.size();
+    }
+
+    if (!ok) {
+        result.error = QString("写入文件失败：%1").arg(file.errorString());
+    }
+
+    // 取消或失败时不留下写了一半的文件
+    if (!ok || result.cancelled) {
+        file.cancelWriting();
+    } else if (!file.commit()) {
+        result.error = QString("保存文件失败：%1").arg(file.errorString());
+    }
+
+    if (progress) {
+        state.rowsWritten = result.rowsWritten;
+        state.bytesWritten = result.bytesWritten;
+        progress(state);
+    }
+
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+DataExporter::Result DataExporter::exportStatistics(const QString &dirPath, Format format)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QDir dir(dirPath);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        Result result;
+        result.error = QString("无法创建目录：%1").arg(dirPath);
+        return result;
+    }
+
+    const QString ext = extension(format);
+
+    // 所有统计文件来自同一份快照，只扫描一次表
+    const StatisticsSnapshot snapshot = database->getStatisticsSnapshot();
+
+    QStringList classColumns = {"class", "total_students"};
+    for (const SubjectInfo &subject : SubjectCatalogue)
+        classColumns << QString("%1_avg").arg(QLatin1String(subject.column));
+    classColumns << "total_avg";
+    Result total = writeRows(dir.filePath("class_stats." + ext), format, classColumns, snapshot.classStats());
+
+    for (int s = 0; s < SubjectCount; s++) {
+        if (!total.error.isEmpty())
+            break;
+
+        const QString subject = subjectColumn(Subject(s));
+        Result part = writeRows(dir.filePath(QString("subject_stats_%1.%2").arg(subject, ext)), format,
+                                {"class", "count", "avg_score", "max_score", "min_score", "pass_rate",
+                                 "median", "q1", "q3", "stddev", "top10"},
+                                snapshot.subjectStats(Subject(s)));
+        total.rowsWritten += part.rowsWritten;
+        total.bytesWritten += part.bytesWritten;
+        total.error = part.error;
+        if (!total.error.isEmpty())
+            break;
+
+        part = writeRows(dir.filePath(QString("score_distribution_%1.%2").arg(subject, ext)), format,
+                         {"range", "count"}, snapshot.scoreDistribution(Subject(s)));
+        total.rowsWritten += part.rowsWritten;
+        total.bytesWritten += part.bytesWritten;
+        total.error = part.error;
+    }
+
+    total.elapsedMs = timer.elapsed();
+    return total;
+}
+
+DataExporter::Result DataExporter::writeRows(const QString &filePath, Format format, const QStringList &columns,
+                                             const QVector<QMap<QString, QVariant>> &rows)
+{
+    Result result;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.error = QString("无法写入文件：%1").arg(file.errorString());
+        return result;
+    }
+
+    QByteArray buffer;
+    if (format == Format::Csv)
+        appendHeader(buffer, columns);
+
+    RowWriter row(buffer, format, columns);
+    for (const auto &values : rows) {
+        row.begin();
+        for (const QString &column : columns)
+            row.add(values.value(column));
+        row.end();
+        result.rowsWritten++;
+    }
+
+    if (file.write(buffer) != buffer.size() || !file.commit()) {
+        result.error = QString("写入文件失败：%1").arg(file.errorString());
+        return result;
+    }
+
+    result.bytesWritten = buffer.size();
+    return result;
+}
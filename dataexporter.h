@@ -0,0 +1,63 @@
+#ifndef DATAEXPORTER_H
+#define DATAEXPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+#include <QVariant>
+#include <QByteArray>
+#include <functional>
+
+class Database;
+class QFile;
+
+// 数据导出（CSV / JSON Lines）
+// 学生数据用只进查询逐行读取，写入固定大小的缓冲区后整块落盘，内存占用与表的大小无关
+class DataExporter
+{
+public:
+    enum class Format { Csv, JsonLines };
+
+    struct Progress
+    {
+        qint64 rowsWritten = 0;
+        qint64 totalRows = 0;     // 未知时为 0
+        qint64 bytesWritten = 0;
+    };
+
+    struct Result
+    {
+        qint64 rowsWritten = 0;
+        qint64 bytesWritten = 0;
+        QString error;
+        bool cancelled = false;
+        qint64 elapsedMs = 0;
+    };
+
+    // 返回 false 表示取消导出
+    using ProgressCallback = std::function<bool(const Progress &progress)>;
+
+    explicit DataExporter(Database *database);
+
+    // keyword 为空时导出全部学生，否则导出搜索结果
+    Result exportStudents(const QString &filePath, Format format, const QString &keyword = QString(),
+                          const ProgressCallback &progress = ProgressCallback());
+
+    // 在目录中写入 class_stats、各科 subject_stats_<科目> 和 score_distribution_<科目> 文件
+    Result exportStatistics(const QString &dirPath, Format format);
+
+    static Format formatForFile(const QString &filePath);
+    static QString extension(Format format);
+
+    static constexpr int BufferSize = 256 * 1024;
+    static constexpr int ProgressInterval = 10000;   // 每写这么多行报告一次进度
+
+private:
+    Result writeRows(const QString &filePath, Format format, const QStringList &columns,
+                     const QVector<QMap<QString, QVariant>> &rows);
+
+    Database *database;
+};
+
+#endif // DATAEXPORTER_H
@@ -0,0 +1,184 @@
+#include "diagnosticsdialog.h"
+#include "ui_diagnosticsdialog.h"
+#include "database.h"
+#include <QHeaderView>
+#include <QTableWidgetItem>
+#include <QFileDialog>
+#include <QJsonDocument>
+#include <QMessageBox>
+#include <QSaveFile>
+#include <algorithm>
+
+static QTableWidgetItem *numberItem(double value, int precision = 3)
+{
+    auto *item = new QTableWidgetItem(QString::number(value, 'f', precision));
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent, Database *db)
+    : QDialog(parent)
+    , ui(new Ui::DiagnosticsDialog)
+    , database(db)
+{
+    ui->setupUi(this);
+
+    ui->statementTable->setColumnCount(11);
+    ui->statementTable->setHorizontalHeaderLabels({"调用", "次数", "行数", "平均(ms)", "P50", "P95", "P99",
+                                                   "最大", "准备合计", "执行合计", "取数据合计"});
+    ui->slowTable->setColumnCount(5);
+    ui->slowTable->setHorizontalHeaderLabels({"时间", "调用", "耗时(ms)", "行数", "SQL"});
+    for (QTableWidget *table : {ui->statementTable, ui->slowTable}) {
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->verticalHeader()->setVisible(false);
+        table->horizontalHeader()->setStretchLastSection(true);
+    }
+
+    // 先设好初值再显示，避免触发槽函数重复保存设置
+    QueryTracer &tracer = QueryTracer::instance();
+    ui->enabledCheck->blockSignals(true);
+    ui->enabledCheck->setChecked(QueryTracer::isEnabled());
+    ui->enabledCheck->blockSignals(false);
+    ui->thresholdSpin->blockSignals(true);
+    ui->thresholdSpin->setValue(tracer.slowThresholdMs());
+    ui->thresholdSpin->blockSignals(false);
+
+    connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &DiagnosticsDialog::reject);
+
+    on_refreshButton_clicked();
+}
+
+DiagnosticsDialog::~DiagnosticsDialog()
+{
+    delete ui;
+}
+
+void DiagnosticsDialog::on_enabledCheck_toggled(bool checked)
+{
+    QueryTracer::setEnabled(checked);
+    QueryTracer::instance().saveSettings();
+}
+
+void DiagnosticsDialog::on_thresholdSpin_valueChanged(int value)
+{
+    QueryTracer::instance().setSlowThresholdMs(value);
+    QueryTracer::instance().saveSettings();
+}
+
+void DiagnosticsDialog::on_refreshButton_clicked()
+{
+    showStatements();
+    showSlowQueries();
+    showCacheStats();
+}
+
+void DiagnosticsDialog::on_resetButton_clicked()
+{
+    QueryTracer::instance().reset();
+    on_refreshButton_clicked();
+}
+
+void DiagnosticsDialog::on_exportButton_clicked()
+{
+    const QString filePath = QFileDialog::getSaveFileName(this, "导出诊断数据", "diagnostics.json",
+                                                          "JSON 文件 (*.json)");
+    if (filePath.isEmpty())
+        return;
+
+    QJsonObject root = QueryTracer::instance().toJson();
+    if (database) {
+        const StatementCacheStats stats = database->statementCacheStats();
+        QJsonObject cache;
+        cache["hits"] = qint64(stats.hits);
+        cache["misses"] = qint64(stats.misses);
+        cache["statements"] = stats.statements;
+        cache["hit_rate"] = stats.hitRate();
+        root["statement_cache"] = cache;
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson()) < 0 || !file.commit()) {
+        QMessageBox::critical(this, "导出诊断数据", QString("写入文件失败：%1").arg(file.errorString()));
+    }
+}
+
+void DiagnosticsDialog::on_slowTable_currentCellChanged(int currentRow, int, int, int)
+{
+    if (currentRow < 0 || currentRow >= slowQueries.size()) {
+        ui->planText->clear();
+        return;
+    }
+
+    const SlowQuery &slow = slowQueries.at(currentRow);
+    QStringList parameters;
+    for (const QVariant &value : slow.timing.parameters)
+        parameters << (value.isNull() ? QString("NULL") : value.toString());
+
+    QString text = slow.timing.sql + "\n";
+    if (!parameters.isEmpty())
+        text += "参数：" + parameters.join(", ") + "\n";
+    text += QString("准备 %1 ms，执行 %2 ms，取数据 %3 ms\n\n查询计划：\n")
+                .arg(slow.timing.prepareMicros / 1000.0)
+                .arg(slow.timing.execMicros / 1000.0)
+                .arg(slow.timing.fetchMicros / 1000.0);
+    text += slow.plan.join("\n");
+    ui->planText->setPlainText(text);
+}
+
+void DiagnosticsDialog::showStatements()
+{
+    const QMap<QString, StatementProfile> profiles = QueryTracer::instance().profiles();
+    QTableWidget *table = ui->statementTable;
+    table->setRowCount(profiles.size());
+
+    int row = 0;
+    for (auto it = profiles.constBegin(); it != profiles.constEnd(); ++it, ++row) {
+        const StatementProfile &profile = it.value();
+        table->setItem(row, 0, new QTableWidgetItem(it.key()));
+        table->setItem(row, 1, numberItem(profile.latency.count(), 0));
+        table->setItem(row, 2, numberItem(profile.rows, 0));
+        table->setItem(row, 3, numberItem(profile.latency.meanMs()));
+        table->setItem(row, 4, numberItem(profile.latency.percentileMs(0.50)));
+        table->setItem(row, 5, numberItem(profile.latency.percentileMs(0.95)));
+        table->setItem(row, 6, numberItem(profile.latency.percentileMs(0.99)));
+        table->setItem(row, 7, numberItem(profile.latency.maxMs()));
+        table->setItem(row, 8, numberItem(profile.prepareMicros / 1000.0));
+        table->setItem(row, 9, numberItem(profile.execMicros / 1000.0));
+        table->setItem(row, 10, numberItem(profile.fetchMicros / 1000.0));
+    }
+    table->resizeColumnsToContents();
+}
+
+void DiagnosticsDialog::showSlowQueries()
+{
+    // 最近的排在最前
+    slowQueries = QueryTracer::instance().slowQueries();
+    std::reverse(slowQueries.begin(), slowQueries.end());
+
+    QTableWidget *table = ui->slowTable;
+    table->setRowCount(slowQueries.size());
+    for (int row = 0; row < slowQueries.size(); row++) {
+        const SlowQuery &slow = slowQueries.at(row);
+        table->setItem(row, 0, new QTableWidgetItem(slow.time.toString("HH:mm:ss.zzz")));
+        table->setItem(row, 1, new QTableWidgetItem(QString::fromLatin1(slow.timing.name)));
+        table->setItem(row, 2, numberItem(slow.timing.totalMicros() / 1000.0));
+        table->setItem(row, 3, numberItem(slow.timing.rows, 0));
+        table->setItem(row, 4, new QTableWidgetItem(slow.timing.sql.simplified()));
+    }
+    table->resizeColumnsToContents();
+    ui->planText->clear();
+}
+
+void DiagnosticsDialog::showCacheStats()
+{
+    if (!database) {
+        ui->cacheLabel->clear();
+        return;
+    }
+
+    const StatementCacheStats stats = database->statementCacheStats();
+    ui->cacheLabel->setText(QString("预编译语句缓存：%1 条，命中率 %2%")
+                                .arg(stats.statements)
+                                .arg(stats.hitRate() * 100, 0, 'f', 1));
+}
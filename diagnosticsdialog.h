@@ -0,0 +1,40 @@
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+#include "querytracer.h"
+
+class Database;
+
+namespace Ui {
+class DiagnosticsDialog;
+}
+
+// 诊断窗口：各类数据库调用的耗时分布、慢查询及其查询计划
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget *parent = nullptr, Database *db = nullptr);
+    ~DiagnosticsDialog();
+
+private slots:
+    void on_enabledCheck_toggled(bool checked);
+    void on_thresholdSpin_valueChanged(int value);
+    void on_refreshButton_clicked();
+    void on_resetButton_clicked();
+    void on_exportButton_clicked();
+    void on_slowTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn);
+
+private:
+    void showStatements();
+    void showSlowQueries();
+    void showCacheStats();
+
+    Ui::DiagnosticsDialog *ui;
+    Database *database;
+    QVector<SlowQuery> slowQueries;   // 与 slowTable 的行对应
+};
+
+#endif // DIAGNOSTICSDIALOG_H
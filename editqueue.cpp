@@ -0,0 +1,154 @@
+#include "editqueue.h"
+#include "asyncdatabase.h"
+#include <QSet>
+#include <QDebug>
+
+EditQueue::EditQueue(AsyncDatabase *database, QObject *parent)
+    : QObject(parent)
+    , database(database)
+{
+    idleTimer.setSingleShot(true);
+    idleTimer.setInterval(IdleFlushMs);
+    delayTimer.setSingleShot(true);
+    delayTimer.setInterval(MaxDelayMs);
+    connect(&idleTimer, &QTimer::timeout, this, &EditQueue::flush);
+    connect(&delayTimer, &QTimer::timeout, this, &EditQueue::flush);
+}
+
+// 每次修改都重新开始计算停顿；最长等待从这一批的第一次修改算起，连续输入时也会按时写回
+StudentEdit &EditQueue::editFor(int id)
+{
+    idleTimer.start();
+    if (!delayTimer.isActive())
+        delayTimer.start();
+
+    StudentEdit &edit = pending[id];
+    edit.id = id;
+    return edit;
+}
+
+void EditQueue::setName(int id, const QString &name)
+{
+    StudentEdit &edit = editFor(id);
+    edit.name = name;
+    edit.fields |= StudentEdit::NameField;
+}
+
+void EditQueue::setClassName(int id, const QString &className)
+{
+    StudentEdit &edit = editFor(id);
+    edit.className = className;
+    edit.fields |= StudentEdit::ClassField;
+}
+
+void EditQueue::setScore(int id, Subject subject, float score)
+{
+    StudentEdit &edit = editFor(id);
+    edit.scores[int(subject)] = score;
+    edit.fields |= StudentEdit::ScoreField << int(subject);
+}
+
+int EditQueue::pendingCount() const
+{
+    QSet<int> ids;
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it)
+        ids.insert(it.key());
+    for (const QHash<int, StudentEdit> &batch : inFlight) {
+        for (auto it = batch.constBegin(); it != batch.constEnd(); ++it)
+            ids.insert(it.key());
+    }
+    return ids.size();
+}
+
+void EditQueue::overlay(StudentTable &table) const
+{
+    if (pending.isEmpty() && inFlight.isEmpty())
+        return;
+
+    for (int row = 0; row < table.size(); row++) {
+        const int id = table.id(row);
+        // 先套用较早提交的批次，再套用队列中最新的修改
+        QVector<const StudentEdit *> edits;
+        for (const QHash<int, StudentEdit> &batch : inFlight) {
+            auto it = batch.constFind(id);
+            if (it != batch.constEnd())
+                edits << &it.value();
+        }
+        auto it = pending.constFind(id);
+        if (it != pending.constEnd())
+            edits << &it.value();
+        if (edits.isEmpty())
+            continue;
+
+        QString name = table.name(row);
+        QString className = table.className(row);
+        float scores[SubjectCount];
+        table.scoreMatrix().rowScores(row, scores);
+        for (const StudentEdit *edit : edits)
+            edit->applyTo(&name, &className, scores);
+
+        float total = 0;
+        float average = 0;
+        StudentTable::totalsOf(scores, &total, &average);
+        StudentTable edited;
+        edited.append(id, table.stuId(row), name, className, scores, total, average);
+        table.replaceRow(row, edited, 0);
+    }
+}
+
+QFuture<StudentEditResult> EditQueue::flush()
+{
+    idleTimer.stop();
+    delayTimer.stop();
+    if (pending.isEmpty())
+        return lastFlush;
+
+    QVector<StudentEdit> edits;
+    edits.reserve(pending.size());
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it)
+        edits << it.value();
+    const int batch = nextBatch++;
+    inFlight.insert(batch, pending);
+    pending.clear();
+
+    // 各批按批号对应结果，不依赖完成的先后；任务被取消时不会有结果，这一批原样放回队列
+    lastFlush = database->applyStudentEdits(edits);
+    lastFlush.then(this, [this, batch](StudentEditResult result) {
+        finishFlush(batch, result);
+    }).onCanceled(this, [this, batch]() {
+        qDebug() << "写回任务被取消，修改放回队列";
+        requeue(batch);
+    });
+    return lastFlush;
+}
+
+void EditQueue::finishFlush(int batch, const StudentEditResult &result)
+{
+    // 整批失败（例如数据库被其他程序锁住）：放回队列稍后重试
+    if (!result.ok) {
+        qDebug() << "写回" << inFlight.value(batch).size() << "名学生的修改失败，稍后重试";
+        requeue(batch);
+        return;
+    }
+
+    // 写回期间界面上又改过的字段仍以界面为准，等下一批写入
+    inFlight.remove(batch);
+    StudentTable rows = result.rows;
+    overlay(rows);
+    emit flushed(rows, result.errors);
+}
+
+// 没有写入的一批放回队列，期间又有修改的字段以新值为准
+void EditQueue::requeue(int batch)
+{
+    const QHash<int, StudentEdit> edits = inFlight.take(batch);
+    for (auto it = edits.constBegin(); it != edits.constEnd(); ++it) {
+        StudentEdit edit = it.value();
+        auto newer = pending.constFind(it.key());
+        if (newer != pending.constEnd())
+            edit.merge(newer.value());
+        pending.insert(it.key(), edit);
+    }
+    if (!pending.isEmpty() && !delayTimer.isActive())
+        delayTimer.start();
+}
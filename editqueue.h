@@ -0,0 +1,62 @@
+#ifndef EDITQUEUE_H
+#define EDITQUEUE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <QTimer>
+#include "database.h"
+
+class AsyncDatabase;
+
+// 表格中就地修改的写回队列
+// 修改先记在内存中，同一名学生同一字段的多次修改只保留最后一次；输入停顿 IdleFlushMs，
+// 或最早一次修改已等待 MaxDelayMs 时，把积攒的修改交给写线程一次写入
+// 界面上的按键不等待数据库，修改在写回提交之后才落盘
+class EditQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EditQueue(AsyncDatabase *database, QObject *parent = nullptr);
+
+    static constexpr int IdleFlushMs = 500;
+    static constexpr int MaxDelayMs = 3000;
+
+    // 记下学生 id 的一项修改；score 为 NaN 表示清除成绩
+    void setName(int id, const QString &name);
+    void setClassName(int id, const QString &className);
+    void setScore(int id, Subject subject, float score);
+
+    // 还没有写入数据库的学生数，包括正在写入的
+    int pendingCount() const;
+
+    // 把还没有写入数据库的修改套用到从数据库读出的行上，例如分页模式下重新读取的页
+    void overlay(StudentTable &table) const;
+
+    // 立即把积攒的修改交给写线程；写线程上之后排队的装载、查询都能读到这些修改
+    // 需要在读连接上看到修改时（统计、导出），等待返回的 QFuture 完成
+    // 没有新的修改时返回上一批的 QFuture；写线程按顺序执行，它完成时之前的各批都已写入
+    QFuture<StudentEditResult> flush();
+
+signals:
+    // 一批修改写入完成：rows 为各行在数据库中的值（之后又有修改的字段已套用新值），errors 为失败学生的 id 和原因
+    void flushed(const StudentTable &rows, const QVector<QPair<int, QString>> &errors);
+
+private:
+    StudentEdit &editFor(int id);
+    void finishFlush(int batch, const StudentEditResult &result);
+    void requeue(int batch);
+
+    AsyncDatabase *database;
+    QHash<int, StudentEdit> pending;                  // 按学生 id
+    QMap<int, QHash<int, StudentEdit>> inFlight;      // 已交给写线程、还没有结果的各批，按批号即提交顺序
+    int nextBatch = 0;
+    QFuture<StudentEditResult> lastFlush;
+    QTimer idleTimer;
+    QTimer delayTimer;
+};
+
+#endif // EDITQUEUE_H
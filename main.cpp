@@ -1,14 +1,23 @@
 #include "mainwindow.h"
+#include "reportrunner.h"
+#include "querytracer.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    // 命令行统计模式：不创建 QApplication 和任何窗口
+    if (ReportRunner::isReportCommand(argc, argv))
+        return ReportRunner::run(argc, argv);
+
     QApplication app(argc, argv);
 
     // 设置应用程序信息
     app.setApplicationName("学生成绩分析系统");
     app.setOrganizationName("School");
 
+    // 查询计时默认关闭，可在诊断窗口中打开
+    QueryTracer::instance().loadSettings();
+
     MainWindow window;
     window.show();
 
@@ -2,12 +2,20 @@
 #include "ui_mainwindow.h"
 #include "addstudentdialog.h"
 #include "statisticsdialog.h"
+#include "diagnosticsdialog.h"
+#include "scoredelegate.h"
 #include <QMessageBox>
 #include <QInputDialog>
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QHeaderView>
+#include <QApplication>
+#include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , searchCache(SearchCacheMaxRows)
 {
     ui->setupUi(this);
 
@@ -17,6 +25,11 @@ MainWindow::MainWindow(QWidget *parent)
         return;
     }
 
+    // 后台查询使用独立的连接，大查询不再阻塞界面
+    asyncDb = new AsyncDatabase(db.connectionProfile(), this);
+    // 表格中就地修改的内容积攒一小段时间再一次写回
+    editQueue = new EditQueue(asyncDb, this);
+
     // 初始化模型
     studentModel = new StudentModel(this);
     ui->tableView->setModel(studentModel);
@@ -25,19 +38,112 @@ MainWindow::MainWindow(QWidget *parent)
     ui->tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
     ui->tableView->setSelectionMode(QAbstractItemView::SingleSelection);
     ui->tableView->setAlternatingRowColors(true);
+    // 自动列宽只取样前若干行，否则表很大时每次调整都要遍历所有行
+    ui->tableView->horizontalHeader()->setResizeContentsPrecision(ResizeSampleRows);
     ui->tableView->resizeColumnsToContents();
+    // 点击表头排序，再点一次切换升降序；排序标记可以清除，回到默认顺序
+    // 先清掉排序标记再打开排序，否则打开时会立即按第一列排序
+    ui->tableView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    ui->tableView->horizontalHeader()->setSortIndicatorClearable(true);
+    ui->tableView->setSortingEnabled(true);
+    // 选中单元格后直接输入或按 F2 修改；双击仍用来查看学生详情
+    studentModel->setEditQueue(editQueue);
+    ui->tableView->setEditTriggers(QAbstractItemView::EditKeyPressed | QAbstractItemView::AnyKeyPressed);
+    ScoreDelegate *scoreDelegate = new ScoreDelegate(this);
+    for (int s = 0; s < SubjectCount; s++)
+        ui->tableView->setItemDelegateForColumn(StudentModel::scoreColumn(Subject(s)), scoreDelegate);
 
     // 连接信号槽
     connect(ui->tableView->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &MainWindow::updateStatusBar);
 
+    // 分页模式下新添加的学生确定位置后再选中
+    connect(studentModel, &StudentModel::studentPlaced, this, [this](int id, int row) {
+        if (id == placedStudentId) {
+            placedStudentId = -1;
+            ui->tableView->selectRow(row);
+            ui->tableView->scrollTo(studentModel->index(row, 0));
+        }
+        updateStatusBar();
+    });
+
+    // 分页模式下各页在读线程上读取，第一页读到之后再按内容调整列宽
+    connect(studentModel, &StudentModel::firstPageLoaded, this, [this]() {
+        ui->tableView->resizeColumnsToContents();
+    });
+
+    // 后台查询每返回一块就追加到表格中
+    connect(&tableWatcher, &QFutureWatcher<StudentTable>::resultsReadyAt,
+            this, [this](int begin, int end) {
+        bool firstChunk = studentModel->rowCount() == 0;
+        for (int i = begin; i < end; i++) {
+            studentModel->appendStudents(tableWatcher.resultAt(i));
+        }
+        if (firstChunk) {
+            ui->tableView->resizeColumnsToContents();
+        }
+        updateStatusBar();
+    });
+    connect(&tableWatcher, &QFutureWatcher<StudentTable>::finished, this, [this]() {
+        // 逐块追加的行在末尾，装载完成后按当前排序重排一次
+        studentModel->resort();
+        if (!activeSearchKeyword.isEmpty() && !tableWatcher.isCanceled()) {
+            // 完整的搜索结果放入缓存，之后退格或继续输入时可直接使用
+            const StudentTable &result = studentModel->students();
+            searchCache.insert(activeSearchKeyword.toCaseFolded(), new StudentTable(result), result.size() + 1);
+            activeSearchKeyword.clear();
+            finishSearch("数据库");
+            return;
+        }
+        updateStatusBar();
+    });
+
+    // 写回完成后换成数据库中的值（总分、平均分，以及失败时的原值）
+    connect(editQueue, &EditQueue::flushed, this,
+            [this](const StudentTable &rows, const QVector<QPair<int, QString>> &errors) {
+        studentModel->refreshStudents(rows);
+        invalidateSearchCache();
+        if (errors.isEmpty()) {
+            ui->statusbar->showMessage(QString("已保存 %1 名学生的修改").arg(rows.size()), 3000);
+            return;
+        }
+
+        QStringList lines;
+        for (const auto &error : errors) {
+            QString stuId = QString::number(error.first);
+            for (int i = 0; i < rows.size(); i++) {
+                if (rows.id(i) == error.first)
+                    stuId = rows.stuId(i);
+            }
+            lines << QString("%1：%2").arg(stuId, error.second);
+        }
+        QMessageBox::warning(this, "保存修改", QString("%1 名学生的修改未能保存，已恢复原值：\n%2")
+                                                  .arg(errors.size()).arg(lines.join("\n")));
+    });
+
+    // 输入停顿一小段时间后再搜索，避免每个按键都查询一次
+    searchDebounce.setSingleShot(true);
+    searchDebounce.setInterval(SearchDebounceMs);
+    connect(&searchDebounce, &QTimer::timeout, this, [this]() {
+        runSearch(ui->searchEdit->text().trimmed());
+    });
+
+    // 其他程序修改数据库后，表格只更新变化的学生，不必手动刷新
+    changePoll.setInterval(ChangePollMs);
+    connect(&changePoll, &QTimer::timeout, this, &MainWindow::checkExternalChanges);
+
     // 加载数据
     loadStudentData();
+    loadRankIndex();
     setupUI();
+    changePoll.start();
 }
 
 MainWindow::~MainWindow()
 {
+    // 还没写回的修改交给写线程，连接池析构时等待写完
+    if (editQueue)
+        editQueue->flush();
     delete ui;
 }
 
@@ -52,24 +158,244 @@ void MainWindow::setupUI()
 
 void MainWindow::loadStudentData()
 {
-    QVector<QMap<QString, QVariant>> students = db.getAllStudents();
-    studentModel->setData(students);
-    ui->tableView->resizeColumnsToContents();
+    saveEdits();
+
+    // 学生总数在读线程上统计；数据量大时改用分页模式，避免一次性把整张表读入内存
+    const int request = ++tableRequest;
+    countingStudents = true;
+    asyncDb->countStudents().then(this, [this, request](int count) {
+        // 统计期间又开始了新的装载或搜索
+        if (request != tableRequest)
+            return;
+        countingStudents = false;
+        showStudents(count);
+    });
+}
+
+// count 为读线程上统计的学生总数
+void MainWindow::showStudents(int count)
+{
+    if (count > PagedModeThreshold) {
+        resetChangeBaseline();
+        tableWatcher.cancel();
+        tableWatcher.setFuture(QFuture<StudentTable>());
+        // 第一页在读线程上读取，读到之后由 firstPageLoaded 按内容调整列宽
+        studentModel->setPagedSource(&db, count, asyncDb);
+        updateStatusBar();
+    } else {
+        startTableLoad(asyncDb->getAllStudents());
+    }
+}
+
+void MainWindow::startTableLoad(const QFuture<StudentTable> &future)
+{
+    // 取消上一次还没读完的请求，表格从空开始逐块填充
+    tableWatcher.cancel();
+    activeSearchKeyword.clear();
+    resetChangeBaseline();
+    studentModel->setStudents(StudentTable());
+    tableWatcher.setFuture(future);
+    updateStatusBar();
+}
+
+// 排名索引覆盖整个数据库，只在数据可能整体变化时（启动、刷新、导入）重新建立
+// 单个学生的增删改由模型在局部更新时同步到索引
+void MainWindow::loadRankIndex()
+{
+    saveEdits();
+    asyncDb->getRankIndex().then(this, [this](RankIndex index) {
+        studentModel->setRankIndex(std::move(index));
+    });
 }
 
 void MainWindow::updateStatusBar()
 {
     int total = studentModel->rowCount();
     int selected = ui->tableView->selectionModel()->selectedRows().size();
-    ui->statusbar->showMessage(QString("共 %1 名学生 | 选中 %2 名").arg(total).arg(selected));
+    QString message = QString("共 %1 名学生 | 选中 %2 名").arg(total).arg(selected);
+    if (tableWatcher.isRunning()) {
+        message += " | 正在加载...";
+    }
+    if (!lastSearchInfo.isEmpty()) {
+        message += " | " + lastSearchInfo;
+    }
+    ui->statusbar->showMessage(message);
 }
 
 void MainWindow::on_actionAdd_triggered()
 {
-    AddStudentDialog dialog(this, &db);
-    if (dialog.exec() == QDialog::Accepted) {
-        loadStudentData();
+    saveEdits();
+    AddStudentDialog dialog(this, asyncDb);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    invalidateSearchCache();
+
+    // 显示搜索结果或仍在装载时无法确定新行的位置，重新查询
+    const StudentTable &inserted = dialog.insertedStudent();
+    const QString keyword = ui->searchEdit->text().trimmed();
+    if (inserted.isEmpty() || tableWatcher.isRunning() || countingStudents || !keyword.isEmpty()) {
+        runSearch(keyword);
+        loadRankIndex();
+        return;
     }
+
+    // 只把新行插入到排序后的位置，保留滚动位置，不必重新读取整张表
+    int row = studentModel->insertStudent(inserted, 0);
+    if (row == StudentModel::RowPending) {
+        // 分页模式下位置在读线程上计数，插入后由 studentPlaced 选中
+        placedStudentId = inserted.id(0);
+        return;
+    }
+    ui->tableView->selectRow(row);
+    ui->tableView->scrollTo(studentModel->index(row, 0));
+    updateStatusBar();
+}
+
+void MainWindow::on_actionImport_triggered()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, "导入学生成绩", QString(),
+                                                    "CSV 文件 (*.csv);;所有文件 (*)");
+    if (filePath.isEmpty()) return;
+    saveEdits();
+
+    QProgressDialog *progressDialog = new QProgressDialog("正在导入...", "取消", 0, 1000, this);
+    progressDialog->setWindowTitle("导入CSV");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+
+    auto *watcher = new QFutureWatcher<CsvImporter::Result>(this);
+    connect(watcher, &QFutureWatcher<CsvImporter::Result>::progressValueChanged,
+            progressDialog, &QProgressDialog::setValue);
+    connect(watcher, &QFutureWatcher<CsvImporter::Result>::progressTextChanged,
+            progressDialog, &QProgressDialog::setLabelText);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcher<CsvImporter::Result>::cancel);
+    connect(watcher, &QFutureWatcher<CsvImporter::Result>::finished, this, [this, watcher, progressDialog]() {
+        progressDialog->close();
+        progressDialog->deleteLater();
+        watcher->deleteLater();
+
+        invalidateSearchCache();
+        loadStudentData();
+        loadRankIndex();
+
+        if (watcher->isCanceled() || watcher->future().resultCount() == 0) {
+            QMessageBox::information(this, "导入CSV", "导入已取消，已写入的批次会保留。");
+            return;
+        }
+
+        const CsvImporter::Result result = watcher->result();
+        if (!result.fatalError.isEmpty()) {
+            QMessageBox::critical(this, "导入CSV", result.fatalError);
+            return;
+        }
+
+        QString message = QString("读取 %1 行，成功导入 %2 行，耗时 %3 秒。")
+                              .arg(result.rowsRead)
+                              .arg(result.rowsImported)
+                              .arg(result.elapsedMs / 1000.0, 0, 'f', 1);
+        if (!result.errors.isEmpty()) {
+            message += QString("\n\n%1 行未导入，前几条错误：").arg(result.rowsRead - result.rowsImported);
+            for (int i = 0; i < result.errors.size() && i < 10; i++) {
+                message += QString("\n第 %1 行：%2").arg(result.errors[i].line).arg(result.errors[i].message);
+            }
+        }
+        QMessageBox::information(this, "导入CSV", message);
+    });
+
+    watcher->setFuture(asyncDb->importCsv(filePath));
+}
+
+void MainWindow::on_actionExportStudents_triggered()
+{
+    // 有搜索关键字时只导出搜索结果
+    QString keyword = ui->searchEdit->text().trimmed();
+
+    QString filePath = QFileDialog::getSaveFileName(this, keyword.isEmpty() ? "导出全部学生" : "导出搜索结果",
+                                                    "students.csv",
+                                                    "CSV 文件 (*.csv);;JSON Lines 文件 (*.jsonl)");
+    if (filePath.isEmpty()) return;
+
+    QProgressDialog *progressDialog = new QProgressDialog("正在导出...", "取消", 0, 0, this);
+    progressDialog->setWindowTitle("导出学生");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(500);
+
+    auto *watcher = new QFutureWatcher<DataExporter::Result>(this);
+    connect(watcher, &QFutureWatcher<DataExporter::Result>::progressRangeChanged,
+            progressDialog, &QProgressDialog::setRange);
+    connect(watcher, &QFutureWatcher<DataExporter::Result>::progressValueChanged,
+            progressDialog, &QProgressDialog::setValue);
+    connect(watcher, &QFutureWatcher<DataExporter::Result>::progressTextChanged,
+            progressDialog, &QProgressDialog::setLabelText);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcher<DataExporter::Result>::cancel);
+    connect(watcher, &QFutureWatcher<DataExporter::Result>::finished, this, [this, watcher, progressDialog]() {
+        progressDialog->close();
+        progressDialog->deleteLater();
+        watcher->deleteLater();
+
+        if (watcher->isCanceled() || watcher->future().resultCount() == 0) {
+            QMessageBox::information(this, "导出学生", "导出已取消。");
+            return;
+        }
+
+        const DataExporter::Result result = watcher->result();
+        if (!result.error.isEmpty()) {
+            QMessageBox::critical(this, "导出学生", result.error);
+            return;
+        }
+
+        ui->statusbar->showMessage(QString("已导出 %1 行（%2 KB，耗时 %3 ms）")
+                                       .arg(result.rowsWritten)
+                                       .arg(result.bytesWritten / 1024)
+                                       .arg(result.elapsedMs), 5000);
+    });
+
+    afterEditsSaved([this, watcher, filePath, keyword]() {
+        watcher->setFuture(asyncDb->exportStudents(filePath, DataExporter::formatForFile(filePath), keyword));
+    });
+}
+
+void MainWindow::on_actionExportStats_triggered()
+{
+    QString dirPath = QFileDialog::getExistingDirectory(this, "选择导出目录");
+    if (dirPath.isEmpty()) return;
+
+    QMessageBox::StandardButton format = QMessageBox::question(this, "导出统计", "以 JSON Lines 格式导出？\n选择“否”则导出为 CSV。",
+                                                               QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+    if (format == QMessageBox::Cancel) return;
+
+    const DataExporter::Format exportFormat = format == QMessageBox::Yes ? DataExporter::Format::JsonLines
+                                                                         : DataExporter::Format::Csv;
+    afterEditsSaved([this, dirPath, exportFormat]() {
+        asyncDb->exportStatistics(dirPath, exportFormat)
+            .then(this, [this, dirPath](const DataExporter::Result &result) {
+                if (!result.error.isEmpty()) {
+                    QMessageBox::critical(this, "导出统计", result.error);
+                } else {
+                    QMessageBox::information(this, "导出统计", QString("统计结果已导出到 %1").arg(dirPath));
+                }
+            });
+    });
+}
+
+void MainWindow::on_actionRecordExam_triggered()
+{
+    // 把当前成绩保存为一次考试，统计分析中的趋势按历次考试比较
+    const QDate date = QDate::currentDate();
+    bool ok = false;
+    const QString name = QInputDialog::getText(this, "记录考试", "考试名称：", QLineEdit::Normal,
+                                               QString("%1 考试").arg(date.toString("yyyy-MM-dd")), &ok).trimmed();
+    if (!ok || name.isEmpty()) return;
+
+    saveEdits();
+    asyncDb->recordExam(name, date).then(this, [this, name](int examId) {
+        if (examId < 0) {
+            QMessageBox::critical(this, "记录考试", "记录考试失败！");
+            return;
+        }
+        ui->statusbar->showMessage(QString("已记录考试“%1”").arg(name), 5000);
+    });
 }
 
 void MainWindow::on_actionDelete_triggered()
@@ -81,32 +407,53 @@ void MainWindow::on_actionDelete_triggered()
     }
 
     int row = selected.first().row();
-    QMap<QString, QVariant> student = studentModel->getStudent(row);
-    QString stuId = student["stu_id"].toString();
-    QString name = student["name"].toString();
+    StudentRecord student = studentModel->getStudent(row);
+    QString stuId = student.stuId();
+    QString name = student.name();
 
     int ret = QMessageBox::question(this, "确认删除",
                                     QString("确定要删除学生 %1 (%2) 吗？").arg(name).arg(stuId),
                                     QMessageBox::Yes | QMessageBox::No);
 
     if (ret == QMessageBox::Yes) {
-        if (db.deleteStudent(stuId)) {
-            loadStudentData();
-            QMessageBox::information(this, "成功", "学生删除成功！");
-        } else {
-            QMessageBox::critical(this, "错误", "删除失败！");
-        }
+        saveEdits();
+        pendingDeletes++;
+        asyncDb->deleteStudent(stuId).then(this, [this, row, stuId](bool ok) {
+            pendingDeletes--;
+            if (ok) {
+                invalidateSearchCache();
+                // 只删除表格中对应的一行；找不到时才重新装载
+                if (!studentModel->removeStudent(row, stuId)) {
+                    runSearch(ui->searchEdit->text().trimmed());
+                    loadRankIndex();
+                }
+                updateStatusBar();
+                QMessageBox::information(this, "成功", "学生删除成功！");
+            } else {
+                QMessageBox::critical(this, "错误", "删除失败！");
+            }
+        });
     }
 }
 
 void MainWindow::on_actionRefresh_triggered()
 {
+    invalidateSearchCache();
     loadStudentData();
+    loadRankIndex();
 }
 
 void MainWindow::on_actionStatistics_triggered()
 {
-    StatisticsDialog dialog(this, &db);
+    afterEditsSaved([this]() {
+        StatisticsDialog dialog(this, &db, asyncDb);
+        dialog.exec();
+    });
+}
+
+void MainWindow::on_actionDiagnostics_triggered()
+{
+    DiagnosticsDialog dialog(this, &db);
     dialog.exec();
 }
 
@@ -117,21 +464,176 @@ void MainWindow::on_actionExit_triggered()
 
 void MainWindow::on_searchButton_clicked()
 {
-    QString keyword = ui->searchEdit->text().trimmed();
+    searchDebounce.stop();
+    runSearch(ui->searchEdit->text().trimmed());
+}
+
+void MainWindow::on_clearButton_clicked()
+{
+    searchDebounce.stop();
+    ui->searchEdit->clear();
+    lastSearchInfo.clear();
+    loadStudentData();
+}
+
+void MainWindow::on_searchEdit_textEdited(const QString &text)
+{
+    Q_UNUSED(text);
+    searchDebounce.start();
+}
+
+void MainWindow::runSearch(const QString &keyword)
+{
+    saveEdits();
+    searchTimer.start();
+    ++tableRequest;
+    countingStudents = false;
+
     if (keyword.isEmpty()) {
+        lastSearchInfo.clear();
         loadStudentData();
         return;
     }
 
-    QVector<QMap<QString, QVariant>> students = db.searchStudents(keyword);
-    studentModel->setData(students);
+    const QString key = keyword.toCaseFolded();
+
+    // 1. 最近搜索过的关键字直接取缓存（例如退格时）
+    if (StudentTable *cached = searchCache.object(key)) {
+        tableWatcher.cancel();
+        activeSearchKeyword.clear();
+        studentModel->setStudents(*cached);
+        finishSearch("缓存");
+        return;
+    }
+
+    // 2. 新关键字包含某个已缓存的关键字时，结果一定是其子集，在内存中筛选即可
+    QString narrowFrom;
+    const QList<QString> cachedKeys = searchCache.keys();
+    for (const QString &cachedKey : cachedKeys) {
+        if (key.contains(cachedKey) && cachedKey.size() > narrowFrom.size())
+            narrowFrom = cachedKey;
+    }
+    if (!narrowFrom.isEmpty()) {
+        StudentTable *result = new StudentTable(searchCache.object(narrowFrom)->filtered(keyword));
+        tableWatcher.cancel();
+        activeSearchKeyword.clear();
+        studentModel->setStudents(*result);
+        searchCache.insert(key, result, result->size() + 1);
+        finishSearch("筛选");
+        return;
+    }
+
+    // 3. 否则到数据库中搜索，旧的搜索会被取消
+    startTableLoad(asyncDb->searchStudents(keyword));
+    activeSearchKeyword = keyword;
+}
+
+void MainWindow::finishSearch(const QString &source)
+{
+    lastSearchInfo = QString("搜索耗时 %1 ms（%2）").arg(searchTimer.elapsed()).arg(source);
     updateStatusBar();
 }
 
-void MainWindow::on_clearButton_clicked()
+// 把表格中还没写回的修改交给写线程；写线程上之后排队的装载、搜索、增删按顺序执行，能读到这些修改
+void MainWindow::saveEdits()
 {
-    ui->searchEdit->clear();
-    loadStudentData();
+    if (editQueue->pendingCount() == 0)
+        return;
+
+    // 搜索缓存中的结果是修改之前的值
+    invalidateSearchCache();
+    editQueue->flush();
+}
+
+// 统计、导出在读连接上与写线程并发，要等写回完成才能读到修改
+// 不在界面线程上等待：写回结束后再执行 action；写回被取消时修改已放回队列，照常执行
+void MainWindow::afterEditsSaved(const std::function<void()> &action)
+{
+    if (editQueue->pendingCount() == 0) {
+        action();
+        return;
+    }
+
+    invalidateSearchCache();
+    editQueue->flush()
+        .then(this, [action](const StudentEditResult &) { action(); })
+        .onCanceled(this, [action]() { action(); });
+}
+
+void MainWindow::invalidateSearchCache()
+{
+    searchCache.clear();
+}
+
+// 装载之前记下数据库的版本和变更序号，之后的变化都在表格中增量应用
+// 装载读到的快照可能已包含其中一部分变化，再应用一次结果相同
+void MainWindow::resetChangeBaseline()
+{
+    lastDataVersion = db.dataVersion();
+    lastChangeSeq = db.lastChangeSeq();
+    changeBaseline++;
+}
+
+// data_version 只看文件头，每秒查看一次几乎没有开销；有变化时才在读线程上读取变更记录和对应的学生
+// 本程序写线程上的修改同样会改变版本号，这些记录由 AsyncDatabase 跳过，不会再读一遍
+void MainWindow::checkExternalChanges()
+{
+    // 正在装载、等待搜索或对话框打开期间不动表格，变化留到之后处理
+    if (changeCheckRunning || tableWatcher.isRunning() || countingStudents || searchDebounce.isActive()
+        || pendingDeletes > 0 || QApplication::activeModalWidget())
+        return;
+
+    const int version = db.dataVersion();
+    if (version < 0 || version == lastDataVersion)
+        return;
+
+    changeCheckRunning = true;
+    const int baseline = changeBaseline;
+    asyncDb->getExternalChanges(lastChangeSeq, MaxDeltaStudents).then(this, [this, version, baseline](ExternalChanges changes) {
+        changeCheckRunning = false;
+        // 读取期间重新装载过，装载的结果已包含这些变化
+        if (baseline != changeBaseline)
+            return;
+        lastDataVersion = version;
+        applyExternalChanges(changes);
+    });
+}
+
+void MainWindow::applyExternalChanges(ExternalChanges &changes)
+{
+    if (!changes.ok) {
+        reloadAfterExternalChange();
+        return;
+    }
+    lastChangeSeq = changes.lastSeq;
+    if (changes.ids.isEmpty())
+        return;   // 只有本程序自己的修改，或例如只记录了一次考试，学生表没有变化
+
+    // 读出的是数据库中的值，表格中还没写回的修改仍以界面为准
+    const QVector<int> &ids = changes.ids;
+    StudentTable &rows = changes.rows;
+    editQueue->overlay(rows);
+    invalidateSearchCache();
+
+    const bool showingAll = ui->searchEdit->text().trimmed().isEmpty();
+    bool ranksStale = false;
+    if (!studentModel->applyChanges(ids, rows, showingAll, &ranksStale)) {
+        reloadAfterExternalChange();
+        return;
+    }
+    if (ranksStale)
+        loadRankIndex();
+    qDebug() << "外部修改：增量刷新" << ids.size() << "名学生";
+    updateStatusBar();
+}
+
+// 变更记录不可用、已被清理、变化太多，或分页模式下变化的学生不在缓存的页中
+void MainWindow::reloadAfterExternalChange()
+{
+    qDebug() << "外部修改无法增量刷新，重新装载";
+    invalidateSearchCache();
+    runSearch(ui->searchEdit->text().trimmed());
+    loadRankIndex();
 }
 
 void MainWindow::on_tableView_doubleClicked(const QModelIndex &index)
@@ -139,25 +641,26 @@ void MainWindow::on_tableView_doubleClicked(const QModelIndex &index)
     if (!index.isValid()) return;
 
     int row = index.row();
-    QMap<QString, QVariant> student = studentModel->getStudent(row);
+    StudentRecord student = studentModel->getStudent(row);
+    if (!student.isValid()) return;
+
+    auto scoreText = [&student](Subject subject) {
+        return student.hasScore(subject) ? QString::number(student.score(subject)) : QString("未录入");
+    };
 
     QString info = QString("学生信息：\n"
                            "学号：%1\n"
                            "姓名：%2\n"
-                           "班级：%3\n"
-                           "语文：%4\n"
-                           "数学：%5\n"
-                           "英语：%6\n"
-                           "总分：%7\n"
-                           "平均分：%8")
-                       .arg(student["stu_id"].toString())
-                       .arg(student["name"].toString())
-                       .arg(student["class"].toString())
-                       .arg(student["chinese"].isNull() ? "未录入" : student["chinese"].toString())
-                       .arg(student["math"].isNull() ? "未录入" : student["math"].toString())
-                       .arg(student["english"].isNull() ? "未录入" : student["english"].toString())
-                       .arg(student["total"].toString())
-                       .arg(student["average"].toString());
+                           "班级：%3\n")
+                       .arg(student.stuId())
+                       .arg(student.name())
+                       .arg(student.className());
+    for (int s = 0; s < SubjectCount; s++)
+        info += QString("%1：%2\n").arg(subjectName(Subject(s)), scoreText(Subject(s)));
+    info += QString("总分：%1\n"
+                    "平均分：%2")
+                .arg(QString::number(student.total()))
+                .arg(QString::number(student.average()));
 
     QMessageBox::information(this, "学生详情", info);
 }
@@ -3,8 +3,15 @@
 
 #include <QMainWindow>
 #include <QItemSelection>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QCache>
+#include <QElapsedTimer>
+#include <functional>
 #include "database.h"
+#include "asyncdatabase.h"
 #include "studentmodel.h"
+#include "editqueue.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -21,14 +28,20 @@ public:
 private slots:
     // 菜单栏动作
     void on_actionAdd_triggered();
+    void on_actionImport_triggered();
+    void on_actionExportStudents_triggered();
+    void on_actionExportStats_triggered();
+    void on_actionRecordExam_triggered();
     void on_actionDelete_triggered();
     void on_actionRefresh_triggered();
     void on_actionStatistics_triggered();
+    void on_actionDiagnostics_triggered();
     void on_actionExit_triggered();
 
     // 工具栏按钮
     void on_searchButton_clicked();
     void on_clearButton_clicked();
+    void on_searchEdit_textEdited(const QString &text);
 
     // 其他
     void on_tableView_doubleClicked(const QModelIndex &index);
@@ -36,11 +49,54 @@ private slots:
 private:
     void setupUI();
     void loadStudentData();
+    void showStudents(int count);
+    void startTableLoad(const QFuture<StudentTable> &future);
+    void loadRankIndex();
+    void saveEdits();
+    void afterEditsSaved(const std::function<void()> &action);
     void updateStatusBar();
 
+    // 即时搜索
+    void runSearch(const QString &keyword);
+    void finishSearch(const QString &source);
+    void invalidateSearchCache();
+
+    // 外部修改检测：定时查看数据库是否被其他连接修改，只刷新变化的学生
+    void checkExternalChanges();
+    void applyExternalChanges(ExternalChanges &changes);
+    void resetChangeBaseline();
+    void reloadAfterExternalChange();
+
+    // 学生数超过该值时主表格使用分页模式
+    static constexpr int PagedModeThreshold = 100000;
+    static constexpr int SearchDebounceMs = 150;
+    static constexpr int SearchCacheMaxRows = 1000000;   // 搜索缓存中最多保留的总行数
+    static constexpr int ResizeSampleRows = 200;         // 自动调整列宽时取样的行数
+    static constexpr int ChangePollMs = 1000;
+    static constexpr int MaxDeltaStudents = 1000;        // 一次变化的学生超过该数时整表重新装载
+
     Ui::MainWindow *ui;
     Database db;
+    AsyncDatabase *asyncDb = nullptr;
     StudentModel *studentModel;
+    EditQueue *editQueue = nullptr;
+    QFutureWatcher<StudentTable> tableWatcher;   // 当前正在逐块显示的装载/搜索
+    int tableRequest = 0;                        // 每次装载或搜索递增，过时的学生总数不再使用
+    bool countingStudents = false;               // 装载前正在读线程上统计学生总数
+    int placedStudentId = -1;                    // 分页模式下刚添加、等待插入后选中的学生
+
+    QTimer searchDebounce;
+    QCache<QString, StudentTable> searchCache;   // 最近搜索过的关键字 -> 结果，按行数计算容量
+    QString activeSearchKeyword;                 // 正在从数据库搜索的关键字，装载全部时为空
+    QElapsedTimer searchTimer;
+    QString lastSearchInfo;                      // 显示在状态栏中的上次搜索耗时
+
+    QTimer changePoll;
+    int lastDataVersion = -1;                    // 表格内容对应的数据库版本和变更序号
+    qint64 lastChangeSeq = -1;
+    int changeBaseline = 0;                      // 每次重新记下版本和序号时递增
+    bool changeCheckRunning = false;             // 读线程上正在读取变更
+    int pendingDeletes = 0;                      // 已发出、结果还没显示到表格中的删除
 };
 
 #endif // MAINWINDOW_H
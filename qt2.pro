@@ -1,4 +1,4 @@
-QT += core gui sql
+QT += core gui sql concurrent
 # 去掉 charts，因为我们不使用图表模块
 
 greaterThan(QT_MAJOR_VERSION, 5): QT += widgets
@@ -9,21 +9,54 @@ SOURCES += \
     main.cpp \
     mainwindow.cpp \
     database.cpp \
+    asyncdatabase.cpp \
+    editqueue.cpp \
+    csvimporter.cpp \
+    dataexporter.cpp \
     studentmodel.cpp \
+    studenttable.cpp \
+    subjectcatalogue.cpp \
+    scorematrix.cpp \
+    radixsort.cpp \
+    statisticssnapshot.cpp \
+    rankindex.cpp \
+    connectionprofile.cpp \
+    connectionpool.cpp \
+    reportrunner.cpp \
+    querytracer.cpp \
     addstudentdialog.cpp \
-    statisticsdialog.cpp
+    statisticsdialog.cpp \
+    scoredelegate.cpp \
+    diagnosticsdialog.cpp
 
 HEADERS += \
     mainwindow.h \
     database.h \
+    asyncdatabase.h \
+    editqueue.h \
+    csvimporter.h \
+    dataexporter.h \
     studentmodel.h \
+    studenttable.h \
+    subjectcatalogue.h \
+    scorematrix.h \
+    radixsort.h \
+    statisticssnapshot.h \
+    rankindex.h \
+    connectionprofile.h \
+    connectionpool.h \
+    reportrunner.h \
+    querytracer.h \
     addstudentdialog.h \
-    statisticsdialog.h
+    statisticsdialog.h \
+    scoredelegate.h \
+    diagnosticsdialog.h
 
 FORMS += \
     mainwindow.ui \
     addstudentdialog.ui \
-    statisticsdialog.ui
+    statisticsdialog.ui \
+    diagnosticsdialog.ui
 
 # Release模式配置
 CONFIG(release, debug|release) {
@@ -0,0 +1,238 @@
+#include "querytracer.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSettings>
+#include <QJsonArray>
+#include <QtMath>
+#include <QDebug>
+
+// ================ LatencyHistogram ================
+
+int LatencyHistogram::bucketFor(qint64 micros)
+{
+    if (micros <= 1)
+        return 0;
+    return qMin(BucketCount - 1, int(std::log2(double(micros)) * 4));
+}
+
+double LatencyHistogram::bucketUpperMicros(int bucket)
+{
+    return std::exp2((bucket + 1) / 4.0);
+}
+
+void LatencyHistogram::add(qint64 micros)
+{
+    buckets[bucketFor(micros)]++;
+    samples++;
+    totalMicros += micros;
+    maxMicros = qMax(maxMicros, micros);
+}
+
+double LatencyHistogram::percentileMs(double p) const
+{
+    if (samples == 0)
+        return 0;
+
+    const qint64 rank = qMax<qint64>(1, qCeil(p * samples));
+    qint64 seen = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return qMin(bucketUpperMicros(i), double(maxMicros)) / 1000.0;
+    }
+    return maxMs();
+}
+
+// ================ QueryTracer ================
+
+std::atomic<bool> QueryTracer::enabled{false};
+
+QueryTracer &QueryTracer::instance()
+{
+    static QueryTracer tracer;
+    return tracer;
+}
+
+void QueryTracer::setEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+void QueryTracer::setSlowThresholdMs(int ms)
+{
+    slowThreshold.store(qMax(0, ms), std::memory_order_relaxed);
+}
+
+void QueryTracer::loadSettings()
+{
+    QSettings settings;
+    setEnabled(settings.value("diagnostics/enabled", false).toBool());
+    setSlowThresholdMs(settings.value("diagnostics/slow_query_ms", slowThresholdMs()).toInt());
+}
+
+void QueryTracer::saveSettings() const
+{
+    QSettings settings;
+    settings.setValue("diagnostics/enabled", isEnabled());
+    settings.setValue("diagnostics/slow_query_ms", slowThresholdMs());
+}
+
+void QueryTracer::record(const QueryTiming &timing, const QSqlDatabase &db)
+{
+    const qint64 total = timing.totalMicros();
+
+    // 查询计划在加锁前取得，执行 EXPLAIN 本身也要访问数据库
+    QStringList plan;
+    const bool slow = total >= qint64(slowThresholdMs()) * 1000;
+    if (slow)
+        plan = explain(timing, db);
+
+    QMutexLocker locker(&mutex);
+    StatementProfile &profile = statements[QString::fromLatin1(timing.name)];
+    profile.latency.add(total);
+    profile.prepareMicros += timing.prepareMicros;
+    profile.execMicros += timing.execMicros;
+    profile.fetchMicros += timing.fetchMicros;
+    profile.rows += timing.rows;
+
+    if (slow) {
+        if (slowLog.size() >= MaxSlowQueries)
+            slowLog.removeFirst();
+        slowLog.append({timing, plan, QDateTime::currentDateTime()});
+    }
+}
+
+QStringList QueryTracer::explain(const QueryTiming &timing, const QSqlDatabase &db)
+{
+    QStringList plan;
+    if (timing.sql.isEmpty() || !db.isOpen())
+        return plan;
+
+    // 只有单条 SELECT / INSERT / UPDATE / DELETE 才能取查询计划
+    QSqlQuery query(db);
+    if (!query.prepare("EXPLAIN QUERY PLAN " + timing.sql)) {
+        plan << QString("无法取得查询计划：%1").arg(query.lastError().text());
+        return plan;
+    }
+    for (int i = 0; i < timing.parameters.size(); i++)
+        query.bindValue(i, timing.parameters.at(i));
+
+    if (query.exec()) {
+        while (query.next())
+            plan << query.value(3).toString();
+    }
+    return plan;
+}
+
+void QueryTracer::reset()
+{
+    QMutexLocker locker(&mutex);
+    statements.clear();
+    slowLog.clear();
+}
+
+QMap<QString, StatementProfile> QueryTracer::profiles() const
+{
+    QMutexLocker locker(&mutex);
+    return statements;
+}
+
+QVector<SlowQuery> QueryTracer::slowQueries() const
+{
+    QMutexLocker locker(&mutex);
+    return slowLog;
+}
+
+QJsonObject QueryTracer::toJson() const
+{
+    const QMap<QString, StatementProfile> currentProfiles = profiles();
+    const QVector<SlowQuery> currentSlow = slowQueries();
+
+    QJsonArray statementArray;
+    for (auto it = currentProfiles.constBegin(); it != currentProfiles.constEnd(); ++it) {
+        const StatementProfile &profile = it.value();
+        QJsonObject item;
+        item["name"] = it.key();
+        item["count"] = profile.latency.count();
+        item["rows"] = profile.rows;
+        item["mean_ms"] = profile.latency.meanMs();
+        item["p50_ms"] = profile.latency.percentileMs(0.50);
+        item["p95_ms"] = profile.latency.percentileMs(0.95);
+        item["p99_ms"] = profile.latency.percentileMs(0.99);
+        item["max_ms"] = profile.latency.maxMs();
+        item["prepare_ms"] = profile.prepareMicros / 1000.0;
+        item["exec_ms"] = profile.execMicros / 1000.0;
+        item["fetch_ms"] = profile.fetchMicros / 1000.0;
+        statementArray.append(item);
+    }
+
+    QJsonArray slowArray;
+    for (const SlowQuery &slow : currentSlow) {
+        QJsonArray parameters;
+        for (const QVariant &value : slow.timing.parameters)
+            parameters.append(QJsonValue::fromVariant(value));
+
+        QJsonObject item;
+        item["name"] = QString::fromLatin1(slow.timing.name);
+        item["time"] = slow.time.toString(Qt::ISODateWithMs);
+        item["sql"] = slow.timing.sql;
+        item["parameters"] = parameters;
+        item["total_ms"] = slow.timing.totalMicros() / 1000.0;
+        item["prepare_ms"] = slow.timing.prepareMicros / 1000.0;
+        item["exec_ms"] = slow.timing.execMicros / 1000.0;
+        item["fetch_ms"] = slow.timing.fetchMicros / 1000.0;
+        item["rows"] = slow.timing.rows;
+        item["plan"] = QJsonArray::fromStringList(slow.plan);
+        slowArray.append(item);
+    }
+
+    QJsonObject root;
+    root["enabled"] = isEnabled();
+    root["slow_query_ms"] = slowThresholdMs();
+    root["statements"] = statementArray;
+    root["slow_queries"] = slowArray;
+    return root;
+}
+
+// ================ QuerySpan ================
+
+QuerySpan::QuerySpan(const char *name, const QSqlDatabase &db)
+    : db(db)
+    , active(QueryTracer::isEnabled())
+{
+    if (active) {
+        timing.name = name;
+        timer.start();
+    }
+}
+
+void QuerySpan::executed(const QSqlQuery *query)
+{
+    if (!active)
+        return;
+
+    execEnd = timer.nsecsElapsed();
+    // 语句和参数在这里记下，提交时查询对象可能已经销毁
+    if (query) {
+        timing.sql = query->lastQuery();
+        timing.parameters = query->boundValues();
+    }
+}
+
+QuerySpan::~QuerySpan()
+{
+    if (!active)
+        return;
+
+    const qint64 end = timer.nsecsElapsed();
+    if (execEnd < 0)
+        execEnd = end;   // 没有标出执行结束时，全部计为执行
+    prepareEnd = qMin(prepareEnd, execEnd);
+
+    timing.prepareMicros = prepareEnd / 1000;
+    timing.execMicros = (execEnd - prepareEnd) / 1000;
+    timing.fetchMicros = (end - execEnd) / 1000;
+    timing.rows = rows;
+    QueryTracer::instance().record(timing, db);
+}
@@ -0,0 +1,140 @@
+#ifndef QUERYTRACER_H
+#define QUERYTRACER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QDateTime>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <atomic>
+
+class QSqlDatabase;
+class QSqlQuery;
+
+// 按对数分段的延迟直方图，每 2 倍分为 4 段，百分位误差不超过约 19%
+class LatencyHistogram
+{
+public:
+    static constexpr int BucketCount = 128;   // 1 微秒到约 2^32 微秒
+
+    void add(qint64 micros);
+    qint64 count() const { return samples; }
+    double meanMs() const { return samples > 0 ? double(totalMicros) / samples / 1000.0 : 0; }
+    double maxMs() const { return maxMicros / 1000.0; }
+    double percentileMs(double p) const;   // p 取 0-1，返回所在分段的上界
+
+private:
+    static int bucketFor(qint64 micros);
+    static double bucketUpperMicros(int bucket);
+
+    qint64 buckets[BucketCount] = {};
+    qint64 samples = 0;
+    qint64 totalMicros = 0;
+    qint64 maxMicros = 0;
+};
+
+// 一次计时记录：准备、执行、取数据三段耗时（微秒）和返回的行数
+struct QueryTiming
+{
+    const char *name = nullptr;
+    QString sql;
+    QVariantList parameters;
+    qint64 prepareMicros = 0;
+    qint64 execMicros = 0;
+    qint64 fetchMicros = 0;
+    qint64 rows = 0;
+
+    qint64 totalMicros() const { return prepareMicros + execMicros + fetchMicros; }
+};
+
+// 慢查询日志中的一项
+struct SlowQuery
+{
+    QueryTiming timing;
+    QStringList plan;   // EXPLAIN QUERY PLAN 的 detail 列
+    QDateTime time;
+};
+
+// 每种 Database 调用的汇总
+struct StatementProfile
+{
+    LatencyHistogram latency;
+    qint64 prepareMicros = 0;
+    qint64 execMicros = 0;
+    qint64 fetchMicros = 0;
+    qint64 rows = 0;
+};
+
+// 全局的查询计时收集器，各线程的连接共用
+// 关闭时 QuerySpan 只读一次原子变量，几乎没有开销
+class QueryTracer
+{
+public:
+    static QueryTracer &instance();
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on);
+
+    // 超过阈值的调用记入慢查询日志，并附上查询计划
+    void setSlowThresholdMs(int ms);
+    int slowThresholdMs() const { return slowThreshold.load(std::memory_order_relaxed); }
+
+    // 从 QSettings 的 diagnostics/enabled、diagnostics/slow_query_ms 读取设置
+    void loadSettings();
+    void saveSettings() const;
+
+    void record(const QueryTiming &timing, const QSqlDatabase &db);
+    void reset();
+
+    QMap<QString, StatementProfile> profiles() const;
+    QVector<SlowQuery> slowQueries() const;
+    QJsonObject toJson() const;
+
+    static constexpr int MaxSlowQueries = 200;
+
+private:
+    QueryTracer() = default;
+    static QStringList explain(const QueryTiming &timing, const QSqlDatabase &db);
+
+    static std::atomic<bool> enabled;
+    std::atomic<int> slowThreshold{100};
+
+    mutable QMutex mutex;
+    QMap<QString, StatementProfile> statements;
+    QVector<SlowQuery> slowLog;   // 超出上限时丢弃最早的
+};
+
+// 一次 Database 调用的计时区间，在函数开头创建，离开作用域时提交
+// prepared() / executed() 标出各段的分界，之后到结束的时间计为取数据
+class QuerySpan
+{
+public:
+    QuerySpan(const char *name, const QSqlDatabase &db);
+    ~QuerySpan();
+
+    QuerySpan(const QuerySpan &) = delete;
+    QuerySpan &operator=(const QuerySpan &) = delete;
+
+    void prepared()
+    {
+        if (active)
+            prepareEnd = timer.nsecsElapsed();
+    }
+    void executed(const QSqlQuery *query);
+    void addRows(qint64 count) { rows += count; }
+
+private:
+    const QSqlDatabase &db;
+    QueryTiming timing;
+    QElapsedTimer timer;
+    qint64 prepareEnd = 0;
+    qint64 execEnd = -1;
+    qint64 rows = 0;
+    const bool active;
+};
+
+#endif // QUERYTRACER_H
@@ -0,0 +1,47 @@
+#include "radixsort.h"
+#include <numeric>
+
+static const int DigitBits = 16;
+static const int Buckets = 1 << DigitBits;
+static const int Passes = 64 / DigitBits;
+
+QVector<int> radixSortOrder(const QVector<quint64> &keys)
+{
+    const int n = keys.size();
+    QVector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    if (n < 2)
+        return order;
+
+    // 先一遍扫描统计每一趟各个数位的个数，之后每趟只需做前缀和与分配
+    QVector<int> counts(Passes * Buckets, 0);
+    for (quint64 key : keys) {
+        for (int pass = 0; pass < Passes; pass++)
+            counts[pass * Buckets + int((key >> (pass * DigitBits)) & (Buckets - 1))]++;
+    }
+
+    QVector<int> scratch(n);
+    for (int pass = 0; pass < Passes; pass++) {
+        int *count = counts.data() + pass * Buckets;
+        const int shift = pass * DigitBits;
+
+        // 所有键这一段都相同，分配后顺序不变
+        if (count[(keys.at(0) >> shift) & (Buckets - 1)] == n)
+            continue;
+
+        int offset = 0;
+        for (int digit = 0; digit < Buckets; digit++) {
+            const int size = count[digit];
+            count[digit] = offset;
+            offset += size;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const int row = order.at(i);
+            scratch[count[(keys.at(row) >> shift) & (Buckets - 1)]++] = row;
+        }
+        order.swap(scratch);
+    }
+
+    return order;
+}
@@ -0,0 +1,11 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <QVector>
+
+// 按 64 位无符号键从小到大排序，返回排序后的行号序列（order[i] 为第 i 小的键所在的下标）
+// 低位优先的基数排序，每趟处理 16 位，最多 4 趟，耗时与行数成正比；键相同的行保持原有先后顺序
+// 所有键在某一段 16 位上都相同时跳过这一趟，例如键的高位全为 0
+QVector<int> radixSortOrder(const QVector<quint64> &keys);
+
+#endif // RADIXSORT_H
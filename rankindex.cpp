@@ -0,0 +1,96 @@
+#include "rankindex.h"
+#include <QtGlobal>
+
+void FenwickTree::add(int bucket, int delta)
+{
+    for (int i = bucket + 1; i < tree.size(); i += i & -i)
+        tree[i] += delta;
+    itemCount += delta;
+}
+
+int FenwickTree::prefix(int bucket) const
+{
+    int sum = 0;
+    for (int i = qMin(bucket + 1, int(tree.size()) - 1); i > 0; i -= i & -i)
+        sum += tree[i];
+    return sum;
+}
+
+RankIndex::Group::Group()
+{
+    for (int key = 0; key < KeyCount; key++) {
+        const int maxScore = key == TotalKey ? MaxScore * SubjectCount : MaxScore;
+        keys[key] = FenwickTree(maxScore * ScoreScale + 1);
+    }
+}
+
+void RankIndex::clear()
+{
+    school = Group();
+    classes.clear();
+}
+
+int RankIndex::bucketOf(int key, float score)
+{
+    const int maxScore = key == TotalKey ? MaxScore * SubjectCount : MaxScore;
+    return qBound(0, qRound(score * ScoreScale), maxScore * ScoreScale);
+}
+
+void RankIndex::add(const QString &className, const float scores[SubjectCount], float total, int delta)
+{
+    auto it = classes.find(className);
+    if (it == classes.end()) {
+        if (delta < 0)
+            return;   // 不在索引中的学生无从移除
+        it = classes.insert(className, Group());
+    }
+
+    Group &group = it.value();
+    for (int key = 0; key < KeyCount; key++) {
+        const float score = key == TotalKey ? total : scores[key];
+        if (StudentTable::isMissing(score))
+            continue;
+        const int bucket = bucketOf(key, score);
+        group.keys[key].add(bucket, delta);
+        school.keys[key].add(bucket, delta);
+    }
+
+    if (group.studentCount() <= 0)
+        classes.erase(it);
+}
+
+void RankIndex::update(const StudentTable &table, int row, int delta)
+{
+    float scores[SubjectCount];
+    for (int s = 0; s < SubjectCount; s++)
+        scores[s] = table.score(row, Subject(s));
+    add(table.className(row), scores, table.total(row), delta);
+}
+
+int RankIndex::rankIn(const Group &group, int key, float score)
+{
+    if (StudentTable::isMissing(score))
+        return 0;
+    const FenwickTree &tree = group.keys[key];
+    if (tree.isEmpty())
+        return 0;
+    // 名次 = 1 + 分数段更高的人数
+    return 1 + tree.count() - tree.prefix(bucketOf(key, score));
+}
+
+int RankIndex::schoolRank(int key, float score) const
+{
+    return rankIn(school, key, score);
+}
+
+int RankIndex::classRank(const QString &className, int key, float score) const
+{
+    auto it = classes.constFind(className);
+    return it == classes.constEnd() ? 0 : rankIn(it.value(), key, score);
+}
+
+int RankIndex::classCount(const QString &className, int key) const
+{
+    auto it = classes.constFind(className);
+    return it == classes.constEnd() ? 0 : it.value().keys[key].count();
+}
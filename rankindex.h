@@ -0,0 +1,70 @@
+#ifndef RANKINDEX_H
+#define RANKINDEX_H
+
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include "studenttable.h"
+
+// 按分数段计数的树状数组（Fenwick 树），单点增减和前缀计数都是 O(log n)
+class FenwickTree
+{
+public:
+    explicit FenwickTree(int buckets = 0) : tree(buckets + 1, 0) {}
+
+    int bucketCount() const { return tree.size() - 1; }
+    int count() const { return itemCount; }
+    bool isEmpty() const { return itemCount == 0; }
+
+    void add(int bucket, int delta);
+    // 分数段 [0, bucket] 内的计数
+    int prefix(int bucket) const;
+
+private:
+    QVector<int> tree;   // 下标从 1 开始
+    int itemCount = 0;
+};
+
+// 学生排名索引：每个班级和全校各有一组树状数组，按总分和各科成绩分段计数
+// 某个学生的成绩变化时只需在对应的分段上增减，排名 = 1 + 分数更高的人数，不必重新排序整张表
+// 分数按 1/ScoreScale 分的精度分段，相差不到半个精度单位的成绩视为并列
+class RankIndex
+{
+public:
+    // 排名依据：下标小于 SubjectCount 为对应科目，TotalKey 为总分
+    static constexpr int TotalKey = SubjectCount;
+    static constexpr int KeyCount = SubjectCount + 1;
+    static constexpr int ScoreScale = 10;
+    static constexpr int MaxScore = FullScore;   // 单科满分，与录入和导入时的校验一致
+
+    bool isEmpty() const { return school.studentCount() == 0; }
+    void clear();
+
+    // 计入或移除一名学生；scores 中未录入的科目为 NaN，不参加该科排名
+    void add(const QString &className, const float scores[SubjectCount], float total, int delta = 1);
+    void addStudent(const StudentTable &table, int row) { update(table, row, 1); }
+    void removeStudent(const StudentTable &table, int row) { update(table, row, -1); }
+
+    // 名次从 1 开始，并列时名次相同；成绩未录入或索引中没有该班级时返回 0
+    int schoolRank(int key, float score) const;
+    int classRank(const QString &className, int key, float score) const;
+    int schoolCount(int key) const { return school.keys[key].count(); }
+    int classCount(const QString &className, int key) const;
+
+private:
+    struct Group
+    {
+        Group();
+        FenwickTree keys[KeyCount];
+        int studentCount() const { return keys[TotalKey].count(); }
+    };
+
+    void update(const StudentTable &table, int row, int delta);
+    static int bucketOf(int key, float score);
+    static int rankIn(const Group &group, int key, float score);
+
+    Group school;
+    QHash<QString, Group> classes;
+};
+
+#endif // RANKINDEX_H
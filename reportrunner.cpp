@@ -0,0 +1,148 @@
+#include "reportrunner.h"
+#include "database.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFileInfo>
+#include <QDir>
+#include <QSet>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <cstring>
+
+bool ReportRunner::isReportCommand(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--report") == 0)
+            return true;
+    }
+    return false;
+}
+
+bool ReportRunner::parseArguments(const QStringList &arguments, Options *options, QString *error)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"report", "要统计的数据库文件，可重复指定", "db"});
+    parser.addOption({"out", "输出目录", "dir"});
+    parser.addOption({"format", "输出格式：csv 或 jsonl", "format", "csv"});
+    parser.addOption({"jobs", "同时处理的数据库个数，默认按 CPU 核数", "n"});
+    parser.addPositionalArgument("databases", "更多数据库文件", "[db...]");
+
+    if (!parser.parse(arguments)) {
+        *error = parser.errorText();
+        return false;
+    }
+    if (parser.isSet("help")) {
+        *error = parser.helpText();
+        return false;
+    }
+
+    // --report 之后的其余文件名也作为数据库处理
+    options->databases = parser.values("report") + parser.positionalArguments();
+    options->outDir = parser.value("out");
+    if (options->databases.isEmpty() || options->outDir.isEmpty()) {
+        *error = "需要指定数据库文件（--report）和输出目录（--out）";
+        return false;
+    }
+
+    const QString format = parser.value("format").toLower();
+    if (format == "csv") {
+        options->format = DataExporter::Format::Csv;
+    } else if (format == "jsonl" || format == "json") {
+        options->format = DataExporter::Format::JsonLines;
+    } else {
+        *error = QString("不支持的输出格式：%1").arg(format);
+        return false;
+    }
+
+    if (parser.isSet("jobs")) {
+        bool ok = false;
+        options->jobs = parser.value("jobs").toInt(&ok);
+        if (!ok || options->jobs < 1) {
+            *error = "--jobs 需要正整数";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ReportRunner::Outcome ReportRunner::runOne(const QString &databasePath, const QString &outputDir,
+                                           DataExporter::Format format, int index)
+{
+    Outcome outcome;
+    outcome.database = databasePath;
+    outcome.outputDir = outputDir;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 每个任务在自己的线程里使用自己的连接，结束前关闭
+    // 只读连接不能升级表结构：旧版本的数据库（例如其他工具建立、本程序还没打开过的）先用短暂的可写连接升级
+    Database database;
+    const ConnectionProfile profile = ConnectionProfile::preset(ConnectionProfile::Preset::ReadOnlyReporting,
+                                                                databasePath);
+    if (!Database::upgradeSchema(databasePath, QString("report-upgrade-%1").arg(index))) {
+        outcome.result.error = "无法升级数据库表结构";
+    } else if (!database.openDatabase(profile, QString("report-%1").arg(index))) {
+        outcome.result.error = "无法打开数据库";
+    } else {
+        outcome.result = DataExporter(&database).exportStatistics(outputDir, format);
+    }
+
+    outcome.result.elapsedMs = timer.elapsed();
+    return outcome;
+}
+
+QVector<ReportRunner::Outcome> ReportRunner::runAll(const Options &options)
+{
+    // 输出子目录按数据库文件名命名，重名时加序号
+    QVector<QPair<int, QString>> tasks;
+    QSet<QString> usedNames;
+    for (int i = 0; i < options.databases.size(); i++) {
+        QString name = QFileInfo(options.databases.at(i)).completeBaseName();
+        if (usedNames.contains(name))
+            name += QString("_%1").arg(i + 1);
+        usedNames.insert(name);
+        tasks.append({i, QDir(options.outDir).filePath(name)});
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(options.jobs > 0 ? options.jobs : QThread::idealThreadCount());
+
+    return QtConcurrent::blockingMapped<QVector<Outcome>>(&pool, tasks, [&options](const QPair<int, QString> &task) {
+        return runOne(options.databases.at(task.first), task.second, options.format, task.first);
+    });
+}
+
+int ReportRunner::run(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("学生成绩分析系统");
+    app.setOrganizationName("School");
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    Options options;
+    QString error;
+    if (!parseArguments(app.arguments(), &options, &error)) {
+        err << error << Qt::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    for (const Outcome &outcome : runAll(options)) {
+        if (outcome.result.error.isEmpty()) {
+            out << outcome.database << " -> " << outcome.outputDir << "："
+                << outcome.result.rowsWritten << " 行，" << outcome.result.elapsedMs << " ms" << Qt::endl;
+        } else {
+            err << outcome.database << "：" << outcome.result.error << Qt::endl;
+            failures++;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
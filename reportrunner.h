@@ -0,0 +1,43 @@
+#ifndef REPORTRUNNER_H
+#define REPORTRUNNER_H
+
+#include <QString>
+#include <QStringList>
+#include "dataexporter.h"
+
+// 命令行批量统计：不创建窗口，只用 QCoreApplication 和 Database
+// 用法：StudentGradeSystem --report a.db [b.db ...] --out 目录 [--format csv|jsonl] [--jobs N]
+// 每个数据库以只读报表配置打开（旧版本的先升级表结构），统计结果写入 目录/<数据库文件名>/，多个数据库并行处理
+class ReportRunner
+{
+public:
+    struct Options
+    {
+        QStringList databases;
+        QString outDir;
+        DataExporter::Format format = DataExporter::Format::Csv;
+        int jobs = 0;   // 0 表示按 CPU 核数
+    };
+
+    // 单个数据库的处理结果
+    struct Outcome
+    {
+        QString database;
+        QString outputDir;
+        DataExporter::Result result;
+    };
+
+    // 命令行中带 --report 时进入报表模式，必须在创建 QApplication 之前判断
+    static bool isReportCommand(int argc, char *argv[]);
+    // 创建 QCoreApplication 并执行，返回进程退出码
+    static int run(int argc, char *argv[]);
+
+    static bool parseArguments(const QStringList &arguments, Options *options, QString *error);
+    static QVector<Outcome> runAll(const Options &options);
+
+private:
+    static Outcome runOne(const QString &databasePath, const QString &outputDir,
+                          DataExporter::Format format, int index);
+};
+
+#endif // REPORTRUNNER_H
@@ -0,0 +1,32 @@
+#include "scoredelegate.h"
+#include "subjectcatalogue.h"
+#include <QLineEdit>
+#include <QDoubleValidator>
+
+QWidget *ScoreDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem &option,
+                                     const QModelIndex &index) const
+{
+    Q_UNUSED(option);
+    Q_UNUSED(index);
+    QLineEdit *editor = new QLineEdit(parent);
+    QDoubleValidator *validator = new QDoubleValidator(0, FullScore, 1, editor);
+    validator->setNotation(QDoubleValidator::StandardNotation);
+    editor->setValidator(validator);
+    editor->setAlignment(Qt::AlignCenter);
+    return editor;
+}
+
+void ScoreDelegate::setEditorData(QWidget *editor, const QModelIndex &index) const
+{
+    const QVariant score = index.data(Qt::EditRole);
+    static_cast<QLineEdit *>(editor)->setText(score.isValid() ? QString::number(score.toFloat()) : QString());
+}
+
+// 输入框为空时也提交，模型把空白当作清除成绩；超出范围的中间输入由校验器拦住
+void ScoreDelegate::setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const
+{
+    QLineEdit *lineEdit = static_cast<QLineEdit *>(editor);
+    if (!lineEdit->text().isEmpty() && !lineEdit->hasAcceptableInput())
+        return;
+    model->setData(index, lineEdit->text().trimmed(), Qt::EditRole);
+}
@@ -0,0 +1,21 @@
+#ifndef SCOREDELEGATE_H
+#define SCOREDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// 成绩单元格的编辑器：单行输入框，只接受 0 到满分、最多一位小数的数字；清空表示未录入
+// 默认的数字编辑器是微调框，既不能留空，范围也不是成绩的范围
+class ScoreDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit ScoreDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {}
+
+    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option,
+                          const QModelIndex &index) const override;
+    void setEditorData(QWidget *editor, const QModelIndex &index) const override;
+    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override;
+};
+
+#endif // SCOREDELEGATE_H
@@ -0,0 +1,212 @@
+#include "scorematrix.h"
+#include "statisticssnapshot.h"
+#include <QHash>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <new>
+
+// 统计时每科同时累计的通道数；各通道互不依赖，不必改变浮点求和顺序也能向量化
+static const int Lanes = 8;
+
+static std::shared_ptr<float> allocateScores(int stride)
+{
+    const std::size_t bytes = std::size_t(stride) * SubjectCount * sizeof(float);
+    float *data = static_cast<float *>(::operator new[](qMax<std::size_t>(bytes, ScoreMatrix::Alignment),
+                                                         std::align_val_t(ScoreMatrix::Alignment)));
+    return std::shared_ptr<float>(data, [](float *p) {
+        ::operator delete[](p, std::align_val_t(ScoreMatrix::Alignment));
+    });
+}
+
+void ScoreMatrix::detach(int minimumRows)
+{
+    const bool grow = minimumRows > stride;
+    if (!grow && values && values.use_count() == 1)
+        return;
+
+    // 容量按倍数增长并取整到整缓存行
+    int newStride = stride;
+    if (grow)
+        newStride = qMax(minimumRows, stride * 2);
+    newStride = qMax(RowsPerLine, (newStride + RowsPerLine - 1) / RowsPerLine * RowsPerLine);
+
+    std::shared_ptr<float> copy = allocateScores(newStride);
+    if (values && rowCount > 0) {
+        for (int s = 0; s < SubjectCount; s++)
+            std::memcpy(copy.get() + s * newStride, subjectData(s), std::size_t(rowCount) * sizeof(float));
+    }
+    values = std::move(copy);
+    stride = newStride;
+}
+
+void ScoreMatrix::reserve(int rows)
+{
+    if (rows > stride)
+        detach(rows);
+}
+
+void ScoreMatrix::clear()
+{
+    values.reset();
+    rowCount = 0;
+    stride = 0;
+}
+
+void ScoreMatrix::appendRow(const float *scores)
+{
+    insertRow(rowCount, scores);
+}
+
+void ScoreMatrix::insertRow(int at, const float *scores)
+{
+    detach(rowCount + 1);
+    for (int s = 0; s < SubjectCount; s++) {
+        float *column = values.get() + s * stride;
+        std::memmove(column + at + 1, column + at, std::size_t(rowCount - at) * sizeof(float));
+        column[at] = scores[s];
+    }
+    rowCount++;
+}
+
+void ScoreMatrix::replaceRow(int at, const float *scores)
+{
+    detach(rowCount);
+    for (int s = 0; s < SubjectCount; s++)
+        values.get()[s * stride + at] = scores[s];
+}
+
+void ScoreMatrix::removeRow(int at)
+{
+    detach(rowCount);
+    for (int s = 0; s < SubjectCount; s++) {
+        float *column = values.get() + s * stride;
+        std::memmove(column + at, column + at + 1, std::size_t(rowCount - at - 1) * sizeof(float));
+    }
+    rowCount--;
+}
+
+void ScoreMatrix::rowScores(int row, float *scores) const
+{
+    for (int s = 0; s < SubjectCount; s++)
+        scores[s] = at(s, row);
+}
+
+void ScoreMatrix::append(const ScoreMatrix &other)
+{
+    if (other.rowCount == 0)
+        return;
+    detach(rowCount + other.rowCount);
+    for (int s = 0; s < SubjectCount; s++)
+        std::memcpy(values.get() + s * stride + rowCount, other.subjectData(s), std::size_t(other.rowCount) * sizeof(float));
+    rowCount += other.rowCount;
+}
+
+ScoreMatrix ScoreMatrix::reordered(const QVector<int> &order) const
+{
+    ScoreMatrix result;
+    result.detach(order.size());
+    for (int s = 0; s < SubjectCount; s++) {
+        const float *source = subjectData(s);
+        float *column = result.values.get() + s * result.stride;
+        for (int i = 0; i < order.size(); i++)
+            column[i] = source[order.at(i)];
+    }
+    result.rowCount = order.size();
+    return result;
+}
+
+void ScoreMatrix::aggregate(int first, int count, const QVector<double> &bucketEdges, SubjectAggregate *subjects) const
+{
+    const int bucketCount = qMax(0, int(bucketEdges.size()) - 1);
+    const double *edges = bucketEdges.constData();
+    QVector<qint64> laneBuckets(bucketCount * Lanes);
+    // 分布按分值计数：成绩通常是 [0, FullScore] 内的整数或半分，直接按半分下标计数；其余分值记在哈希表中
+    QVector<qint64> halfPoints(2 * FullScore + 1);
+    QHash<float, qint64> otherValues;
+
+    for (int s = 0; s < SubjectCount; s++) {
+        const float *scores = subjectData(s) + first;
+
+        qint64 counts[Lanes] = {};
+        qint64 passes[Lanes] = {};
+        double sums[Lanes] = {};
+        double squares[Lanes] = {};
+        double lows[Lanes];
+        double highs[Lanes];
+        std::fill(std::begin(lows), std::end(lows), std::numeric_limits<double>::infinity());
+        std::fill(std::begin(highs), std::end(highs), -std::numeric_limits<double>::infinity());
+        laneBuckets.fill(0);
+        qint64 *buckets = laneBuckets.data();
+
+        // 分支全部写成按条件取值，循环体内没有跳转
+        auto accumulate = [&](float score, int lane) {
+            const bool valid = !std::isnan(score);
+            const double value = valid ? double(score) : 0.0;
+            counts[lane] += valid;
+            sums[lane] += value;
+            squares[lane] += value * value;
+            lows[lane] = valid && value < lows[lane] ? value : lows[lane];
+            highs[lane] = valid && value > highs[lane] ? value : highs[lane];
+            passes[lane] += valid && value >= StatisticsSnapshot::PassScore;
+            for (int b = 0; b < bucketCount; b++) {
+                const bool inside = value >= edges[b] && (b == bucketCount - 1 ? value <= edges[b + 1] : value < edges[b + 1]);
+                buckets[b * Lanes + lane] += valid && inside;
+            }
+        };
+
+        int row = 0;
+        for (; row + Lanes <= count; row += Lanes) {
+            for (int lane = 0; lane < Lanes; lane++)
+                accumulate(scores[row + lane], lane);
+        }
+        for (int lane = 0; row < count; row++, lane++)
+            accumulate(scores[row], lane);
+
+        // 分布单独再扫一遍同一列：计数有分支和随机写入，放在上面的循环里会拖慢求和
+        for (int i = 0; i < count; i++) {
+            const float score = scores[i];
+            if (std::isnan(score))
+                continue;
+            const float doubled = score * 2;
+            if (doubled >= 0 && doubled <= 2 * FullScore && doubled == std::floor(doubled))
+                halfPoints[int(doubled)]++;
+            else
+                otherValues[score]++;
+        }
+
+        SubjectAggregate &aggregate = subjects[s];
+        aggregate.count = 0;
+        aggregate.sum = 0;
+        aggregate.sumSquares = 0;
+        aggregate.passCount = 0;
+        double low = lows[0];
+        double high = highs[0];
+        for (int lane = 0; lane < Lanes; lane++) {
+            aggregate.count += counts[lane];
+            aggregate.sum += sums[lane];
+            aggregate.sumSquares += squares[lane];
+            aggregate.passCount += passes[lane];
+            low = qMin(low, lows[lane]);
+            high = qMax(high, highs[lane]);
+        }
+        aggregate.min = aggregate.count > 0 ? low : 0;
+        aggregate.max = aggregate.count > 0 ? high : 0;
+
+        aggregate.buckets.fill(0, bucketCount);
+        for (int b = 0; b < bucketCount; b++) {
+            for (int lane = 0; lane < Lanes; lane++)
+                aggregate.buckets[b] += buckets[b * Lanes + lane];
+        }
+
+        aggregate.distribution = ScoreDistribution();
+        for (int i = 0; i < halfPoints.size(); i++) {
+            if (halfPoints.at(i) > 0)
+                aggregate.distribution.add(i / 2.0, halfPoints.at(i));
+        }
+        for (auto it = otherValues.constBegin(); it != otherValues.constEnd(); ++it)
+            aggregate.distribution.add(double(it.key()), it.value());
+        halfPoints.fill(0);
+        otherValues.clear();
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SCOREMATRIX_H
+#define SCOREMATRIX_H
+
+#include <QVector>
+#include <memory>
+#include "subjectcatalogue.h"
+
+struct SubjectAggregate;
+
+// 成绩矩阵：按科目分段连续存放（同一科目所有学生的成绩相邻），未录入的成绩为 NaN
+// 每个科目的起点按缓存行对齐，统计时逐科顺序扫描，编译器可以向量化
+// 复制时共享同一块内存，修改前才复制一份
+class ScoreMatrix
+{
+public:
+    static constexpr int Alignment = 64;
+    static constexpr int RowsPerLine = Alignment / int(sizeof(float));
+
+    int rows() const { return rowCount; }
+    void reserve(int rows);
+    void clear();
+
+    float at(int subject, int row) const { return values.get()[subject * stride + row]; }
+    const float *subjectData(int subject) const { return values.get() + subject * stride; }
+
+    // scores 依次为目录中各科的成绩，共 SubjectCount 个
+    void appendRow(const float *scores);
+    void insertRow(int at, const float *scores);
+    void replaceRow(int at, const float *scores);
+    void removeRow(int at);
+    void rowScores(int row, float *scores) const;
+    void append(const ScoreMatrix &other);
+    // 按 order 重新排列各行：结果的第 i 行为原来的第 order[i] 行
+    ScoreMatrix reordered(const QVector<int> &order) const;
+
+    // 对第 first 行起的 count 行，每科一遍顺序扫描算出人数、总和、平方和、最值、及格人数、各分数段人数，
+    // 同时按分值精确计数得到分布（中位数、四分位数由此计算）；结果覆盖 subjects[0..SubjectCount) 中的这些字段
+    void aggregate(int first, int count, const QVector<double> &bucketEdges, SubjectAggregate *subjects) const;
+
+private:
+    // 保证可以写入至少 minimumRows 行且不与其他副本共享
+    void detach(int minimumRows);
+
+    std::shared_ptr<float> values;
+    int rowCount = 0;
+    int stride = 0;   // 每科占用的行数，为 RowsPerLine 的整数倍
+};
+
+#endif // SCOREMATRIX_H
@@ -9,13 +9,16 @@
 #include <QMessageBox>
 #include <QColor>
 #include <QTableWidgetItem>
+#include <QHash>
 #include <algorithm>
 
-StatisticsDialog::StatisticsDialog(QWidget *parent, Database *db)
+StatisticsDialog::StatisticsDialog(QWidget *parent, Database *db, AsyncDatabase *asyncDb)
     : QDialog(parent)
     , ui(new Ui::StatisticsDialog)
     , database(db)
+    , asyncDatabase(asyncDb)
     , classTable(nullptr)
+    , distributionSubject(nullptr)
     , trendWidget(nullptr)
 {
     // 先检查数据库
@@ -54,15 +57,27 @@ void StatisticsDialog::setupWidgets()
 {
     // 1. 班级对比表格（有数据）
     classTable = new QTableWidget();
-    classTable->setColumnCount(5);
-    QStringList classHeaders = {"班级", "语文", "数学", "英语", "总分"};
-    classTable->setHorizontalHeaderLabels(classHeaders);
+    // 班级、各科平均分、总分，然后是所选科目的四项分布统计
+    classTable->setColumnCount(SubjectCount + 6);
     classTable->verticalHeader()->setVisible(false);
     classTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     classTable->setStyleSheet("QTableWidget { font-size: 12pt; }");
 
+    // 中位数、四分位数等按科目显示，由下拉框选择科目
+    distributionSubject = new QComboBox();
+    for (int s = 0; s < SubjectCount; s++)
+        distributionSubject->addItem(subjectName(Subject(s)), s);
+    connect(distributionSubject, &QComboBox::currentIndexChanged, this, &StatisticsDialog::updateDistributionColumns);
+
+    QHBoxLayout *subjectLayout = new QHBoxLayout();
+    subjectLayout->addWidget(new QLabel("分布统计科目："));
+    subjectLayout->addWidget(distributionSubject);
+    subjectLayout->addStretch();
+
     QVBoxLayout *layout1 = new QVBoxLayout(ui->classGroup);
+    layout1->addLayout(subjectLayout);
     layout1->addWidget(classTable);
+    updateDistributionColumns();
 
     // 2. 趋势分析控件（有数据）
     trendWidget = new QWidget();
@@ -76,25 +91,190 @@ void StatisticsDialog::setupWidgets()
 
 void StatisticsDialog::updateAllData()
 {
-    updateClassData();
-    updateTrendData();
+    if (!database) return;
+
+    showLoading();
+
+    // 班级对比和排名都由同一份统计快照派生，打开对话框只扫描一次表
+    // 有后台连接时异步统计，结果到达后再填表，对话框先显示出来
+    if (asyncDatabase) {
+        asyncDatabase->getStatisticsSnapshot().then(this, [this](const StatisticsSnapshot &snapshot) {
+            showSnapshot(snapshot);
+        });
+    } else {
+        showSnapshot(database->getStatisticsSnapshot());
+    }
 }
 
-void StatisticsDialog::updateClassData()
+void StatisticsDialog::showSnapshot(const StatisticsSnapshot &snapshot)
 {
-    if (!classTable || !database) return;
+    showClassData(snapshot.classStats());
+
+    // 趋势页需要考试记录，快照到达后再查询；记录不足两次时按当前成绩排名
+    const QVector<QMap<QString, QVariant>> ranking = snapshot.trendData();
+    if (asyncDatabase) {
+        asyncDatabase->getExamTrend().then(this, [this, ranking](const ExamTrend &trend) {
+            showTrend(trend, ranking);
+        });
+    } else {
+        showTrend(database->getExamTrend(), ranking);
+    }
+}
+
+void StatisticsDialog::showTrend(const ExamTrend &trend, const QVector<QMap<QString, QVariant>> &ranking)
+{
+    if (trend.exams.size() >= 2) {
+        showExamTrend(trend);
+        return;
+    }
+
+    showTrendData(ranking);
+    if (!trendWidget) return;
+    QLabel *hintLabel = new QLabel("记录两次以上考试后（文件 → 记录考试），这里显示各班级历次考试的变化");
+    hintLabel->setStyleSheet("font-size: 10pt; color: #666; padding: 5px;");
+    hintLabel->setAlignment(Qt::AlignCenter);
+    trendWidget->layout()->addWidget(hintLabel);
+}
+
+void StatisticsDialog::showExamTrend(const ExamTrend &trend)
+{
+    if (!trendWidget) return;
+
+    clearTrendWidget();
+
+    // 只显示最近几次考试，更早的记录仍保存在数据库中
+    static const int MaxExamColumns = 8;
+    const int firstExam = qMax(0, int(trend.exams.size()) - MaxExamColumns);
+    QHash<int, int> examColumn;   // exam_id -> 列号
+    QStringList headers{"班级"};
+    for (int i = firstExam; i < trend.exams.size(); i++) {
+        const auto &exam = trend.exams[i];
+        examColumn.insert(exam["exam_id"].toInt(), headers.size());
+        headers << QString("%1\n%2").arg(exam["exam"].toString(), exam["date"].toDate().toString("yyyy-MM-dd"));
+    }
+    headers << "较上次";
+
+    // 每个班级一行，按最近一次考试的总分平均分从高到低
+    const int lastColumn = headers.size() - 2;
+    QMap<QString, QVector<QVariant>> classRows;
+    for (const auto &row : trend.classTrend) {
+        const int column = examColumn.value(row["exam_id"].toInt(), -1);
+        if (column < 0)
+            continue;
+        QVector<QVariant> &averages = classRows[row["class"].toString()];
+        averages.resize(headers.size());
+        averages[column] = row["average"];
+    }
+    QStringList classes = classRows.keys();
+    std::stable_sort(classes.begin(), classes.end(), [&classRows, lastColumn](const QString &a, const QString &b) {
+        return classRows[a].at(lastColumn).toDouble() > classRows[b].at(lastColumn).toDouble();
+    });
+
+    QLabel *titleLabel = new QLabel("各班级总分平均分变化");
+    titleLabel->setStyleSheet("font-weight: bold; font-size: 14pt; margin-bottom: 10px;");
+    titleLabel->setAlignment(Qt::AlignCenter);
+    trendWidget->layout()->addWidget(titleLabel);
+
+    QTableWidget *examTable = new QTableWidget(classes.size(), headers.size());
+    examTable->setHorizontalHeaderLabels(headers);
+    examTable->verticalHeader()->setVisible(false);
+    examTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    for (int i = 0; i < classes.size(); i++) {
+        const QVector<QVariant> &averages = classRows[classes[i]];
+        examTable->setItem(i, 0, new QTableWidgetItem(classes[i]));
+        for (int column = 1; column <= lastColumn; column++) {
+            if (!averages.at(column).isNull())
+                examTable->setItem(i, column, new QTableWidgetItem(QString::number(averages.at(column).toDouble(), 'f', 1)));
+        }
+
+        // 与上一次考试比较；班级在其中一次考试中没有学生时不比较
+        const QVariant previous = averages.at(lastColumn - 1);
+        const QVariant latest = averages.at(lastColumn);
+        if (lastColumn > 1 && !previous.isNull() && !latest.isNull()) {
+            const double delta = latest.toDouble() - previous.toDouble();
+            QTableWidgetItem *deltaItem = new QTableWidgetItem(QString("%1%2").arg(delta > 0 ? "+" : "")
+                                                                   .arg(delta, 0, 'f', 1));
+            deltaItem->setForeground(delta >= 0 ? QColor(0, 128, 0) : QColor(255, 0, 0));
+            examTable->setItem(i, lastColumn + 1, deltaItem);
+        }
+    }
+    examTable->resizeColumnsToContents();
+    trendWidget->layout()->addWidget(examTable);
+
+    // 最近两次考试之间进步最大的学生
+    const auto &previousExam = trend.exams.at(trend.exams.size() - 2);
+    const auto &latestExam = trend.exams.last();
+    QLabel *improvedLabel = new QLabel(QString("进步最大的学生（%1 → %2）")
+                                           .arg(previousExam["exam"].toString(), latestExam["exam"].toString()));
+    improvedLabel->setStyleSheet("font-weight: bold; font-size: 12pt; margin-top: 10px;");
+    trendWidget->layout()->addWidget(improvedLabel);
+
+    QTableWidget *improvedTable = new QTableWidget(trend.mostImproved.size(), 6);
+    improvedTable->setHorizontalHeaderLabels({"学号", "姓名", "班级", "上次总分", "本次总分", "进步"});
+    improvedTable->verticalHeader()->setVisible(false);
+    improvedTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    for (int i = 0; i < trend.mostImproved.size(); i++) {
+        const auto &student = trend.mostImproved[i];
+        improvedTable->setItem(i, 0, new QTableWidgetItem(student["stu_id"].toString()));
+        improvedTable->setItem(i, 1, new QTableWidgetItem(student["name"].toString()));
+        improvedTable->setItem(i, 2, new QTableWidgetItem(student["class"].toString()));
+        improvedTable->setItem(i, 3, new QTableWidgetItem(QString::number(student["from"].toDouble(), 'f', 1)));
+        improvedTable->setItem(i, 4, new QTableWidgetItem(QString::number(student["to"].toDouble(), 'f', 1)));
+        improvedTable->setItem(i, 5, new QTableWidgetItem(QString::number(student["delta"].toDouble(), 'f', 1)));
+    }
+    improvedTable->resizeColumnsToContents();
+    trendWidget->layout()->addWidget(improvedTable);
+}
+
+void StatisticsDialog::showLoading()
+{
+    if (classTable) {
+        classTable->clearContents();
+        classTable->setRowCount(1);
+        QTableWidgetItem *loadingItem = new QTableWidgetItem("正在统计...");
+        loadingItem->setTextAlignment(Qt::AlignCenter);
+        classTable->setItem(0, 0, loadingItem);
+        classTable->setSpan(0, 0, 1, classTable->columnCount());
+    }
+
+    if (trendWidget) {
+        clearTrendWidget();
+        QLabel *loadingLabel = new QLabel("正在统计...");
+        loadingLabel->setAlignment(Qt::AlignCenter);
+        loadingLabel->setStyleSheet("font-size: 14pt; color: gray;");
+        trendWidget->layout()->addWidget(loadingLabel);
+    }
+}
+
+void StatisticsDialog::updateDistributionColumns()
+{
+    if (!classTable) return;
+
+    const QString subject = distributionSubject->currentText();
+    QStringList labels = {"班级"};
+    for (int s = 0; s < SubjectCount; s++)
+        labels << subjectName(Subject(s));
+    labels << "总分" << subject + "中位数" << subject + "四分位数" << subject + "标准差" << subject + "前10%线";
+    classTable->setHorizontalHeaderLabels(labels);
+    if (!classStatsData.isEmpty())
+        showClassData(classStatsData);
+}
+
+void StatisticsDialog::showClassData(const QVector<QMap<QString, QVariant>> &stats)
+{
+    if (!classTable) return;
+    classStatsData = stats;
 
     classTable->clearContents();
+    classTable->clearSpans();
 
     try {
-        QVector<QMap<QString, QVariant>> stats = database->getClassStats();
-
         if (stats.isEmpty()) {
             classTable->setRowCount(1);
             QTableWidgetItem *noDataItem = new QTableWidgetItem("暂无班级数据");
             noDataItem->setTextAlignment(Qt::AlignCenter);
             classTable->setItem(0, 0, noDataItem);
-            classTable->setSpan(0, 0, 1, 5);
+            classTable->setSpan(0, 0, 1, classTable->columnCount());
             return;
         }
 
@@ -103,37 +283,36 @@ void StatisticsDialog::updateClassData()
         for (int i = 0; i < stats.size(); i++) {
             const auto &stat = stats[i];
 
-            QTableWidgetItem *classItem = new QTableWidgetItem(stat["class"].toString());
-            QTableWidgetItem *chineseItem = new QTableWidgetItem(QString::number(stat["chinese_avg"].toDouble(), 'f', 1));
-            QTableWidgetItem *mathItem = new QTableWidgetItem(QString::number(stat["math_avg"].toDouble(), 'f', 1));
-            QTableWidgetItem *englishItem = new QTableWidgetItem(QString::number(stat["english_avg"].toDouble(), 'f', 1));
-
-            // 计算总分
-            double total = stat["chinese_avg"].toDouble() +
-                           stat["math_avg"].toDouble() +
-                           stat["english_avg"].toDouble();
-            QTableWidgetItem *totalItem = new QTableWidgetItem(QString::number(total, 'f', 1));
-
-            // 设置颜色
-            if (total >= 240) {
-                classItem->setBackground(QColor(220, 255, 220));
-                chineseItem->setBackground(QColor(220, 255, 220));
-                mathItem->setBackground(QColor(220, 255, 220));
-                englishItem->setBackground(QColor(220, 255, 220));
-                totalItem->setBackground(QColor(220, 255, 220));
-            } else if (total < 180) {
-                classItem->setBackground(QColor(255, 220, 220));
-                chineseItem->setBackground(QColor(255, 220, 220));
-                mathItem->setBackground(QColor(255, 220, 220));
-                englishItem->setBackground(QColor(255, 220, 220));
-                totalItem->setBackground(QColor(255, 220, 220));
+            QVector<QTableWidgetItem *> items = {new QTableWidgetItem(stat["class"].toString())};
+            double total = 0;
+            for (const SubjectInfo &subject : SubjectCatalogue) {
+                const double average = stat[QString("%1_avg").arg(QLatin1String(subject.column))].toDouble();
+                items.append(new QTableWidgetItem(QString::number(average, 'f', 1)));
+                total += average;
+            }
+            items.append(new QTableWidgetItem(QString::number(total, 'f', 1)));
+
+            // 设置颜色：平均每科 80 分以上为好，60 分以下为差
+            const double fullTotal = double(FullScore) * SubjectCount;
+            const QColor background = total >= fullTotal * 0.8 ? QColor(220, 255, 220)
+                                    : total < fullTotal * 0.6 ? QColor(255, 220, 220) : QColor();
+            for (int column = 0; column < items.size(); column++) {
+                if (background.isValid())
+                    items.at(column)->setBackground(background);
+                classTable->setItem(i, column, items.at(column));
             }
 
-            classTable->setItem(i, 0, classItem);
-            classTable->setItem(i, 1, chineseItem);
-            classTable->setItem(i, 2, mathItem);
-            classTable->setItem(i, 3, englishItem);
-            classTable->setItem(i, 4, totalItem);
+            // 分布统计：没有成绩的班级显示 "-"
+            const QString prefix = QString(subjectColumn(Subject(distributionSubject->currentData().toInt()))) + "_";
+            const int column = SubjectCount + 2;
+            auto format = [&stat](const QString &key) {
+                const QVariant value = stat.value(key);
+                return value.isNull() ? QString("-") : QString::number(value.toDouble(), 'f', 1);
+            };
+            classTable->setItem(i, column, new QTableWidgetItem(format(prefix + "median")));
+            classTable->setItem(i, column + 1, new QTableWidgetItem(format(prefix + "q1") + " - " + format(prefix + "q3")));
+            classTable->setItem(i, column + 2, new QTableWidgetItem(format(prefix + "stddev")));
+            classTable->setItem(i, column + 3, new QTableWidgetItem(format(prefix + "top10")));
         }
 
         classTable->resizeColumnsToContents();
@@ -143,10 +322,8 @@ void StatisticsDialog::updateClassData()
     }
 }
 
-void StatisticsDialog::updateTrendData()
+void StatisticsDialog::clearTrendWidget()
 {
-    if (!trendWidget || !database) return;
-
     // 清除旧内容
     QLayoutItem *item;
     while ((item = trendWidget->layout()->takeAt(0)) != nullptr) {
@@ -155,10 +332,15 @@ void StatisticsDialog::updateTrendData()
         }
         delete item;
     }
+}
 
-    try {
-        QVector<QMap<QString, QVariant>> trendData = database->getTrendData();
+void StatisticsDialog::showTrendData(QVector<QMap<QString, QVariant>> trendData)
+{
+    if (!trendWidget) return;
+
+    clearTrendWidget();
 
+    try {
         if (trendData.isEmpty()) {
             QLabel *noDataLabel = new QLabel("暂无趋势数据");
             noDataLabel->setAlignment(Qt::AlignCenter);
@@ -173,22 +355,23 @@ void StatisticsDialog::updateTrendData()
         titleLabel->setAlignment(Qt::AlignCenter);
         trendWidget->layout()->addWidget(titleLabel);
 
-        // 按总分排序
+        // 按各科平均分之和排序
+        auto totalOf = [](const QMap<QString, QVariant> &data) {
+            double total = 0;
+            for (const SubjectInfo &subject : SubjectCatalogue)
+                total += data[QLatin1String(subject.column)].toDouble();
+            return total;
+        };
         std::sort(trendData.begin(), trendData.end(),
-                  [](const QMap<QString, QVariant> &a, const QMap<QString, QVariant> &b) {
-                      double totalA = a["chinese"].toDouble() + a["math"].toDouble() + a["english"].toDouble();
-                      double totalB = b["chinese"].toDouble() + b["math"].toDouble() + b["english"].toDouble();
-                      return totalA > totalB;
+                  [&totalOf](const QMap<QString, QVariant> &a, const QMap<QString, QVariant> &b) {
+                      return totalOf(a) > totalOf(b);
                   });
 
         // 显示每个班级的数据
         for (int i = 0; i < trendData.size(); i++) {
             const auto &data = trendData[i];
             QString className = data["class"].toString();
-            double chinese = data["chinese"].toDouble();
-            double math = data["math"].toDouble();
-            double english = data["english"].toDouble();
-            double total = chinese + math + english;
+            double total = totalOf(data);
 
             QWidget *rowWidget = new QWidget();
             QHBoxLayout *rowLayout = new QHBoxLayout(rowWidget);
@@ -204,10 +387,12 @@ void StatisticsDialog::updateTrendData()
             classLabel->setFixedWidth(100);
 
             // 成绩信息
-            QString scores = QString("语文:%1 数学:%2 英语:%3")
-                                 .arg(chinese, 0, 'f', 1)
-                                 .arg(math, 0, 'f', 1)
-                                 .arg(english, 0, 'f', 1);
+            QStringList subjectScores;
+            for (int s = 0; s < SubjectCount; s++) {
+                subjectScores << QString("%1:%2").arg(subjectName(Subject(s)))
+                                     .arg(data[subjectColumn(Subject(s))].toDouble(), 0, 'f', 1);
+            }
+            QString scores = subjectScores.join(" ");
             QLabel *scoreLabel = new QLabel(scores);
             scoreLabel->setMinimumWidth(200);
 
@@ -3,7 +3,9 @@
 
 #include <QDialog>
 #include <QTableWidget>
+#include <QComboBox>
 #include "database.h"
+#include "asyncdatabase.h"
 
 namespace Ui {
 class StatisticsDialog;
@@ -14,23 +16,33 @@ class StatisticsDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit StatisticsDialog(QWidget *parent = nullptr, Database *db = nullptr);
+    explicit StatisticsDialog(QWidget *parent = nullptr, Database *db = nullptr,
+                              AsyncDatabase *asyncDb = nullptr);
     ~StatisticsDialog();
 
 private slots:
     void on_classList_currentTextChanged(const QString &currentText);
+    void updateDistributionColumns();
 
 private:
     void setupWidgets();
     void updateAllData();
-    void updateClassData();
-    void updateTrendData();
     void updateClassList();
+    void showSnapshot(const StatisticsSnapshot &snapshot);
+    void showClassData(const QVector<QMap<QString, QVariant>> &stats);
+    void showTrend(const ExamTrend &trend, const QVector<QMap<QString, QVariant>> &ranking);
+    void showExamTrend(const ExamTrend &trend);
+    void showTrendData(QVector<QMap<QString, QVariant>> trendData);
+    void clearTrendWidget();
+    void showLoading();
 
     Ui::StatisticsDialog *ui;
     Database *database;
+    AsyncDatabase *asyncDatabase;
 
     QTableWidget *classTable;  // 保持与UI一致
+    QComboBox *distributionSubject;   // 班级表中分布统计列对应的科目
+    QVector<QMap<QString, QVariant>> classStatsData;   // 切换科目时重新填表
     QWidget *trendWidget;      // 保持与UI一致
 };
 
@@ -0,0 +1,225 @@
+#include "statisticssnapshot.h"
+#include <algorithm>
+#include <iterator>
+
+// ================ ScoreDistribution ================
+
+void ScoreDistribution::add(double score, qint64 times)
+{
+    if (times <= 0)
+        return;
+
+    counts[score] += times;
+
+    // 带权重的 Welford 更新，相当于连续加入 times 个相同的值
+    const qint64 total = n + times;
+    const double delta = score - mu;
+    mu += delta * times / total;
+    m2 += times * delta * (score - mu);
+    n = total;
+}
+
+void ScoreDistribution::merge(const ScoreDistribution &other)
+{
+    if (other.n == 0)
+        return;
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+
+    for (auto it = other.counts.constBegin(); it != other.counts.constEnd(); ++it)
+        counts[it.key()] += it.value();
+
+    // Chan 等人的并行合并公式
+    const qint64 total = n + other.n;
+    const double delta = other.mu - mu;
+    mu += delta * other.n / total;
+    m2 += other.m2 + delta * delta * (double(n) * double(other.n) / total);
+    n = total;
+}
+
+double ScoreDistribution::quantile(double p) const
+{
+    if (n == 0)
+        return 0;
+
+    // 第 lower 个和第 lower + 1 个（从 0 开始）次序统计量之间插值
+    const double position = (n - 1) * qBound(0.0, p, 1.0);
+    const qint64 lower = qint64(std::floor(position));
+    const double fraction = position - lower;
+
+    qint64 seen = 0;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        seen += it.value();
+        if (seen <= lower)
+            continue;
+
+        // 下一个次序统计量仍是同一分值
+        if (seen > lower + 1 || fraction == 0)
+            return it.key();
+        const auto next = std::next(it);
+        if (next == counts.constEnd())
+            return it.key();
+        return it.key() + fraction * (next.key() - it.key());
+    }
+    return counts.lastKey();
+}
+
+// ================ SubjectAggregate ================
+
+void SubjectAggregate::merge(const SubjectAggregate &other)
+{
+    if (other.count > 0) {
+        min = (count > 0) ? qMin(min, other.min) : other.min;
+        max = (count > 0) ? qMax(max, other.max) : other.max;
+    }
+    count += other.count;
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+    passCount += other.passCount;
+
+    if (buckets.size() < other.buckets.size())
+        buckets.resize(other.buckets.size());
+    for (int i = 0; i < other.buckets.size(); i++)
+        buckets[i] += other.buckets.at(i);
+
+    distribution.merge(other.distribution);
+}
+
+void ClassAggregate::merge(const ClassAggregate &other)
+{
+    studentCount += other.studentCount;
+    totalSum += other.totalSum;
+    for (int s = 0; s < SubjectCount; s++)
+        subjects[s].merge(other.subjects[s]);
+}
+
+QVector<double> StatisticsSnapshot::defaultBucketEdges()
+{
+    return {0, 60, 70, 80, 90, 100};
+}
+
+QString StatisticsSnapshot::bucketLabel(int bucket) const
+{
+    const double low = bucketEdges.at(bucket);
+    const double high = bucketEdges.at(bucket + 1);
+
+    // 整数边界沿用原来的写法，如 "60-69"；最后一段包含上界
+    const bool last = bucket == bucketCount() - 1;
+    if (low == int(low) && high == int(high)) {
+        return QString("%1-%2").arg(int(low)).arg(last ? int(high) : int(high) - 1);
+    }
+    return QString("%1-%2").arg(low).arg(high);
+}
+
+void StatisticsSnapshot::computeSchoolTotals()
+{
+    school = ClassAggregate();
+    school.className = "全校";
+    for (const ClassAggregate &aggregate : classes)
+        school.merge(aggregate);
+}
+
+// 没有成绩时返回空值，与 SQL 中 AVG/MAX/MIN 的行为一致
+static QVariant averageOrNull(const SubjectAggregate &aggregate)
+{
+    return aggregate.count > 0 ? QVariant(aggregate.average()) : QVariant();
+}
+
+// 分布统计：中位数、上下四分位数、标准差和前 10% 分数线，键名前加 prefix
+static void addDistribution(QMap<QString, QVariant> &stat, const QString &prefix,
+                            const ScoreDistribution &distribution)
+{
+    const bool empty = distribution.count() == 0;
+    auto value = [empty](double v) { return empty ? QVariant() : QVariant(v); };
+
+    stat[prefix + "median"] = value(distribution.median());
+    stat[prefix + "q1"] = value(distribution.quantile(0.25));
+    stat[prefix + "q3"] = value(distribution.quantile(0.75));
+    stat[prefix + "stddev"] = value(distribution.standardDeviation());
+    stat[prefix + "top10"] = value(distribution.quantile(1 - StatisticsSnapshot::TopShare));
+}
+
+QVector<QMap<QString, QVariant>> StatisticsSnapshot::subjectStats(Subject subject) const
+{
+    QVector<QMap<QString, QVariant>> stats;
+    stats.reserve(classes.size());
+
+    for (const ClassAggregate &aggregate : classes) {
+        const SubjectAggregate &scores = aggregate.subjects[int(subject)];
+
+        QMap<QString, QVariant> stat;
+        stat["class"] = aggregate.className;
+        stat["count"] = aggregate.studentCount;
+        stat["avg_score"] = averageOrNull(scores);
+        stat["max_score"] = scores.count > 0 ? QVariant(scores.max) : QVariant();
+        stat["min_score"] = scores.count > 0 ? QVariant(scores.min) : QVariant();
+        stat["pass_rate"] = aggregate.studentCount > 0 ? scores.passCount * 100.0 / aggregate.studentCount : 0.0;
+        addDistribution(stat, QString(), scores.distribution);
+        stats.append(stat);
+    }
+
+    return stats;
+}
+
+QVector<QMap<QString, QVariant>> StatisticsSnapshot::classStats() const
+{
+    // 按总分平均分从高到低
+    QVector<const ClassAggregate *> order;
+    order.reserve(classes.size());
+    for (const ClassAggregate &aggregate : classes)
+        order.append(&aggregate);
+    std::stable_sort(order.begin(), order.end(), [](const ClassAggregate *a, const ClassAggregate *b) {
+        return a->totalAverage() > b->totalAverage();
+    });
+
+    QVector<QMap<QString, QVariant>> stats;
+    stats.reserve(order.size());
+
+    for (const ClassAggregate *aggregate : order) {
+        QMap<QString, QVariant> stat;
+        stat["class"] = aggregate->className;
+        stat["total_students"] = aggregate->studentCount;
+        for (int s = 0; s < SubjectCount; s++) {
+            const QString subject = subjectColumn(Subject(s));
+            stat[subject + "_avg"] = averageOrNull(aggregate->subjects[s]);
+            addDistribution(stat, subject + "_", aggregate->subjects[s].distribution);
+        }
+        stat["total_avg"] = aggregate->totalAverage();
+        stats.append(stat);
+    }
+
+    return stats;
+}
+
+QVector<QMap<QString, QVariant>> StatisticsSnapshot::scoreDistribution(Subject subject) const
+{
+    QVector<QMap<QString, QVariant>> distribution;
+    const SubjectAggregate &scores = school.subjects[int(subject)];
+
+    for (int i = 0; i < bucketCount(); i++) {
+        QMap<QString, QVariant> item;
+        item["range"] = bucketLabel(i);
+        item["count"] = i < scores.buckets.size() ? scores.buckets.at(i) : 0;
+        distribution.append(item);
+    }
+
+    return distribution;
+}
+
+QVector<QMap<QString, QVariant>> StatisticsSnapshot::trendData() const
+{
+    QVector<QMap<QString, QVariant>> trendData;
+    trendData.reserve(classes.size());
+
+    for (const ClassAggregate &aggregate : classes) {
+        QMap<QString, QVariant> data;
+        data["class"] = aggregate.className;
+        for (int s = 0; s < SubjectCount; s++)
+            data[subjectColumn(Subject(s))] = averageOrNull(aggregate.subjects[s]);
+        trendData.append(data);
+    }
+
+    return trendData;
+}
@@ -0,0 +1,94 @@
+#ifndef STATISTICSSNAPSHOT_H
+#define STATISTICSSNAPSHOT_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+#include <QVariant>
+#include <cmath>
+#include "studenttable.h"
+
+// 一组成绩的分布：按分值计数，同时用 Welford 算法逐个累计均值和方差
+// 成绩的取值种类有限（通常是整数或半分），按分值计数即可精确求分位数；
+// 两份分布可以直接合并，班级的分布合起来就是全校的分布
+class ScoreDistribution
+{
+public:
+    void add(double score, qint64 times = 1);
+    void merge(const ScoreDistribution &other);
+
+    qint64 count() const { return n; }
+    double mean() const { return mu; }
+    double variance() const { return n > 0 ? m2 / n : 0; }   // 总体方差
+    double standardDeviation() const { return std::sqrt(variance()); }
+
+    // p 取 0-1，在相邻两个次序统计量之间线性插值（与 Excel 的 PERCENTILE.INC 相同）
+    double quantile(double p) const;
+    double median() const { return quantile(0.5); }
+
+    const QMap<double, qint64> &values() const { return counts; }
+
+private:
+    QMap<double, qint64> counts;   // 分值 -> 人数
+    qint64 n = 0;
+    double mu = 0;
+    double m2 = 0;                 // 与均值之差的平方和
+};
+
+// 某个科目在一组学生中的汇总，只统计已录入的成绩
+struct SubjectAggregate
+{
+    qint64 count = 0;          // 有成绩的人数
+    double sum = 0;
+    double sumSquares = 0;     // 平方和，用于求方差
+    double min = 0;            // count 为 0 时无意义
+    double max = 0;
+    qint64 passCount = 0;      // 及格人数
+    QVector<qint64> buckets;   // 各分数段人数，与 StatisticsSnapshot::bucketEdges 对应
+    ScoreDistribution distribution;   // 中位数、四分位数、标准差等由此计算
+
+    double average() const { return count > 0 ? sum / count : 0; }
+    void merge(const SubjectAggregate &other);
+};
+
+// 某个班级（或全校）的汇总
+struct ClassAggregate
+{
+    QString className;
+    qint64 studentCount = 0;
+    double totalSum = 0;       // 总分之和
+    SubjectAggregate subjects[SubjectCount];
+
+    double totalAverage() const { return studentCount > 0 ? totalSum / studentCount : 0; }
+    void merge(const ClassAggregate &other);
+};
+
+// 一次分组扫描得到的全部统计数据
+// 原来每个统计函数（以及每个分数段）各扫一次表，现在统一由快照派生
+class StatisticsSnapshot
+{
+public:
+    static constexpr double PassScore = 60;
+    static constexpr double TopShare = 0.1;   // "前 10% 分数线"中的比例
+
+    // 默认分数段：0-59, 60-69, 70-79, 80-89, 90-100
+    static QVector<double> defaultBucketEdges();
+
+    // bucketEdges 为升序的 n+1 个边界，对应 n 个左闭右开的分数段，最后一段包含上界
+    QVector<double> bucketEdges;
+    QVector<ClassAggregate> classes;   // 按班级名称排序
+    ClassAggregate school;             // 全校合计
+
+    int bucketCount() const { return qMax(0, int(bucketEdges.size()) - 1); }
+    QString bucketLabel(int bucket) const;
+    void computeSchoolTotals();
+
+    // 与 Database 原有统计函数返回格式一致的视图
+    QVector<QMap<QString, QVariant>> subjectStats(Subject subject) const;
+    QVector<QMap<QString, QVariant>> classStats() const;
+    QVector<QMap<QString, QVariant>> scoreDistribution(Subject subject) const;
+    QVector<QMap<QString, QVariant>> trendData() const;
+};
+
+#endif // STATISTICSSNAPSHOT_H
@@ -1,18 +1,136 @@
 #include "studentmodel.h"
+#include "database.h"
+#include "radixsort.h"
+#include "editqueue.h"
+#include "asyncdatabase.h"
 #include <QBrush>
 #include <QColor>
+#include <QDebug>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+
+// 记录的分页键超过这个数量时清空，保证内存占用与表的大小无关
+static const int MaxPageAnchors = 4096;
+
+enum ModelColumn {
+    StuIdColumn = 0, NameColumn, ClassColumn,
+    // 成绩列按科目目录排列
+    FirstScoreColumn, LastScoreColumn = FirstScoreColumn + SubjectCount - 1, TotalColumn, AverageColumn,
+    // 排名列：先是总分，然后各科依次排列，每项分班级排名和全校排名两列
+    FirstRankColumn, LastRankColumn = FirstRankColumn + 2 * RankIndex::KeyCount - 1
+};
+
+// 排名列对应的排名依据
+static int rankKeyOf(int column)
+{
+    const int item = (column - FirstRankColumn) / 2;
+    return item == 0 ? RankIndex::TotalKey : item - 1;
+}
+
+static bool isSchoolRankColumn(int column)
+{
+    return (column - FirstRankColumn) % 2 == 1;
+}
+
+static bool isRankColumn(int column)
+{
+    return column >= FirstRankColumn && column <= LastRankColumn;
+}
+
+// 排名依据的取值，未录入为 NaN
+static float rankValue(const StudentTable &table, int row, int key)
+{
+    return key == RankIndex::TotalKey ? table.total(row) : table.score(row, Subject(key));
+}
+
+// 显示文本下标：0 表示空白（成绩未录入），NoText 表示去重表已满，需要当场格式化
+static const quint16 EmptyText = 0;
+static const quint16 NoText = 0xFFFF;
+
+// 成绩颜色等级
+enum Grade : quint8 { NoGrade = 0, Excellent, Pass, Fail };
+
+static Grade gradeOf(float score)
+{
+    if (StudentTable::isMissing(score)) return NoGrade;
+    if (score >= 90) return Excellent;
+    if (score >= 60) return Pass;
+    return Fail;
+}
+
+static bool isScoreColumn(int column)
+{
+    return column >= FirstScoreColumn && column <= LastScoreColumn;
+}
+
+static float numberAt(const StudentTable &table, int row, int column)
+{
+    switch (column) {
+    case TotalColumn: return table.total(row);
+    case AverageColumn: return table.average(row);
+    default: return table.score(row, Subject(column - FirstScoreColumn));
+    }
+}
+
+// 保持大小顺序的 32 位整数键：正数置符号位，负数按位取反；未录入（NaN）为 0，排在最前，与数据库中的 -1 一致
+static quint32 floatKey(float value)
+{
+    if (std::isnan(value))
+        return 0;
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// 没有名次（成绩未录入或排名索引未装载）时排在最后
+static quint32 rankKey(int rank)
+{
+    return rank > 0 ? quint32(rank) : 0xFFFFFFFFu;
+}
+
+static int compareKeys(quint32 a, quint32 b)
+{
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// 两行的学号、姓名、班级和各科成绩都相同；总分、平均分由成绩算出，不必比较
+static bool sameValues(const StudentTable &a, int rowA, const StudentTable &b, int rowB)
+{
+    if (a.stuId(rowA) != b.stuId(rowB) || a.name(rowA) != b.name(rowB) || a.className(rowA) != b.className(rowB))
+        return false;
+    for (int s = 0; s < SubjectCount; s++) {
+        const float x = a.score(rowA, Subject(s));
+        const float y = b.score(rowB, Subject(s));
+        if (x != y && !(StudentTable::isMissing(x) && StudentTable::isMissing(y)))
+            return false;
+    }
+    return true;
+}
+
+static QString formatNumber(float value, int precision)
+{
+    return precision < 0 ? QString::number(value) : QString::number(value, 'f', precision);
+}
 
 StudentModel::StudentModel(QObject *parent)
     : QAbstractTableModel(parent)
+    , pageCache(MaxCachedPages)
 {
     // 设置表头
-    headers << "学号" << "姓名" << "班级" << "语文" << "数学" << "英语" << "总分" << "平均分";
+    headers << "学号" << "姓名" << "班级";
+    for (int s = 0; s < SubjectCount; s++)
+        headers << subjectName(Subject(s));
+    headers << "总分" << "平均分" << "班级排名" << "全校排名";
+    for (int s = 0; s < SubjectCount; s++)
+        headers << subjectName(Subject(s)) + "班级排名" << subjectName(Subject(s)) + "全校排名";
 }
 
 int StudentModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    return studentList.size();
+    return pagedSource ? pagedRowCount : studentList.size();
 }
 
 int StudentModel::columnCount(const QModelIndex &parent) const
@@ -23,41 +141,94 @@ int StudentModel::columnCount(const QModelIndex &parent) const
 
 QVariant StudentModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() >= studentList.size())
+    if (!index.isValid() || index.row() >= rowCount())
         return QVariant();
 
-    const QMap<QString, QVariant> &student = studentList.at(index.row());
-
-    if (role == Qt::DisplayRole || role == Qt::EditRole) {
-        switch (index.column()) {
-        case 0: return student["stu_id"];
-        case 1: return student["name"];
-        case 2: return student["class"];
-        case 3: return student["chinese"].isNull() ? QVariant() : student["chinese"];
-        case 4: return student["math"].isNull() ? QVariant() : student["math"];
-        case 5: return student["english"].isNull() ? QVariant() : student["english"];
-        case 6: return student["total"];
-        case 7: return student["average"];
-        default: return QVariant();
-        }
-    }
-    else if (role == Qt::TextAlignmentRole) {
-        return Qt::AlignCenter;
-    }
-    else if (role == Qt::ForegroundRole) {
-        // 成绩颜色标记
-        if (index.column() >= 3 && index.column() <= 5) {
-            QVariant score = student[headers[index.column()].toLower()];
-            if (!score.isNull()) {
-                double value = score.toDouble();
-                if (value >= 90) return QBrush(QColor(0, 128, 0));    // 绿色 - 优秀
-                else if (value >= 60) return QBrush(QColor(0, 0, 0)); // 黑色 - 及格
-                else return QBrush(QColor(255, 0, 0));                // 红色 - 不及格
+    // 分页模式下不在这里等数据库：没有缓存的页交给读线程，先显示占位
+    int row = 0;
+    const RowDisplay *display = nullptr;
+    const StudentTable *table = tableForRow(index.row(), &row, &display);
+    if (!table) {
+        if (pageLoader && role == Qt::DisplayRole && index.column() == StuIdColumn)
+            return QStringLiteral("…");
+        return QVariant();
+    }
+    const StudentTable &students = *table;
+    const int column = index.column();
+
+    // 每次重绘都会对每个单元格调用多次，这里只做取值，不做格式化和内存分配
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (column) {
+        case StuIdColumn: return students.stuId(row);
+        case NameColumn: return students.name(row);
+        case ClassColumn: return students.className(row);
+        default:
+            if (column >= FirstScoreColumn && column <= AverageColumn) {
+                const quint16 text = display->text[column - FirstScoreColumn];
+                if (text == EmptyText)
+                    return QVariant();
+                if (text == NoText)
+                    return formatNumber(numberAt(students, row, column), column == AverageColumn ? 2 : -1);
+                return displayTexts.at(text);
             }
+            break;
         }
+        break;
+
+    case Qt::EditRole:
+        switch (column) {
+        case StuIdColumn: return students.stuId(row);
+        case NameColumn: return students.name(row);
+        case ClassColumn: return students.className(row);
+        case TotalColumn:
+        case AverageColumn: return numberAt(students, row, column);
+        default:
+            if (isScoreColumn(column)) {
+                float score = numberAt(students, row, column);
+                return StudentTable::isMissing(score) ? QVariant() : QVariant(score);
+            }
+            break;
+        }
+        break;
+
+    case Qt::TextAlignmentRole:
+        return int(Qt::AlignCenter);
+
+    case Qt::ForegroundRole: {
+        // 成绩颜色标记，画刷共用，QVariant 只增加引用计数
+        static const QBrush brushes[] = {
+            QBrush(),
+            QBrush(QColor(0, 128, 0)),   // 绿色 - 优秀
+            QBrush(QColor(0, 0, 0)),     // 黑色 - 及格
+            QBrush(QColor(255, 0, 0))    // 红色 - 不及格
+        };
+        if (!isScoreColumn(column))
+            return QVariant();
+        const int grade = (display->grades >> (2 * (column - FirstScoreColumn))) & 0x3;
+        return grade == NoGrade ? QVariant() : QVariant(brushes[grade]);
     }
 
-    return QVariant();
+    default:
+        return QVariant();
+    }
+
+    // 排名列：显示和编辑角色都返回整数名次
+    if (!isRankColumn(column))
+        return QVariant();
+    const int rank = rankAt(students, row, column);
+    return rank > 0 ? QVariant(rank) : QVariant();
+}
+
+// 排名索引装载之前返回 0
+int StudentModel::rankAt(const StudentTable &table, int row, int column) const
+{
+    if (!ranksLoaded)
+        return 0;
+    const int key = rankKeyOf(column);
+    const float score = rankValue(table, row, key);
+    return isSchoolRankColumn(column) ? ranks.schoolRank(key, score)
+                                      : ranks.classRank(table.className(row), key, score);
 }
 
 QVariant StudentModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -73,24 +244,1033 @@ QVariant StudentModel::headerData(int section, Qt::Orientation orientation, int
     return QVariant();
 }
 
-void StudentModel::setData(const QVector<QMap<QString, QVariant>> &students)
+Qt::ItemFlags StudentModel::flags(const QModelIndex &index) const
+{
+    Qt::ItemFlags flags = QAbstractTableModel::flags(index);
+    const int column = index.column();
+    if (editQueue && index.isValid() && (column == NameColumn || column == ClassColumn || isScoreColumn(column)))
+        flags |= Qt::ItemIsEditable;
+    return flags;
+}
+
+bool StudentModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (role != Qt::EditRole || !(flags(index) & Qt::ItemIsEditable))
+        return false;
+
+    const int row = index.row();
+    const int column = index.column();
+    const StudentTable current = rowCopy(row);
+    if (current.isEmpty())
+        return false;
+
+    const int id = current.id(0);
+    QString name = current.name(0);
+    QString className = current.className(0);
+    float scores[SubjectCount];
+    current.scoreMatrix().rowScores(0, scores);
+
+    // 姓名、班级不能为空；成绩留空表示未录入，否则须在 0 到满分之间，与录入对话框的校验一致
+    const QString text = value.toString().trimmed();
+    if (column == NameColumn || column == ClassColumn) {
+        if (text.isEmpty())
+            return false;
+        QString &field = column == NameColumn ? name : className;
+        if (field == text)
+            return true;
+        field = text;
+        if (column == NameColumn)
+            editQueue->setName(id, text);
+        else
+            editQueue->setClassName(id, text);
+    } else {
+        float score = NAN;
+        if (!text.isEmpty()) {
+            bool ok = false;
+            score = text.toFloat(&ok);
+            if (!ok || score < 0 || score > FullScore)
+                return false;
+        }
+        const Subject subject = Subject(column - FirstScoreColumn);
+        float &field = scores[int(subject)];
+        if (field == score || (StudentTable::isMissing(field) && StudentTable::isMissing(score)))
+            return true;
+        field = score;
+        editQueue->setScore(id, subject, score);
+    }
+
+    // 总分、平均分先按生成列的公式算出，写回后换成数据库中的值
+    float total = 0;
+    float average = 0;
+    StudentTable::totalsOf(scores, &total, &average);
+    StudentTable edited;
+    edited.append(id, current.stuId(0), name, className, scores, total, average);
+    replaceInPlace(row, edited, 0);
+    return true;
+}
+
+void StudentModel::refreshStudents(const StudentTable &rows)
+{
+    if (rows.isEmpty())
+        return;
+
+    QHash<int, int> sourceRows;
+    for (int i = 0; i < rows.size(); i++)
+        sourceRows.insert(rows.id(i), i);
+
+    // 分页模式只更新缓存中的页，其余的页之后从数据库读取时已是新值
+    if (pagedSource) {
+        const QList<int> pages = pageCache.keys();
+        for (int page : pages) {
+            const Page *cached = pageCache.object(page);
+            for (int localRow = 0; cached && localRow < cached->table.size(); localRow++) {
+                auto it = sourceRows.constFind(cached->table.id(localRow));
+                if (it != sourceRows.constEnd())
+                    replaceInPlace(page * PageSize + localRow, rows, it.value());
+            }
+        }
+        return;
+    }
+
+    for (int row = 0; row < studentList.size(); row++) {
+        auto it = sourceRows.constFind(studentList.id(row));
+        if (it != sourceRows.constEnd())
+            replaceInPlace(row, rows, it.value());
+    }
+}
+
+bool StudentModel::applyChanges(const QVector<int> &ids, const StudentTable &rows, bool insertNew, bool *ranksStale)
+{
+    *ranksStale = false;
+
+    QHash<int, int> sourceRows;
+    for (int i = 0; i < rows.size(); i++)
+        sourceRows.insert(rows.id(i), i);
+
+    // 变更的学生目前在表格中的行号
+    QHash<int, int> modelRows;
+    for (int id : ids)
+        modelRows.insert(id, -1);
+    if (pagedSource) {
+        const QList<int> pages = pageCache.keys();
+        for (int page : pages) {
+            const Page *cached = pageCache.object(page);
+            for (int localRow = 0; cached && localRow < cached->table.size(); localRow++) {
+                auto it = modelRows.find(cached->table.id(localRow));
+                if (it != modelRows.end())
+                    it.value() = page * PageSize + localRow;
+            }
+        }
+        // 不在缓存页中的学生无从知道原来的位置，也就无法判断行数和行号怎样变化
+        for (auto it = modelRows.constBegin(); it != modelRows.constEnd(); ++it) {
+            if (it.value() < 0)
+                return false;
+        }
+    } else {
+        for (int row = 0; row < studentList.size(); row++) {
+            auto it = modelRows.find(studentList.id(row));
+            if (it != modelRows.end())
+                it.value() = row;
+        }
+    }
+
+    for (int id : ids) {
+        // 前面的增删会移动其他行，按记下的行号就近查找；分页模式下所在的页可能已被淘汰，只能重新装载
+        int row = modelRows.value(id, -1);
+        if (row >= 0 && (row = findStudentById(row, id)) < 0)
+            return false;
+        auto source = sourceRows.constFind(id);
+
+        if (source == sourceRows.constEnd()) {
+            // 已从数据库删除
+            if (row >= 0) {
+                const StudentTable current = rowCopy(row);
+                if (current.isEmpty() || !removeStudent(row, current.stuId(0)))
+                    return false;
+            } else if (!insertNew) {
+                *ranksStale = ranksLoaded;
+            }
+            continue;
+        }
+
+        if (row >= 0) {
+            // 本程序自己写入的修改已经显示，不再重复更新
+            const StudentTable current = rowCopy(row);
+            if (!current.isEmpty() && sameValues(current, 0, rows, source.value()))
+                continue;
+            const int updated = updateStudent(row, rows, source.value());
+            if (updated < 0 && updated != RowPending)
+                return false;
+        } else if (insertNew) {
+            insertStudent(rows, source.value());
+        } else {
+            // 不在搜索结果中的学生：表格不变，但排名索引已经过时
+            *ranksStale = ranksLoaded;
+        }
+    }
+    return true;
+}
+
+int StudentModel::scoreColumn(Subject subject)
+{
+    return FirstScoreColumn + int(subject);
+}
+
+void StudentModel::setStudents(StudentTable students)
 {
     beginResetModel();
-    studentList = students;
+    pagedSource = nullptr;
+    pageLoader = nullptr;
+    pagedRowCount = 0;
+    pageCache.clear();
+    pageAnchors.clear();
+    dropPendingPages();
+    prepareSortIndex();
+    sourceGeneration++;
+    stringRankCache.clear();
+    studentList = std::move(students);
+    studentDisplay.clear();
+    appendDisplay(studentList, &studentDisplay);
+    // 模型正在重置，直接重排，不必发出布局变化
+    if (sortedColumn >= 0)
+        permuteRows(sortedOrderOfRows());
     endResetModel();
 }
 
-QMap<QString, QVariant> StudentModel::getStudent(int row) const
+void StudentModel::appendStudents(const StudentTable &students)
 {
-    if (row >= 0 && row < studentList.size()) {
-        return studentList.at(row);
-    }
-    return QMap<QString, QVariant>();
+    if (students.isEmpty() || pagedSource)
+        return;
+
+    // 追加的行先放在末尾，全部装载完成后由 resort 按当前排序重排
+    const int first = studentList.size();
+    beginInsertRows(QModelIndex(), first, first + students.size() - 1);
+    stringRankCache.clear();
+    studentList.append(students);
+    appendDisplay(students, &studentDisplay);
+    endInsertRows();
+}
+
+StudentRecord StudentModel::getStudent(int row) const
+{
+    int localRow = 0;
+    const StudentTable *table = tableForRow(row, &localRow);
+    return table ? table->record(localRow) : StudentTable().record(-1);
 }
 
 void StudentModel::clear()
+{
+    beginResetModel();
+    pagedSource = nullptr;
+    pageLoader = nullptr;
+    pagedRowCount = 0;
+    pageCache.clear();
+    pageAnchors.clear();
+    dropPendingPages();
+    prepareSortIndex();
+    sourceGeneration++;
+    stringRankCache.clear();
+    studentList.clear();
+    studentDisplay.clear();
+    endResetModel();
+}
+
+void StudentModel::sort(int column, Qt::SortOrder order)
+{
+    if (column < 0 || column >= columnCount()) {
+        column = -1;
+        order = Qt::AscendingOrder;
+    }
+    if (column == sortedColumn && order == sortedOrder)
+        return;
+
+    sortedColumn = column;
+    sortedOrder = order;
+
+    if (pagedSource) {
+        // 各页都要按新的顺序重新读取；原来的行号不再对应同一个学生，选中状态随之清除
+        emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+        pageCache.clear();
+        pageAnchors.clear();
+        dropPendingPages();
+        prepareSortIndex();
+        const QModelIndexList from = persistentIndexList();
+        changePersistentIndexList(from, QModelIndexList(from.size()));
+        emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+        return;
+    }
+
+    // 从某列排序回到未排序：按默认的 (class, stu_id) 排列
+    if (column < 0)
+        applyOrder(sortedOrderOfRows());
+    else
+        resort();
+}
+
+void StudentModel::resort()
+{
+    if (!pagedSource && sortedColumn >= 0 && studentList.size() > 1)
+        applyOrder(sortedOrderOfRows());
+}
+
+// 原地重排并把视图持有的持久索引（选中行、当前行）移到新的行号，不重置模型，滚动位置保持不变
+void StudentModel::applyOrder(const QVector<int> &order)
+{
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    QVector<int> newRow(order.size());
+    for (int i = 0; i < order.size(); i++)
+        newRow[order.at(i)] = i;
+    permuteRows(order);
+
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (const QModelIndex &index : from)
+        to << this->index(newRow.at(index.row()), index.column());
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+int StudentModel::insertStudent(const StudentTable &source, int sourceRow)
+{
+    if (pageLoader) {
+        StudentTable student;
+        student.appendRow(source, sourceRow);
+        placeStudent(student);
+        return RowPending;
+    }
+    return insertAt(sortedPosition(source, sourceRow), source, sourceRow);
+}
+
+// 分页模式：新行的位置要在数据库中计数，交给读线程，结果回到界面线程后再插入
+void StudentModel::placeStudent(const StudentTable &student)
+{
+    const int generation = sourceGeneration;
+    const int column = sortedColumn;
+    const Qt::SortOrder order = sortedOrder;
+
+    QFuture<int> position;
+    if (sortedColumn < 0) {
+        position = pageLoader->countStudentsBefore(student.className(0), student.stuId(0));
+    } else {
+        bool descending = false;
+        position = pageLoader->countSortedBefore(databaseSortColumn(&descending), descending, student.id(0));
+    }
+
+    position.then(this, [this, student, generation, column, order](int row) {
+        // 换了数据来源：新读取的页已包含这名学生
+        if (generation != sourceGeneration || !pagedSource)
+            return;
+        // 计数期间换了排序：按新的排序重新计数
+        if (column != sortedColumn || order != sortedOrder) {
+            placeStudent(student);
+            return;
+        }
+        row = insertAt(qBound(0, row, pagedRowCount), student, 0);
+        emit studentPlaced(student.id(0), row);
+    });
+}
+
+int StudentModel::insertAt(int row, const StudentTable &source, int sourceRow)
+{
+    beginInsertRows(QModelIndex(), row, row);
+    if (pagedSource) {
+        pagedRowCount++;
+        invalidatePagesFrom(row);
+    } else {
+        stringRankCache.clear();
+        studentList.insertRow(row, source, sourceRow);
+        studentDisplay.insert(row, displayFor(source, sourceRow));
+    }
+    endInsertRows();
+
+    if (ranksLoaded) {
+        ranks.addStudent(source, sourceRow);
+        rankColumnsChanged(StudentTable(), 0, source, sourceRow);
+        resortAfterRankChange(&row);
+    }
+    return row;
+}
+
+int StudentModel::updateStudent(int row, const StudentTable &source, int sourceRow)
+{
+    // 分页模式下读取别的页可能淘汰当前页，先把这一行复制出来
+    const StudentTable current = rowCopy(row);
+    if (current.isEmpty() || current.id(0) != source.id(sourceRow))
+        return -1;
+
+    // 排序依据变了，行的位置随之改变
+    if (sortKeyChanged(current, source, sourceRow)) {
+        if (!removeStudent(row, current.stuId(0)))
+            return -1;
+        return insertStudent(source, sourceRow);
+    }
+
+    if (pagedSource) {
+        invalidatePagesFrom(row);
+    } else {
+        stringRankCache.clear();
+        studentList.replaceRow(row, source, sourceRow);
+        studentDisplay[row] = displayFor(source, sourceRow);
+    }
+    emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+
+    if (ranksLoaded) {
+        ranks.removeStudent(current, 0);
+        ranks.addStudent(source, sourceRow);
+        rankColumnsChanged(current, 0, source, sourceRow);
+        resortAfterRankChange(&row);
+    }
+    return row;
+}
+
+bool StudentModel::removeStudent(int row, const QString &stuId)
+{
+    row = findStudent(row, stuId);
+    if (row < 0)
+        return false;
+
+    const StudentTable removed = ranksLoaded ? rowCopy(row) : StudentTable();
+
+    beginRemoveRows(QModelIndex(), row, row);
+    if (pagedSource) {
+        pagedRowCount--;
+        invalidatePagesFrom(row);
+    } else {
+        stringRankCache.clear();
+        studentList.removeRow(row);
+        studentDisplay.remove(row);
+    }
+    endRemoveRows();
+
+    if (!removed.isEmpty()) {
+        ranks.removeStudent(removed, 0);
+        rankColumnsChanged(removed, 0, StudentTable(), 0);
+        resortAfterRankChange(nullptr);
+    }
+    return true;
+}
+
+void StudentModel::setRankIndex(RankIndex index)
+{
+    ranks = std::move(index);
+    ranksLoaded = true;
+    if (rowCount() > 0)
+        emit dataChanged(index(0, FirstRankColumn), index(rowCount() - 1, LastRankColumn));
+    // 按排名列排序时，索引装载之前各行都没有名次，现在按名次重排
+    if (isRankColumn(sortedColumn) && !pagedSource)
+        resort();
+}
+
+// 按班级排名排序时，一名学生的变化会改变同班其他人的名次，与别的班之间的先后可能随之改变，整表重排
+// 按全校排名排序时其他人的名次同增同减，先后不变；row 非空时改为该学生重排后的行号
+void StudentModel::resortAfterRankChange(int *row)
+{
+    if (pagedSource || !isRankColumn(sortedColumn) || isSchoolRankColumn(sortedColumn))
+        return;
+
+    const int id = row && *row >= 0 && *row < studentList.size() ? studentList.id(*row) : -1;
+    resort();
+    if (id < 0)
+        return;
+    for (int i = 0; i < studentList.size(); i++) {
+        if (studentList.id(i) == id) {
+            *row = i;
+            return;
+        }
+    }
+}
+
+// 一名学生从 before 变为 after（插入时 before 为空，删除时 after 为空）后名次可能改变的行：
+// 某项成绩落在该生新旧成绩之间的学生（名次 = 1 + 分数更高的人数，只有这些人之上的人数变了），
+// 插入或删除时缺少的一侧视为最低，即新增或去掉的分数以下的所有人；换班时另加新旧两个班的全部学生
+// 只通知这些行，相邻的行合并为一次；分页模式只看缓存的页，其他页装载时按当时的索引计算名次
+void StudentModel::rankColumnsChanged(const StudentTable &before, int beforeRow,
+                                      const StudentTable &after, int afterRow)
+{
+    // 同班内的名次也只在区间内变化，只有换班时两个班的名次才整体改变
+    QString oldClass;
+    QString newClass;
+    if (!before.isEmpty() && !after.isEmpty() && before.className(beforeRow) != after.className(afterRow)) {
+        oldClass = before.className(beforeRow);
+        newClass = after.className(afterRow);
+    }
+
+    // 分段精度以内视为并列，区间两端各放宽一个精度单位
+    const float tie = 1.0f / RankIndex::ScoreScale;
+    float lows[RankIndex::KeyCount];
+    float highs[RankIndex::KeyCount];
+    int keys[RankIndex::KeyCount];
+    int keyCount = 0;
+    for (int key = 0; key < RankIndex::KeyCount; key++) {
+        const float oldValue = before.isEmpty() ? NAN : rankValue(before, beforeRow, key);
+        const float newValue = after.isEmpty() ? NAN : rankValue(after, afterRow, key);
+        if (std::isnan(oldValue) && std::isnan(newValue))
+            continue;
+        if (oldValue == newValue)
+            continue;   // 这一项没变，其他人的名次不受影响
+        const float low = std::isnan(oldValue) || std::isnan(newValue) ? -INFINITY : std::min(oldValue, newValue);
+        const float high = std::isnan(oldValue) ? newValue : std::isnan(newValue) ? oldValue : std::max(oldValue, newValue);
+        lows[keyCount] = low - tie;
+        highs[keyCount] = high + tie;
+        keys[keyCount++] = key;
+    }
+
+    auto affected = [&](const StudentTable &table, int row) {
+        const QString &className = table.className(row);
+        if (!oldClass.isNull() && (className == oldClass || className == newClass))
+            return true;
+        for (int i = 0; i < keyCount; i++) {
+            const float value = rankValue(table, row, keys[i]);
+            if (value >= lows[i] && value <= highs[i])
+                return true;
+        }
+        return false;
+    };
+
+    // 没有一项成绩变化，也没换班（例如只改了姓名）时名次都不变
+    if (keyCount == 0 && oldClass.isNull())
+        return;
+
+    int first = -1;
+    int last = -1;
+    auto emitRun = [&]() {
+        if (first >= 0)
+            emit dataChanged(index(first, FirstRankColumn), index(last, LastRankColumn));
+        first = -1;
+    };
+    auto mark = [&](int row) {
+        if (first >= 0 && row != last + 1)
+            emitRun();
+        if (first < 0)
+            first = row;
+        last = row;
+    };
+
+    if (!pagedSource) {
+        for (int row = 0; row < studentList.size(); row++) {
+            if (affected(studentList, row))
+                mark(row);
+        }
+    } else {
+        QList<int> pages = pageCache.keys();
+        std::sort(pages.begin(), pages.end());
+        for (int page : pages) {
+            const Page *cached = pageCache.object(page);
+            for (int localRow = 0; cached && localRow < cached->table.size(); localRow++) {
+                const int row = page * PageSize + localRow;
+                if (row < pagedRowCount && affected(cached->table, localRow))
+                    mark(row);
+            }
+        }
+    }
+    emitRun();
+}
+
+void StudentModel::setPagedSource(Database *database, int rowCount, AsyncDatabase *loader)
 {
     beginResetModel();
     studentList.clear();
+    studentDisplay.clear();
+    pageCache.clear();
+    pageAnchors.clear();
+    dropPendingPages();
+    pagedSource = database;
+    pageLoader = database ? loader : nullptr;
+    pagedRowCount = database ? rowCount : 0;
+    firstPageSeen = false;
+    prepareSortIndex();
+    sourceGeneration++;
     endResetModel();
 }
+
+// source 中第 sourceRow 行在当前排序下应处的行号
+// 分页模式由数据库计数；内存中的表已排好序，二分查找即可
+int StudentModel::sortedPosition(const StudentTable &source, int sourceRow) const
+{
+    const QString &className = source.className(sourceRow);
+    const QString &stuId = source.stuId(sourceRow);
+    if (pagedSource) {
+        if (sortedColumn < 0)
+            return pagedSource->countStudentsBefore(className, stuId);
+        bool descending = false;
+        const int column = databaseSortColumn(&descending);
+        return pagedSource->countSortedBefore(column, descending, source.id(sourceRow));
+    }
+
+    int low = 0;
+    int high = studentList.size();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        bool before;
+        if (sortedColumn < 0) {
+            const int order = studentList.className(middle).compare(className);
+            before = order < 0 || (order == 0 && studentList.stuId(middle) < stuId);
+        } else {
+            before = sortsBefore(studentList, middle, source, sourceRow);
+        }
+        if (before)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// 按排序列比较两行的取值，规则与 sortedOrderOfRows 中的键一致
+int StudentModel::compareValues(const StudentTable &a, int rowA, const StudentTable &b, int rowB, int column) const
+{
+    switch (column) {
+    case StuIdColumn: return a.stuId(rowA).compare(b.stuId(rowB));
+    case NameColumn: return a.name(rowA).compare(b.name(rowB));
+    case ClassColumn: return a.className(rowA).compare(b.className(rowB));
+    default:
+        if (isRankColumn(column))
+            return compareKeys(rankKey(rankAt(a, rowA, column)), rankKey(rankAt(b, rowB, column)));
+        return compareKeys(floatKey(numberAt(a, rowA, column)), floatKey(numberAt(b, rowB, column)));
+    }
+}
+
+// 按当前排序列，a 的第 rowA 行是否排在 b 的第 rowB 行之前；取值相同时按 id
+bool StudentModel::sortsBefore(const StudentTable &a, int rowA, const StudentTable &b, int rowB) const
+{
+    int order = compareValues(a, rowA, b, rowB, sortedColumn);
+    if (order == 0)
+        order = a.id(rowA) - b.id(rowB);
+    return sortedOrder == Qt::AscendingOrder ? order < 0 : order > 0;
+}
+
+// current 是修改前的一行，修改后的取值是否可能改变它在当前排序中的位置
+bool StudentModel::sortKeyChanged(const StudentTable &current, const StudentTable &source, int sourceRow) const
+{
+    if (sortedColumn < 0)
+        return current.className(0) != source.className(sourceRow) || current.stuId(0) != source.stuId(sourceRow);
+    if (!isRankColumn(sortedColumn))
+        return compareValues(current, 0, source, sourceRow, sortedColumn) != 0;
+
+    // 名次由分数决定；班级排名还取决于所在的班级
+    const int key = rankKeyOf(sortedColumn);
+    const float before = key == RankIndex::TotalKey ? current.total(0) : current.score(0, Subject(key));
+    const float after = key == RankIndex::TotalKey ? source.total(sourceRow) : source.score(sourceRow, Subject(key));
+    return floatKey(before) != floatKey(after)
+        || (!isSchoolRankColumn(sortedColumn) && current.className(0) != source.className(sourceRow));
+}
+
+// 分页模式下排序列对应的数据库列
+int StudentModel::databaseSortColumn(bool *descending) const
+{
+    *descending = sortedOrder == Qt::DescendingOrder;
+    switch (sortedColumn) {
+    case StuIdColumn: return Database::ColStuId;
+    case NameColumn: return Database::ColName;
+    case ClassColumn: return Database::ColClass;
+    case TotalColumn: return Database::ColTotal;
+    case AverageColumn: return Database::ColAverage;
+    default:
+        break;
+    }
+    if (isScoreColumn(sortedColumn))
+        return Database::ColFirstScore + (sortedColumn - FirstScoreColumn);
+
+    // 名次越小分数越高，按分数反向排列；班级排名在整张表上没有对应的顺序，按全校排名近似
+    *descending = !*descending;
+    const int key = rankKeyOf(sortedColumn);
+    return key == RankIndex::TotalKey ? Database::ColTotal : Database::ColFirstScore + key;
+}
+
+const QVector<quint32> &StudentModel::stringRanks(int column)
+{
+    auto it = stringRankCache.constFind(column);
+    if (it != stringRankCache.constEnd())
+        return it.value();
+
+    auto text = [this, column](int row) -> const QString & {
+        return column == StuIdColumn ? studentList.stuId(row) : studentList.name(row);
+    };
+    const int n = studentList.size();
+    QVector<int> rows(n);
+    std::iota(rows.begin(), rows.end(), 0);
+    std::sort(rows.begin(), rows.end(), [&text](int a, int b) { return text(a) < text(b); });
+
+    QVector<quint32> result(n);
+    quint32 rank = 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && text(rows.at(i)) != text(rows.at(i - 1)))
+            rank++;
+        result[rows.at(i)] = rank;
+    }
+    return stringRankCache.insert(column, result).value();
+}
+
+// 每行一个 64 位键：高 32 位为排序列的取值，低 32 位为 id，同值的行按 id 排列，与数据库中的 ORDER BY 列, id 一致
+// 降序时整个键按位取反，同值的行也随之按 id 降序；未排序时按 (class, stu_id)
+QVector<int> StudentModel::sortedOrderOfRows()
+{
+    const int n = studentList.size();
+    const int column = sortedColumn;
+    QVector<quint64> keys(n);
+
+    // 班级名称已去重，只需给各个名称排一次序
+    QVector<quint32> classRanks;
+    if (column < 0 || column == ClassColumn) {
+        const QStringList &classNames = studentList.classNameList();
+        QVector<int> sorted(classNames.size());
+        std::iota(sorted.begin(), sorted.end(), 0);
+        std::sort(sorted.begin(), sorted.end(), [&classNames](int a, int b) { return classNames.at(a) < classNames.at(b); });
+        classRanks.resize(classNames.size());
+        for (int i = 0; i < sorted.size(); i++)
+            classRanks[sorted.at(i)] = quint32(i);
+    }
+
+    if (column < 0) {
+        // 学号不重复，不必再按 id 区分
+        const QVector<quint32> &stuIds = stringRanks(StuIdColumn);
+        for (int row = 0; row < n; row++)
+            keys[row] = (quint64(classRanks.at(studentList.classNameIndex(row))) << 32) | stuIds.at(row);
+        return radixSortOrder(keys);
+    }
+
+    if (column == StuIdColumn || column == NameColumn) {
+        const QVector<quint32> &texts = stringRanks(column);
+        for (int row = 0; row < n; row++)
+            keys[row] = (quint64(texts.at(row)) << 32) | quint32(studentList.id(row));
+    } else if (column == ClassColumn) {
+        for (int row = 0; row < n; row++)
+            keys[row] = (quint64(classRanks.at(studentList.classNameIndex(row))) << 32) | quint32(studentList.id(row));
+    } else if (isRankColumn(column)) {
+        for (int row = 0; row < n; row++)
+            keys[row] = (quint64(rankKey(rankAt(studentList, row, column))) << 32) | quint32(studentList.id(row));
+    } else {
+        for (int row = 0; row < n; row++)
+            keys[row] = (quint64(floatKey(numberAt(studentList, row, column))) << 32) | quint32(studentList.id(row));
+    }
+
+    if (sortedOrder == Qt::DescendingOrder) {
+        for (quint64 &key : keys)
+            key = ~key;
+    }
+    return radixSortOrder(keys);
+}
+
+// 按 order 重排各行及逐行缓存的数据，不发出信号
+void StudentModel::permuteRows(const QVector<int> &order)
+{
+    studentList = studentList.reordered(order);
+
+    QVector<RowDisplay> display(order.size());
+    for (int i = 0; i < order.size(); i++)
+        display[i] = studentDisplay.at(order.at(i));
+    studentDisplay = std::move(display);
+
+    for (QVector<quint32> &cached : stringRankCache) {
+        QVector<quint32> moved(order.size());
+        for (int i = 0; i < order.size(); i++)
+            moved[i] = cached.at(order.at(i));
+        cached = std::move(moved);
+    }
+}
+
+// 先看预期的行，不对时（例如期间表格有过变化）在内存中顺序查找；分页模式不做查找
+int StudentModel::findStudent(int row, const QString &stuId) const
+{
+    StudentRecord student = getStudent(row);
+    if (student.isValid() && student.stuId() == stuId)
+        return row;
+
+    if (!pagedSource) {
+        for (int i = 0; i < studentList.size(); i++) {
+            if (studentList.stuId(i) == stuId)
+                return i;
+        }
+    }
+    return -1;
+}
+
+// 就地替换第 row 行的取值，不改变位置；同步排名索引
+void StudentModel::replaceInPlace(int row, const StudentTable &source, int sourceRow)
+{
+    const StudentTable current = rowCopy(row);
+    if (current.isEmpty())
+        return;
+
+    if (pagedSource) {
+        if (Page *cached = pageCache.object(row / PageSize)) {
+            cached->table.replaceRow(row % PageSize, source, sourceRow);
+            cached->display[row % PageSize] = displayFor(source, sourceRow);
+        }
+    } else {
+        stringRankCache.clear();
+        studentList.replaceRow(row, source, sourceRow);
+        studentDisplay[row] = displayFor(source, sourceRow);
+    }
+    emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+
+    if (ranksLoaded) {
+        ranks.removeStudent(current, 0);
+        ranks.addStudent(source, sourceRow);
+        rankColumnsChanged(current, 0, source, sourceRow);
+    }
+}
+
+// 与 findStudent 相同，按数据库 id 查找；分页模式只在缓存的页中查找
+int StudentModel::findStudentById(int row, int id) const
+{
+    if (pagedSource) {
+        const Page *cached = pageCache.object(row / PageSize);
+        if (cached && row % PageSize < cached->table.size() && cached->table.id(row % PageSize) == id)
+            return row;
+        const QList<int> pages = pageCache.keys();
+        for (int page : pages) {
+            cached = pageCache.object(page);
+            for (int localRow = 0; cached && localRow < cached->table.size(); localRow++) {
+                if (cached->table.id(localRow) == id)
+                    return page * PageSize + localRow;
+            }
+        }
+        return -1;
+    }
+
+    if (row >= 0 && row < studentList.size() && studentList.id(row) == id)
+        return row;
+    for (int i = 0; i < studentList.size(); i++) {
+        if (studentList.id(i) == id)
+            return i;
+    }
+    return -1;
+}
+
+StudentTable StudentModel::rowCopy(int row) const
+{
+    StudentTable copy;
+    int localRow = 0;
+    if (const StudentTable *table = tableForRow(row, &localRow))
+        copy.appendRow(*table, localRow);
+    return copy;
+}
+
+// row 之后的行号都已改变：丢掉从 row 所在页开始的缓存页，以及依赖这些行的分页键
+void StudentModel::invalidatePagesFrom(int row)
+{
+    const int firstPage = row / PageSize;
+    const QList<int> pages = pageCache.keys();
+    for (int page : pages) {
+        if (page >= firstPage)
+            pageCache.remove(page);
+    }
+
+    // 第 k 页的分页键是第 k*PageSize-1 行，位于 row 之前的仍然有效
+    pageAnchors.erase(pageAnchors.upperBound(firstPage), pageAnchors.end());
+    dropPendingPages();
+}
+
+const StudentTable *StudentModel::tableForRow(int row, int *localRow, const RowDisplay **display) const
+{
+    if (!pagedSource) {
+        if (row < 0 || row >= studentList.size())
+            return nullptr;
+        *localRow = row;
+        if (display)
+            *display = &studentDisplay.at(row);
+        return &studentList;
+    }
+
+    if (row < 0 || row >= pagedRowCount)
+        return nullptr;
+
+    const int page = row / PageSize;
+    const Page *cached = pageCache.object(page);
+    if (!cached && pageLoader) {
+        if (sortIndexPending)
+            return nullptr;   // 索引建好后会通知整张表重绘
+        // 界面线程上不读数据库；不在缓存中的行在 data() 中显示占位，局部更新时视为找不到，由调用方重新装载
+        // data() 等是 const 函数；发出读取请求只改动分页缓存的状态，不改变模型对外的数据
+        StudentModel *self = const_cast<StudentModel *>(this);
+        self->requestPage(page);
+        // 顺带预读下一页，向下滚动时通常已经读好
+        if ((page + 1) * PageSize < pagedRowCount && !pageCache.contains(page + 1))
+            self->requestPage(page + 1);
+        return nullptr;
+    }
+    if (!cached)
+        cached = fetchPage(page);
+
+    *localRow = row % PageSize;
+    if (!cached || *localRow >= cached->table.size())
+        return nullptr;
+    if (display)
+        *display = &cached->display.at(*localRow);
+    return &cached->table;
+}
+
+StudentModel::PageQuery StudentModel::pageQuery(int page) const
+{
+    PageQuery query{QString(), QString(), -1, page * PageSize};
+    auto it = pageAnchors.upperBound(page);
+    if (it != pageAnchors.begin()) {
+        --it;
+        query.afterClass = it.value().className;
+        query.afterStuId = it.value().stuId;
+        query.afterId = it.value().id;
+        query.skip = (page - it.key()) * PageSize;
+    }
+    return query;
+}
+
+const StudentModel::Page *StudentModel::fetchPage(int page) const
+{
+    const PageQuery query = pageQuery(page);
+    if (sortedColumn < 0)
+        return storePage(page, pagedSource->getStudentPage(query.afterClass, query.afterStuId, query.skip, PageSize));
+
+    bool descending = false;
+    const int column = databaseSortColumn(&descending);
+    return storePage(page, pagedSource->getSortedStudentPage(column, descending, query.afterId, query.skip, PageSize));
+}
+
+// 同一页只请求一次；结果回到界面线程后由 pageArrived 放入缓存
+void StudentModel::requestPage(int page)
+{
+    if (pendingPages.contains(page))
+        return;
+    pendingPages.insert(page);
+
+    const PageQuery query = pageQuery(page);
+    QFuture<StudentTable> future;
+    if (sortedColumn < 0) {
+        future = pageLoader->getStudentPage(query.afterClass, query.afterStuId, query.skip, PageSize);
+    } else {
+        bool descending = false;
+        const int column = databaseSortColumn(&descending);
+        future = pageLoader->getSortedStudentPage(column, descending, query.afterId, query.skip, PageSize);
+    }
+
+    const int generation = pageGeneration;
+    future.then(this, [this, page, generation](const StudentTable &table) {
+        pageArrived(page, generation, table);
+    });
+}
+
+void StudentModel::pageArrived(int page, int generation, const StudentTable &table)
+{
+    if (!pagedSource)
+        return;
+
+    const int first = page * PageSize;
+    if (generation != pageGeneration) {
+        // 读取期间行号变了，结果作废；通知这一页重绘，仍然可见时会按新的行号重新请求
+        if (first < pagedRowCount)
+            emit dataChanged(index(first, 0), index(qMin(first + PageSize, pagedRowCount) - 1, columnCount() - 1));
+        return;
+    }
+
+    pendingPages.remove(page);
+    if (first >= pagedRowCount || pageCache.contains(page))
+        return;
+    storePage(page, table);
+    emit dataChanged(index(first, 0), index(qMin(first + PageSize, pagedRowCount) - 1, columnCount() - 1));
+    if (!firstPageSeen) {
+        firstPageSeen = true;
+        emit firstPageLoaded();
+    }
+}
+
+void StudentModel::dropPendingPages()
+{
+    pendingPages.clear();
+    pageGeneration++;
+}
+
+// 读线程上的连接是只读的，没有索引时每读一页都要全表排序再跳过 OFFSET 行
+// 按列排序时先在写线程上建立该列的索引，建好之前各页显示占位，建好后通知重绘，各页再由读线程读取
+void StudentModel::prepareSortIndex()
+{
+    sortIndexRequest++;
+    sortIndexPending = false;
+    if (!pageLoader || sortedColumn < 0)
+        return;
+
+    bool descending = false;
+    const int column = databaseSortColumn(&descending);
+    const int request = sortIndexRequest;
+    sortIndexPending = true;
+    pageLoader->ensureSortIndex(column).then(this, [this, request](bool ok) {
+        if (request != sortIndexRequest)
+            return;
+        if (!ok)
+            qDebug() << "排序索引建立失败，按该列分页读取会较慢";
+        sortIndexPending = false;
+        if (pagedRowCount > 0)
+            emit dataChanged(index(0, 0), index(pagedRowCount - 1, columnCount() - 1));
+    });
+}
+
+const StudentModel::Page *StudentModel::storePage(int page, StudentTable rows) const
+{
+    Page *cached = new Page;
+    cached->table = std::move(rows);
+    StudentTable &table = cached->table;
+
+    // 记下本页最后一行，作为下一页的分页键；键取数据库中的值，在套用未写回的修改之前记下
+    if (table.size() == PageSize) {
+        if (pageAnchors.size() >= MaxPageAnchors)
+            pageAnchors.clear();
+        const int last = table.size() - 1;
+        pageAnchors.insert(page + 1, PageAnchor{table.className(last), table.stuId(last), table.id(last)});
+    }
+
+    // 还没写回数据库的修改，读出的页上要套用界面中的值
+    if (editQueue)
+        editQueue->overlay(table);
+    appendDisplay(table, &cached->display);
+
+    pageCache.insert(page, cached);  // 超出容量时 QCache 会淘汰最久未使用的页
+    return pageCache.object(page);
+}
+
+StudentModel::RowDisplay StudentModel::displayFor(const StudentTable &table, int row) const
+{
+    RowDisplay display;
+    display.grades = 0;
+    for (int column = FirstScoreColumn; column <= AverageColumn; column++) {
+        const float value = numberAt(table, row, column);
+        display.text[column - FirstScoreColumn] = textIndex(value, column == AverageColumn ? 2 : -1);
+        if (isScoreColumn(column))
+            display.grades |= quint32(gradeOf(value)) << (2 * (column - FirstScoreColumn));
+    }
+    return display;
+}
+
+void StudentModel::appendDisplay(const StudentTable &table, QVector<RowDisplay> *display) const
+{
+    display->reserve(display->size() + table.size());
+    for (int row = 0; row < table.size(); row++)
+        display->append(displayFor(table, row));
+}
+
+quint16 StudentModel::textIndex(float value, int precision) const
+{
+    if (StudentTable::isMissing(value))
+        return EmptyText;
+
+    if (displayTexts.isEmpty())
+        displayTexts.append(QString());   // 下标 0 留给空白
+
+    // 同一个数值按不同精度格式化结果不同，键中同时记下精度
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const quint64 key = (quint64(quint8(precision)) << 32) | bits;
+
+    auto it = displayTextLookup.constFind(key);
+    if (it != displayTextLookup.constEnd())
+        return it.value();
+
+    if (displayTexts.size() >= NoText)
+        return NoText;
+
+    const quint16 index = quint16(displayTexts.size());
+    displayTexts.append(formatNumber(value, precision));
+    displayTextLookup.insert(key, index);
+    return index;
+}
@@ -2,9 +2,17 @@
 #define STUDENTMODEL_H
 
 #include <QAbstractTableModel>
-#include <QVector>
-#include <QMap>
 #include <QVariant>
+#include <QCache>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include "studenttable.h"
+#include "rankindex.h"
+
+class Database;
+class AsyncDatabase;
+class EditQueue;
 
 class StudentModel : public QAbstractTableModel
 {
@@ -18,15 +26,161 @@ public:
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    // 点击表头排序：内存中的表按预先算好的整数键做基数排序后原地重排，分页模式改由数据库按该列的索引排序
+    // column 为 -1 时回到默认排序 (class, stu_id)；视图的选中行、当前行随行移动，滚动位置不变
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
     // 自定义函数
-    void setData(const QVector<QMap<QString, QVariant>> &students);
-    QMap<QString, QVariant> getStudent(int row) const;
+    void setStudents(StudentTable students);
+    void appendStudents(const StudentTable &students);   // 异步查询逐块追加
+    StudentRecord getStudent(int row) const;
+    const StudentTable &students() const { return studentList; }   // 分页模式下为空
     void clear();
+    // 内存中的表按当前的排序列重新排列，逐块装载完成后调用；没有选择排序列时保持装载时的顺序（例如搜索结果按相关度）
+    void resort();
+    int sortColumn() const { return sortedColumn; }
+    Qt::SortOrder sortOrder() const { return sortedOrder; }
+
+    // 局部更新：source 中第 sourceRow 行是刚写入数据库的学生
+    // 按当前排序插入到对应位置，返回插入后的行号；分页模式下位置由读线程计数，返回 RowPending，
+    // 插入后发出 studentPlaced
+    int insertStudent(const StudentTable &source, int sourceRow);
+    // 修改第 row 行；排序依据变化导致位置改变时先删后插，返回新的行号（或 RowPending），失败返回 -1
+    int updateStudent(int row, const StudentTable &source, int sourceRow);
+    static constexpr int RowPending = -2;
+    // 删除学号为 stuId 的行，row 为预期所在行；找不到时返回 false，调用方应重新装载
+    bool removeStudent(int row, const QString &stuId);
+
+    // 就地修改：设置写回队列后，姓名、班级和各科成绩可以直接在表格中修改
+    // 修改立即显示并同步排名索引，由队列批量写回数据库；为免录入时行跳走，修改后的行留在原位，重新排序后才按新值排列
+    void setEditQueue(EditQueue *queue) { editQueue = queue; }
+    // 写回完成后用数据库中的值更新对应的行（失败的行恢复为原有的值），位置不变
+    void refreshStudents(const StudentTable &rows);
+    static int scoreColumn(Subject subject);
+
+    // 外部修改的增量刷新：ids 为数据库中变更过的学生，rows 为其中仍然存在的学生的当前值
+    // 表格中已有的行更新或删除，insertNew 为 true 时把新出现的学生插入到排序位置（显示全部学生时），否则不显示
+    // 表格中没有的学生的变化无法同步到排名索引，此时 ranksStale 置为 true，调用方应重新装载排名
+    // 分页模式下变更的学生不全在缓存的页中时返回 false，调用方应重新装载
+    bool applyChanges(const QVector<int> &ids, const StudentTable &rows, bool insertNew, bool *ranksStale);
+
+    // 排名列的数据来源，反映整个数据库而不只是当前显示的行（例如搜索结果）
+    // 上面三个局部更新函数会同步增减索引中的对应学生
+    void setRankIndex(RankIndex index);
+    const RankIndex &rankIndex() const { return ranks; }
+
+    // 分页模式：只缓存可见区域附近的若干页，其余按需从数据库读取
+    // rowCount 为数据库中已统计好的总行数；给出 loader 时重绘用到的页在读线程上读取，
+    // 读到之前显示占位，读到后发出 dataChanged；没有 loader 时在调用线程上直接读取
+    void setPagedSource(Database *database, int rowCount, AsyncDatabase *loader = nullptr);
+    bool isPaged() const { return pagedSource != nullptr; }
+
+    static constexpr int PageSize = 256;
+    static constexpr int MaxCachedPages = 64;
+
+signals:
+    // 分页模式下 insertStudent 返回 RowPending 的学生已插入到第 row 行
+    void studentPlaced(int id, int row);
+    // 分页模式下设置数据源后第一次有页从读线程读到
+    void firstPageLoaded();
 
 private:
-    QVector<QMap<QString, QVariant>> studentList;
+    // 每行预先算好的显示数据，data() 中直接取用，不再逐次格式化
+    struct RowDisplay
+    {
+        quint16 text[SubjectCount + 2];   // 各科成绩、总分、平均分的显示文本在 displayTexts 中的下标
+        quint32 grades;                   // 各科成绩的颜色等级，每科 2 位
+    };
+    static_assert(SubjectCount <= 16, "颜色等级每科占 2 位，科目数不能超过 16");
+
+    // 分页模式下缓存的一页及其显示数据
+    struct Page
+    {
+        StudentTable table;
+        QVector<RowDisplay> display;
+    };
+
+    // 分页键：某页之前最后一行的 (class, stu_id)；按其他列排序时只用 id，由数据库查出该行的排序值
+    struct PageAnchor
+    {
+        QString className;
+        QString stuId;
+        int id;
+    };
+
+    // 分页读取的起点：不超过目标页的最近一个分页键，剩余的页数用 OFFSET 跳过
+    struct PageQuery
+    {
+        QString afterClass;
+        QString afterStuId;
+        int afterId;
+        int skip;
+    };
+
+    // 分页模式下缓存中没有的页：有读线程时交给读线程读取，返回 nullptr；否则当场读取
+    const StudentTable *tableForRow(int row, int *localRow, const RowDisplay **display = nullptr) const;
+    PageQuery pageQuery(int page) const;
+    const Page *fetchPage(int page) const;
+    const Page *storePage(int page, StudentTable rows) const;
+    void requestPage(int page);
+    void pageArrived(int page, int generation, const StudentTable &table);
+    void dropPendingPages();
+    void prepareSortIndex();
+    int insertAt(int row, const StudentTable &source, int sourceRow);
+    void placeStudent(const StudentTable &student);
+    RowDisplay displayFor(const StudentTable &table, int row) const;
+    void appendDisplay(const StudentTable &table, QVector<RowDisplay> *display) const;
+    quint16 textIndex(float value, int precision) const;
+    int sortedPosition(const StudentTable &source, int sourceRow) const;
+    int rankAt(const StudentTable &table, int row, int column) const;
+    int compareValues(const StudentTable &a, int rowA, const StudentTable &b, int rowB, int column) const;
+    bool sortsBefore(const StudentTable &a, int rowA, const StudentTable &b, int rowB) const;
+    bool sortKeyChanged(const StudentTable &current, const StudentTable &source, int sourceRow) const;
+    int databaseSortColumn(bool *descending) const;
+    const QVector<quint32> &stringRanks(int column);
+    QVector<int> sortedOrderOfRows();
+    void permuteRows(const QVector<int> &order);
+    void applyOrder(const QVector<int> &order);
+    void resortAfterRankChange(int *row);
+    int findStudent(int row, const QString &stuId) const;
+    int findStudentById(int row, int id) const;
+    StudentTable rowCopy(int row) const;
+    void rankColumnsChanged(const StudentTable &before, int beforeRow, const StudentTable &after, int afterRow);
+    void invalidatePagesFrom(int row);
+    void replaceInPlace(int row, const StudentTable &source, int sourceRow);
+
+    StudentTable studentList;
+    QVector<RowDisplay> studentDisplay;   // 与 studentList 逐行对应
     QStringList headers;
+
+    int sortedColumn = -1;   // -1 表示未按任何列排序
+    Qt::SortOrder sortedOrder = Qt::AscendingOrder;
+    // 学号、姓名两列的字符串排名（按 QString::compare 的顺序，相同的字符串排名相同），与 studentList 逐行对应
+    // 算一次需要对字符串做比较排序，之后切换升降序或在两列之间切换都只需基数排序；表中的行有增删改时丢弃
+    QHash<int, QVector<quint32>> stringRankCache;
+
+    // 成绩、总分、平均分的取值种类有限，格式化后的文本去重保存，各行只记下标
+    mutable QStringList displayTexts;
+    mutable QHash<quint64, quint16> displayTextLookup;
+
+    EditQueue *editQueue = nullptr;
+
+    RankIndex ranks;
+    bool ranksLoaded = false;   // 索引装载之前不显示排名，也不做增量更新
+
+    Database *pagedSource = nullptr;
+    int pagedRowCount = 0;
+    mutable QCache<int, Page> pageCache;
+    mutable QMap<int, PageAnchor> pageAnchors;
+    AsyncDatabase *pageLoader = nullptr;
+    QSet<int> pendingPages;   // 已交给读线程、还没有结果的页
+    int pageGeneration = 0;   // 行号改变（排序、增删、重新装载）时递增，之前发出的读取结果作废
+    bool firstPageSeen = false;   // 当前数据源已读到过页，firstPageLoaded 只发一次
+    bool sortIndexPending = false;   // 写线程还在建立当前排序列的索引，建好之前不读取各页
+    int sortIndexRequest = 0;        // 每次换排序列或数据来源时递增，旧的建立结果不再处理
+    int sourceGeneration = 0;        // 每次换数据来源时递增，之前计算的插入位置不再适用
 };
 
 #endif // STUDENTMODEL_H
@@ -0,0 +1,220 @@
+#include "studenttable.h"
+
+// ================ StudentRecord ================
+
+int StudentRecord::id() const
+{
+    return table->id(row);
+}
+
+const QString &StudentRecord::stuId() const
+{
+    return table->stuId(row);
+}
+
+const QString &StudentRecord::name() const
+{
+    return table->name(row);
+}
+
+const QString &StudentRecord::className() const
+{
+    return table->className(row);
+}
+
+float StudentRecord::score(Subject subject) const
+{
+    return table->score(row, subject);
+}
+
+bool StudentRecord::hasScore(Subject subject) const
+{
+    return !StudentTable::isMissing(table->score(row, subject));
+}
+
+float StudentRecord::total() const
+{
+    return table->total(row);
+}
+
+float StudentRecord::average() const
+{
+    return table->average(row);
+}
+
+// ================ StudentTable ================
+
+void StudentTable::reserve(int rows)
+{
+    ids.reserve(rows);
+    stuIds.reserve(rows);
+    names.reserve(rows);
+    classIndex.reserve(rows);
+    scores.reserve(rows);
+    totals.reserve(rows);
+    averages.reserve(rows);
+}
+
+void StudentTable::clear()
+{
+    ids.clear();
+    stuIds.clear();
+    names.clear();
+    classIndex.clear();
+    classNames.clear();
+    classLookup.clear();
+    scores.clear();
+    totals.clear();
+    averages.clear();
+}
+
+void StudentTable::append(int id, const QString &stuId, const QString &name, const QString &className,
+                          const float *subjectScores, float total, float average)
+{
+    ids.append(id);
+    stuIds.append(stuId);
+    names.append(name);
+    classIndex.append(quint16(internClass(className)));
+    scores.appendRow(subjectScores);
+    totals.append(total);
+    averages.append(average);
+}
+
+void StudentTable::append(const StudentTable &other)
+{
+    reserve(size() + other.size());
+
+    // 两张表的班级下标各自独立，需要逐行重新映射
+    QVector<quint16> remap(other.classNames.size());
+    for (int i = 0; i < other.classNames.size(); i++)
+        remap[i] = quint16(internClass(other.classNames.at(i)));
+
+    ids += other.ids;
+    stuIds += other.stuIds;
+    names += other.names;
+    for (quint16 index : other.classIndex)
+        classIndex.append(remap.at(index));
+    scores.append(other.scores);
+    totals += other.totals;
+    averages += other.averages;
+}
+
+void StudentTable::appendRow(const StudentTable &source, int row)
+{
+    insertRow(size(), source, row);
+}
+
+void StudentTable::insertRow(int at, const StudentTable &source, int row)
+{
+    ids.insert(at, source.ids.at(row));
+    stuIds.insert(at, source.stuIds.at(row));
+    names.insert(at, source.names.at(row));
+    classIndex.insert(at, quint16(internClass(source.className(row))));
+    float rowScores[SubjectCount];
+    source.scores.rowScores(row, rowScores);
+    scores.insertRow(at, rowScores);
+    totals.insert(at, source.totals.at(row));
+    averages.insert(at, source.averages.at(row));
+}
+
+void StudentTable::replaceRow(int at, const StudentTable &source, int row)
+{
+    ids[at] = source.ids.at(row);
+    stuIds[at] = source.stuIds.at(row);
+    names[at] = source.names.at(row);
+    classIndex[at] = quint16(internClass(source.className(row)));
+    float rowScores[SubjectCount];
+    source.scores.rowScores(row, rowScores);
+    scores.replaceRow(at, rowScores);
+    totals[at] = source.totals.at(row);
+    averages[at] = source.averages.at(row);
+}
+
+// 删除行后班级名称仍保留在 classNames 中，只是不再被引用
+void StudentTable::removeRow(int at)
+{
+    ids.remove(at);
+    stuIds.remove(at);
+    names.remove(at);
+    classIndex.remove(at);
+    scores.removeRow(at);
+    totals.remove(at);
+    averages.remove(at);
+}
+
+StudentRecord StudentTable::record(int row) const
+{
+    if (row < 0 || row >= size())
+        return StudentRecord(nullptr, -1);
+    return StudentRecord(this, row);
+}
+
+StudentTable StudentTable::filtered(const QString &keyword) const
+{
+    StudentTable result;
+
+    // 班级名称已去重，每个班级只比较一次
+    QVector<bool> classMatches(classNames.size());
+    for (int i = 0; i < classNames.size(); i++)
+        classMatches[i] = classNames.at(i).contains(keyword, Qt::CaseInsensitive);
+
+    for (int row = 0; row < size(); row++) {
+        if (!classMatches.at(classIndex.at(row))
+            && !stuIds.at(row).contains(keyword, Qt::CaseInsensitive)
+            && !names.at(row).contains(keyword, Qt::CaseInsensitive)) {
+            continue;
+        }
+
+        result.appendRow(*this, row);
+    }
+
+    return result;
+}
+
+StudentTable StudentTable::reordered(const QVector<int> &order) const
+{
+    Q_ASSERT(order.size() == size());
+
+    // 班级名称表原样保留，下标不必重新映射
+    StudentTable result;
+    result.classNames = classNames;
+    result.classLookup = classLookup;
+    result.scores = scores.reordered(order);
+    result.reserve(order.size());
+    for (int row : order) {
+        result.ids.append(ids.at(row));
+        result.stuIds.append(stuIds.at(row));
+        result.names.append(names.at(row));
+        result.classIndex.append(classIndex.at(row));
+        result.totals.append(totals.at(row));
+        result.averages.append(averages.at(row));
+    }
+    return result;
+}
+
+void StudentTable::totalsOf(const float *subjectScores, float *total, float *average)
+{
+    float sum = 0;
+    int entered = 0;
+    for (int s = 0; s < SubjectCount; s++) {
+        if (!isMissing(subjectScores[s])) {
+            sum += subjectScores[s];
+            entered++;
+        }
+    }
+    *total = sum;
+    *average = entered > 0 ? sum / entered : 0;
+}
+
+int StudentTable::internClass(const QString &className)
+{
+    auto it = classLookup.constFind(className);
+    if (it != classLookup.constEnd())
+        return it.value();
+
+    Q_ASSERT(classNames.size() < 0xFFFF);
+    const quint16 index = quint16(classNames.size());
+    classNames.append(className);
+    classLookup.insert(className, index);
+    return index;
+}
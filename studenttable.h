@@ -0,0 +1,106 @@
+#ifndef STUDENTTABLE_H
+#define STUDENTTABLE_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <cmath>
+#include "subjectcatalogue.h"
+#include "scorematrix.h"
+
+class StudentTable;
+
+// 学生表中某一行的只读视图
+// 只能移动不能复制：视图引用的是表内数据，表被修改后视图即失效，不应长期保存
+class StudentRecord
+{
+public:
+    StudentRecord(StudentRecord &&other) = default;
+    StudentRecord &operator=(StudentRecord &&other) = default;
+    StudentRecord(const StudentRecord &) = delete;
+    StudentRecord &operator=(const StudentRecord &) = delete;
+
+    bool isValid() const { return table != nullptr; }
+
+    int id() const;
+    const QString &stuId() const;
+    const QString &name() const;
+    const QString &className() const;
+    float score(Subject subject) const;
+    bool hasScore(Subject subject) const;
+    float total() const;
+    float average() const;
+
+private:
+    friend class StudentTable;
+    StudentRecord(const StudentTable *table, int row) : table(table), row(row) {}
+
+    const StudentTable *table;
+    int row;
+};
+
+// 按列存储的学生表
+// 学号、总分等各占一段连续数组，各科成绩存放在 ScoreMatrix 中，班级名称去重后只保存下标，缺考/未录入的成绩用 NaN 表示
+class StudentTable
+{
+public:
+    StudentTable() = default;
+
+    int size() const { return ids.size(); }
+    bool isEmpty() const { return ids.isEmpty(); }
+    void reserve(int rows);
+    void clear();
+
+    // scores 依次为目录中各科的成绩，共 SubjectCount 个
+    void append(int id, const QString &stuId, const QString &name, const QString &className,
+                const float *subjectScores, float total, float average);
+    void append(const StudentTable &other);
+    void appendRow(const StudentTable &source, int row);
+
+    // 单行修改，用于增删改后局部更新而不必重新读取整张表
+    void insertRow(int at, const StudentTable &source, int row);
+    void replaceRow(int at, const StudentTable &source, int row);
+    void removeRow(int at);
+
+    int id(int row) const { return ids.at(row); }
+    const QString &stuId(int row) const { return stuIds.at(row); }
+    const QString &name(int row) const { return names.at(row); }
+    const QString &className(int row) const { return classNames.at(classIndex.at(row)); }
+    float score(int row, Subject subject) const { return scores.at(int(subject), row); }
+    const ScoreMatrix &scoreMatrix() const { return scores; }
+    float total(int row) const { return totals.at(row); }
+    float average(int row) const { return averages.at(row); }
+
+    StudentRecord record(int row) const;
+
+    // 在内存中筛选学号、姓名或班级包含 keyword 的行（不区分大小写），保持原有顺序
+    StudentTable filtered(const QString &keyword) const;
+    // 按 order 重新排列各行：结果的第 i 行为原来的第 order[i] 行，order 须是全部行号的一个排列
+    StudentTable reordered(const QVector<int> &order) const;
+
+    // 去重后的班级名称及每行对应的下标，排序时按班级只需比较各个名称一次
+    const QStringList &classNameList() const { return classNames; }
+    int classNameIndex(int row) const { return classIndex.at(row); }
+
+    // 数据库中 NULL 和负数（默认值 -1）都表示成绩未录入
+    static float scoreFromDatabase(double value, bool isNull) { return (isNull || value < 0) ? NAN : float(value); }
+    static bool isMissing(float score) { return std::isnan(score); }
+    // 按数据库中生成列的公式由各科成绩算出总分和平均分（总分 / 已录入科目数，一科都没有时为 0）
+    static void totalsOf(const float *subjectScores, float *total, float *average);
+
+private:
+    int internClass(const QString &className);
+
+    QVector<int> ids;
+    QVector<QString> stuIds;
+    QVector<QString> names;
+    QVector<quint16> classIndex;        // 指向 classNames 的下标
+    QStringList classNames;             // 去重后的班级名称
+    QHash<QString, quint16> classLookup;
+    ScoreMatrix scores;
+    QVector<float> totals;
+    QVector<float> averages;
+};
+
+#endif // STUDENTTABLE_H
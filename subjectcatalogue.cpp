@@ -0,0 +1,22 @@
+#include "subjectcatalogue.h"
+
+const char *subjectColumn(Subject subject)
+{
+    return SubjectCatalogue[int(subject)].column;
+}
+
+QString subjectName(Subject subject)
+{
+    return QString::fromUtf8(SubjectCatalogue[int(subject)].name);
+}
+
+int subjectIndex(const QString &columnOrName)
+{
+    for (int s = 0; s < SubjectCount; s++) {
+        if (columnOrName.compare(QLatin1String(SubjectCatalogue[s].column), Qt::CaseInsensitive) == 0
+            || columnOrName == QString::fromUtf8(SubjectCatalogue[s].name)) {
+            return s;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,34 @@
+#ifndef SUBJECTCATALOGUE_H
+#define SUBJECTCATALOGUE_H
+
+#include <QString>
+#include <iterator>
+
+// 科目目录：students 表的成绩列、表格列、统计项和导入导出字段都按这里的顺序生成
+// 增加科目只需在末尾追加一项；打开数据库时会为 students 表补上缺少的成绩列
+struct SubjectInfo
+{
+    const char *column;   // students 表中的列名，拼接 SQL 时只能使用这里给出的列名
+    const char *name;     // 界面、CSV 表头中使用的名称
+};
+
+inline constexpr SubjectInfo SubjectCatalogue[] = {
+    {"chinese", "语文"},
+    {"math", "数学"},
+    {"english", "英语"},
+};
+
+constexpr int SubjectCount = int(std::size(SubjectCatalogue));
+
+// 各科满分相同，成绩统一按百分制校验和分段
+constexpr int FullScore = 100;
+
+// 科目在目录中的下标；这里只为最初的三科起了名字，其余科目用 Subject(下标) 表示
+enum class Subject : int { Chinese = 0, Math = 1, English = 2 };
+
+const char *subjectColumn(Subject subject);
+QString subjectName(Subject subject);
+// 按列名或中文名查找科目（不区分大小写），找不到返回 -1
+int subjectIndex(const QString &columnOrName);
+
+#endif // SUBJECTCATALOGUE_H
@@ -0,0 +1,413 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cmath>
+#include "database.h"
+#include "reportrunner.h"
+#include "rankindex.h"
+#include "statisticssnapshot.h"
+
+// 单元测试：每个用例在临时目录中使用自己的数据库文件，互不影响
+class StudentGradeTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    // 表结构迁移
+    void migrateLegacyDatabase();
+    void migrationKeepsIdSequence();
+
+    // 数据库写入
+    void applyStudentEditsRollsBackFailedRow();
+
+    // 命令行报表
+    void reportUpgradesLegacyDatabase();
+
+    // 排名与统计
+    void rankIndexMatchesSort();
+    void scoreDistributionQuantiles();
+    void scoreDistributionMerge();
+    void scanDistributionMatchesStoredCounts();
+
+private:
+    QString scratchPath(const QString &name) const { return dir.filePath(name); }
+    ConnectionProfile profileFor(const QString &name) const;
+    // 按最初版本的建表语句建立一个 user_version 为 0 的数据库，写入 students 名学生后删除 deleted 中的 id
+    bool createLegacyDatabase(const QString &path, int students, const QVector<int> &deleted);
+    static QVector<double> scores(double chinese, double math, double english);
+
+    QTemporaryDir dir;
+};
+
+void StudentGradeTest::initTestCase()
+{
+    QVERIFY(dir.isValid());
+}
+
+ConnectionProfile StudentGradeTest::profileFor(const QString &name) const
+{
+    return ConnectionProfile::preset(ConnectionProfile::Preset::Interactive, scratchPath(name));
+}
+
+QVector<double> StudentGradeTest::scores(double chinese, double math, double english)
+{
+    QVector<double> values(SubjectCount, -1);
+    values[int(Subject::Chinese)] = chinese;
+    values[int(Subject::Math)] = math;
+    values[int(Subject::English)] = english;
+    return values;
+}
+
+bool StudentGradeTest::createLegacyDatabase(const QString &path, int students, const QVector<int> &deleted)
+{
+    bool ok = true;
+    {
+        QSqlDatabase legacy = QSqlDatabase::addDatabase("QSQLITE", "legacy");
+        legacy.setDatabaseName(path);
+        ok = legacy.open();
+
+        // 最初版本的学生表：总分、平均分为虚拟列，没有 user_version
+        QSqlQuery query(legacy);
+        ok = ok && query.exec("CREATE TABLE students ("
+                              "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                              "stu_id TEXT UNIQUE NOT NULL,"
+                              "name TEXT NOT NULL,"
+                              "class TEXT NOT NULL,"
+                              "chinese REAL DEFAULT -1,"
+                              "math REAL DEFAULT -1,"
+                              "english REAL DEFAULT -1,"
+                              "total REAL GENERATED ALWAYS AS ("
+                              "  CASE WHEN chinese >= 0 THEN chinese ELSE 0 END +"
+                              "  CASE WHEN math >= 0 THEN math ELSE 0 END +"
+                              "  CASE WHEN english >= 0 THEN english ELSE 0 END) VIRTUAL,"
+                              "average REAL GENERATED ALWAYS AS ("
+                              "  (CASE WHEN chinese >= 0 THEN 1 ELSE 0 END +"
+                              "   CASE WHEN math >= 0 THEN 1 ELSE 0 END +"
+                              "   CASE WHEN english >= 0 THEN 1 ELSE 0 END) * 1.0 /"
+                              "  NULLIF((CASE WHEN chinese >= 0 THEN chinese ELSE 0 END +"
+                              "         CASE WHEN math >= 0 THEN math ELSE 0 END +"
+                              "         CASE WHEN english >= 0 THEN english ELSE 0 END), 0)) VIRTUAL)");
+        for (int i = 1; ok && i <= students; i++) {
+            query.prepare("INSERT INTO students (stu_id, name, class, chinese, math, english) VALUES (?, ?, ?, ?, ?, ?)");
+            query.addBindValue(QString("S%1").arg(i, 4, 10, QChar('0')));
+            query.addBindValue(QString("学生%1").arg(i));
+            query.addBindValue(QString("%1班").arg(i % 2 + 1));
+            query.addBindValue(60 + i);
+            query.addBindValue(70 + i);
+            query.addBindValue(80 + i);
+            ok = query.exec();
+        }
+        for (int id : deleted) {
+            query.prepare("DELETE FROM students WHERE id = ?");
+            query.addBindValue(id);
+            ok = ok && query.exec();
+        }
+        if (!ok)
+            qWarning() << "建立旧版本数据库失败：" << query.lastError().text();
+        legacy.close();
+    }
+    QSqlDatabase::removeDatabase("legacy");
+    return ok;
+}
+
+// ================ 表结构迁移 ================
+
+void StudentGradeTest::migrateLegacyDatabase()
+{
+    const QString path = scratchPath("legacy.db");
+    QVERIFY(createLegacyDatabase(path, 4, {}));
+
+    Database fresh;
+    QVERIFY(fresh.openDatabase(profileFor("fresh.db"), "fresh"));
+
+    Database db;
+    QVERIFY(db.openDatabase(ConnectionProfile::preset(ConnectionProfile::Preset::Interactive, path), "migrate"));
+    QCOMPARE(db.schemaVersion(), fresh.schemaVersion());
+
+    // 原有的行、id 和成绩都保留，总分和平均分改为存储列后取值不变
+    const StudentTable students = db.getAllStudents();
+    QCOMPARE(students.size(), 4);
+    for (int row = 0; row < students.size(); row++) {
+        const int i = students.stuId(row).mid(1).toInt();
+        QCOMPARE(students.id(row), i);
+        QCOMPARE(students.score(row, Subject::Math), float(70 + i));
+        QCOMPARE(students.total(row), float(210 + 3 * i));
+    }
+    QVERIFY(db.checkClassStats());
+}
+
+void StudentGradeTest::migrationKeepsIdSequence()
+{
+    // 删掉 id 最大的学生后升级：重建学生表不能让下一名学生重新使用这个 id
+    const QString path = scratchPath("deleted-max.db");
+    QVERIFY(createLegacyDatabase(path, 3, {3}));
+
+    Database db;
+    QVERIFY(db.openDatabase(ConnectionProfile::preset(ConnectionProfile::Preset::Interactive, path), "sequence"));
+
+    StudentTable inserted;
+    QVERIFY(db.addStudent("S9999", "新学生", "1班", scores(90, 90, 90), &inserted));
+    QCOMPARE(inserted.size(), 1);
+    QCOMPARE(inserted.id(0), 4);
+}
+
+// ================ 数据库写入 ================
+
+void StudentGradeTest::applyStudentEditsRollsBackFailedRow()
+{
+    Database db;
+    QVERIFY(db.openDatabase(profileFor("edits.db"), "edits"));
+    StudentTable first, second;
+    QVERIFY(db.addStudent("E0001", "甲", "1班", scores(60, 60, 60), &first));
+    QVERIFY(db.addStudent("E0002", "乙", "1班", scores(70, 70, 70), &second));
+
+    // 让第二名学生的修改在执行时失败，模拟约束冲突
+    QSqlQuery trigger(QSqlDatabase::database("edits"));
+    QVERIFY2(trigger.exec("CREATE TEMP TRIGGER reject_edit BEFORE UPDATE ON students "
+                          "WHEN new.name = '拒绝' BEGIN SELECT RAISE(ABORT, '拒绝修改'); END"),
+             qPrintable(trigger.lastError().text()));
+
+    QVector<StudentEdit> edits(2);
+    edits[0].id = first.id(0);
+    edits[0].fields = StudentEdit::ScoreField << int(Subject::Math);
+    edits[0].scores[int(Subject::Math)] = 95;
+    edits[1].id = second.id(0);
+    edits[1].fields = StudentEdit::NameField | (StudentEdit::ScoreField << int(Subject::Math));
+    edits[1].name = "拒绝";
+    edits[1].scores[int(Subject::Math)] = 10;
+
+    StudentTable rows;
+    QVector<QPair<int, QString>> errors;
+    QVERIFY(db.applyStudentEdits(edits, &rows, &errors));
+
+    // 第一行写入，第二行只回滚自己并返回原有的值
+    QCOMPARE(errors.size(), 1);
+    QCOMPARE(errors.first().first, second.id(0));
+    QCOMPARE(rows.size(), 2);
+
+    const StudentTable stored = db.getStudentsByIds({first.id(0), second.id(0)});
+    QCOMPARE(stored.size(), 2);
+    for (int row = 0; row < stored.size(); row++) {
+        if (stored.id(row) == first.id(0)) {
+            QCOMPARE(stored.score(row, Subject::Math), 95.0f);
+        } else {
+            QCOMPARE(stored.name(row), QString("乙"));
+            QCOMPARE(stored.score(row, Subject::Math), 70.0f);
+        }
+    }
+    for (int row = 0; row < rows.size(); row++) {
+        if (rows.id(row) == second.id(0))
+            QCOMPARE(rows.score(row, Subject::Math), 70.0f);
+    }
+
+    // 统计表的触发器改动随这一行一起回滚
+    QStringList differences;
+    QVERIFY2(db.checkClassStats(&differences), qPrintable(differences.join("; ")));
+}
+
+// ================ 命令行报表 ================
+
+void StudentGradeTest::reportUpgradesLegacyDatabase()
+{
+    // 其他工具建立、本程序从未打开过的数据库：报表以只读方式统计，需要先升级表结构
+    const QString path = scratchPath("report-legacy.db");
+    QVERIFY(createLegacyDatabase(path, 6, {}));
+
+    ReportRunner::Options options;
+    options.databases = {path};
+    options.outDir = scratchPath("report");
+    options.jobs = 1;
+    const QVector<ReportRunner::Outcome> outcomes = ReportRunner::runAll(options);
+    QCOMPARE(outcomes.size(), 1);
+
+    const ReportRunner::Outcome &outcome = outcomes.first();
+    QVERIFY2(outcome.result.error.isEmpty(), qPrintable(outcome.result.error));
+    QVERIFY(outcome.result.rowsWritten > 0);
+    QVERIFY(QFile::exists(QDir(outcome.outputDir).filePath("class_stats.csv")));
+
+    // 升级后的文件是当前版本，再次统计不必写入
+    Database reopened;
+    QVERIFY(reopened.openDatabase(ConnectionProfile::preset(ConnectionProfile::Preset::ReadOnlyReporting, path),
+                                  "report-check"));
+    QCOMPARE(reopened.getAllStudents().size(), 6);
+}
+
+// ================ 排名与统计 ================
+
+void StudentGradeTest::rankIndexMatchesSort()
+{
+    // 成绩取半分，排名索引按 0.1 分分段，不会有相差不到一段的不同成绩
+    QRandomGenerator random(20240601);
+    const QStringList classNames = {"1班", "2班", "3班"};
+    StudentTable table;
+    for (int i = 0; i < 600; i++) {
+        float values[SubjectCount];
+        for (int s = 0; s < SubjectCount; s++)
+            values[s] = random.bounded(10) == 0 ? NAN : random.bounded(201) / 2.0f;
+        float total = 0, average = 0;
+        StudentTable::totalsOf(values, &total, &average);
+        table.append(i + 1, QString::number(i), "学生", classNames.at(i % classNames.size()), values, total, average);
+    }
+
+    RankIndex ranks;
+    for (int row = 0; row < table.size(); row++)
+        ranks.addStudent(table, row);
+
+    auto keyValue = [&table](int row, int key) {
+        return key == RankIndex::TotalKey ? table.total(row) : table.score(row, Subject(key));
+    };
+
+    // 与排序后的结果比较：名次 = 1 + 成绩更高的人数，未录入的没有名次
+    for (int key = 0; key < RankIndex::KeyCount; key++) {
+        QVector<float> school;
+        QHash<QString, QVector<float>> classes;
+        for (int row = 0; row < table.size(); row++) {
+            const float value = keyValue(row, key);
+            if (StudentTable::isMissing(value))
+                continue;
+            school << value;
+            classes[table.className(row)] << value;
+        }
+        std::sort(school.begin(), school.end(), std::greater<float>());
+        for (QVector<float> &values : classes)
+            std::sort(values.begin(), values.end(), std::greater<float>());
+        QCOMPARE(ranks.schoolCount(key), school.size());
+
+        for (int row = 0; row < table.size(); row++) {
+            const float value = keyValue(row, key);
+            if (StudentTable::isMissing(value)) {
+                QCOMPARE(ranks.schoolRank(key, value), 0);
+                continue;
+            }
+            const QVector<float> &inClass = classes.value(table.className(row));
+            const int expectedSchool = int(std::lower_bound(school.begin(), school.end(), value,
+                                                            std::greater<float>()) - school.begin()) + 1;
+            const int expectedClass = int(std::lower_bound(inClass.begin(), inClass.end(), value,
+                                                           std::greater<float>()) - inClass.begin()) + 1;
+            QCOMPARE(ranks.schoolRank(key, value), expectedSchool);
+            QCOMPARE(ranks.classRank(table.className(row), key, value), expectedClass);
+        }
+    }
+
+    // 移除后名次随之变化，与重新建立的索引一致
+    RankIndex rebuilt;
+    for (int row = 0; row < table.size(); row++) {
+        if (row % 3 == 0)
+            ranks.removeStudent(table, row);
+        else
+            rebuilt.addStudent(table, row);
+    }
+    for (int row = 0; row < table.size(); row++) {
+        QCOMPARE(ranks.schoolRank(RankIndex::TotalKey, table.total(row)),
+                 rebuilt.schoolRank(RankIndex::TotalKey, table.total(row)));
+        QCOMPARE(ranks.classRank(table.className(row), RankIndex::TotalKey, table.total(row)),
+                 rebuilt.classRank(table.className(row), RankIndex::TotalKey, table.total(row)));
+    }
+}
+
+// 与 Excel 的 PERCENTILE.INC 相同：在第 floor((n-1)p) 和下一个次序统计量之间线性插值
+static double percentileInc(QVector<double> sorted, double p)
+{
+    std::sort(sorted.begin(), sorted.end());
+    const double position = (sorted.size() - 1) * p;
+    const int lower = int(std::floor(position));
+    if (lower + 1 >= sorted.size())
+        return sorted.last();
+    return sorted.at(lower) + (position - lower) * (sorted.at(lower + 1) - sorted.at(lower));
+}
+
+void StudentGradeTest::scoreDistributionQuantiles()
+{
+    // 个数、重复值都不同的几组成绩，与直接排序的结果比较
+    QRandomGenerator random(42);
+    for (int n : {1, 2, 5, 10, 101, 1000}) {
+        QVector<double> values;
+        ScoreDistribution distribution;
+        for (int i = 0; i < n; i++) {
+            const double value = random.bounded(41) * 2.5;
+            values << value;
+            distribution.add(value);
+        }
+
+        QCOMPARE(distribution.count(), qint64(n));
+        for (double p : {0.0, 0.1, 0.25, 0.5, 0.75, 0.9, 1.0})
+            QVERIFY2(std::abs(distribution.quantile(p) - percentileInc(values, p)) < 1e-9,
+                     qPrintable(QString("n=%1 p=%2").arg(n).arg(p)));
+
+        double sum = 0;
+        for (double value : values)
+            sum += value;
+        const double mean = sum / n;
+        double squares = 0;
+        for (double value : values)
+            squares += (value - mean) * (value - mean);
+        QVERIFY(std::abs(distribution.mean() - mean) < 1e-9);
+        QVERIFY(std::abs(distribution.standardDeviation() - std::sqrt(squares / n)) < 1e-9);
+    }
+
+    // 已知数据：1..10 的中位数为 5.5，四分位数为 3.25 和 7.75
+    ScoreDistribution known;
+    for (int i = 1; i <= 10; i++)
+        known.add(i);
+    QCOMPARE(known.median(), 5.5);
+    QCOMPARE(known.quantile(0.25), 3.25);
+    QCOMPARE(known.quantile(0.75), 7.75);
+}
+
+void StudentGradeTest::scoreDistributionMerge()
+{
+    // 分班统计后合并，与全校一起统计的结果相同
+    QRandomGenerator random(7);
+    ScoreDistribution whole, a, b;
+    for (int i = 0; i < 500; i++) {
+        const double value = random.bounded(101);
+        whole.add(value);
+        (i % 3 == 0 ? a : b).add(value, 1);
+    }
+    ScoreDistribution merged = a;
+    merged.merge(b);
+
+    QCOMPARE(merged.count(), whole.count());
+    QCOMPARE(merged.values(), whole.values());
+    QVERIFY(std::abs(merged.mean() - whole.mean()) < 1e-9);
+    QVERIFY(std::abs(merged.variance() - whole.variance()) < 1e-6);
+    QCOMPARE(merged.median(), whole.median());
+}
+
+void StudentGradeTest::scanDistributionMatchesStoredCounts()
+{
+    // 自定义分数段绕过统计表直接扫描学生表，分布在 ScoreMatrix::aggregate 中算出，应与计数表一致
+    Database db;
+    QVERIFY(db.openDatabase(profileFor("distribution.db"), "distribution"));
+    QRandomGenerator random(11);
+    for (int i = 0; i < 200; i++) {
+        QVector<double> values = scores(random.bounded(201) / 2.0, random.bounded(101), random.bounded(201) / 2.0);
+        if (i % 17 == 0)
+            values[int(Subject::English)] = -1;   // 未录入
+        QVERIFY(db.addStudent(QString("D%1").arg(i, 4, 10, QChar('0')), "学生",
+                              QString("%1班").arg(i % 4 + 1), values));
+    }
+
+    const StatisticsSnapshot stored = db.getStatisticsSnapshot();
+    const StatisticsSnapshot scanned = db.getStatisticsSnapshot({0, 50, 100});
+    QCOMPARE(scanned.classes.size(), stored.classes.size());
+    for (int i = 0; i < stored.classes.size(); i++) {
+        QCOMPARE(scanned.classes.at(i).className, stored.classes.at(i).className);
+        for (int s = 0; s < SubjectCount; s++) {
+            const ScoreDistribution &expected = stored.classes.at(i).subjects[s].distribution;
+            const ScoreDistribution &actual = scanned.classes.at(i).subjects[s].distribution;
+            QCOMPARE(actual.values(), expected.values());
+            QCOMPARE(actual.median(), expected.median());
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(StudentGradeTest)
+#include "studentgradetest.moc"
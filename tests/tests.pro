@@ -0,0 +1,46 @@
+# 单元测试：qmake tests/tests.pro && make check（或直接运行 StudentGradeTest）
+# 只测不依赖界面的部分：表结构迁移、数据库写入、命令行报表、排名索引和成绩分布
+QT += core sql concurrent testlib
+QT -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = StudentGradeTest
+
+APP = $$PWD/..
+INCLUDEPATH += $$APP
+
+SOURCES += \
+    studentgradetest.cpp \
+    $$APP/database.cpp \
+    $$APP/dataexporter.cpp \
+    $$APP/reportrunner.cpp \
+    $$APP/studenttable.cpp \
+    $$APP/subjectcatalogue.cpp \
+    $$APP/scorematrix.cpp \
+    $$APP/statisticssnapshot.cpp \
+    $$APP/rankindex.cpp \
+    $$APP/connectionprofile.cpp \
+    $$APP/querytracer.cpp
+
+HEADERS += \
+    $$APP/database.h \
+    $$APP/dataexporter.h \
+    $$APP/reportrunner.h \
+    $$APP/studenttable.h \
+    $$APP/subjectcatalogue.h \
+    $$APP/scorematrix.h \
+    $$APP/statisticssnapshot.h \
+    $$APP/rankindex.h \
+    $$APP/connectionprofile.h \
+    $$APP/querytracer.h
+
+# 与主程序输出到同一目录
+CONFIG(release, debug|release) {
+    DESTDIR = $$APP/release
+}
+
+CONFIG(debug, debug|release) {
+    DESTDIR = $$APP/debug
+}